@@ -0,0 +1,280 @@
+#include "archive.h"
+#include "options.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+/** Timing column stored as zigzag varint microseconds. */
+#define TIMING_MICROS 0
+
+/** Timing column stored as varint XOR of the double bits with the previous value. */
+#define TIMING_XOR 1
+
+/** The number of timing columns. */
+#define TIMING_COLUMNS 7
+
+/** The timing members of CURLProbe in column order. */
+static double CURLProbe::* const timing_columns[TIMING_COLUMNS] = {
+  &CURLProbe::total_time,
+  &CURLProbe::time_namelookup,
+  &CURLProbe::time_connect,
+  &CURLProbe::time_appconnect,
+  &CURLProbe::time_pretransfer,
+  &CURLProbe::time_starttransfer,
+  &CURLProbe::time_redirect
+};
+
+/**
+ * Return the bits of a double.
+ */
+static inline uint64_t doubleBits( double d ) {
+  uint64_t bits;
+  memcpy( &bits, &d, sizeof(bits) );
+  return bits;
+}
+
+/**
+ * Return the double of bits.
+ */
+static inline double bitsDouble( uint64_t bits ) {
+  double d;
+  memcpy( &d, &bits, sizeof(d) );
+  return d;
+}
+
+/**
+ * Return true if d is a whole number of microseconds that converts back to exactly d.
+ */
+static inline bool isMicros( double d ) {
+  if ( !std::isfinite( d ) || fabs( d ) > 1.0E12 ) return false;
+  return static_cast<double>( llround( d * 1.0E6 ) ) / 1.0E6 == d;
+}
+
+/**
+ * Return the index of value in dict.
+ */
+static inline uint8_t dictIndex( const vector<uint16_t> &dict, uint16_t value ) {
+  return static_cast<uint8_t>( find( dict.begin(), dict.end(), value ) - dict.begin() );
+}
+
+ArchiveWriter::ArchiveWriter( const string &path ) : path_(path), probes_(0), size_(0) {
+  out_.open( path, ios::binary | ios::trunc );
+  if ( !out_ ) throw std::runtime_error( "cannot create '" + path + "'" );
+  rows_.reserve( ARCHIVE_BLOCK_ROWS );
+  out_.write( ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE );
+  out_.put( ARCHIVE_VERSION );
+  size_ = ARCHIVE_MAGIC_SIZE + 1;
+}
+
+void ArchiveWriter::probe( const CURLProbe &curl ) {
+  if ( !options.inTimeRange( curl.datetime ) ) return;
+  if ( rows_.size() == ARCHIVE_BLOCK_ROWS ) flush();
+  // a block has at most 256 distinct values per dictionary
+  bool new_error = find( curl_errors_.begin(), curl_errors_.end(), curl.curl_error ) == curl_errors_.end();
+  bool new_code = find( http_codes_.begin(), http_codes_.end(), curl.http_code ) == http_codes_.end();
+  bool new_connect = find( http_connects_.begin(), http_connects_.end(), curl.http_connect ) == http_connects_.end();
+  if ( ( new_error && curl_errors_.size() == 256 ) || ( new_code && http_codes_.size() == 256 ) ||
+       ( new_connect && http_connects_.size() == 256 ) ) {
+    flush();
+    new_error = new_code = new_connect = true;
+  }
+  if ( new_error ) curl_errors_.push_back( curl.curl_error );
+  if ( new_code ) http_codes_.push_back( curl.http_code );
+  if ( new_connect ) http_connects_.push_back( curl.http_connect );
+  rows_.push_back( curl );
+}
+
+void ArchiveWriter::comment( string_view line ) {
+  flush();
+  writeBlock( 'C', line );
+}
+
+void ArchiveWriter::error( string_view line, ParseResult kind, string_view input, uint64_t number ) {
+  rejects_.add( line, kind, input, number );
+}
+
+void ArchiveWriter::close() {
+  flush();
+  out_.close();
+  if ( !out_ ) throw std::runtime_error( "error writing '" + path_ + "'" );
+}
+
+void ArchiveWriter::flush() {
+  if ( rows_.empty() ) return;
+  payload_.clear();
+  putVarint( payload_, rows_.size() );
+  int64_t previous = 0;
+  for ( const auto &row : rows_ ) {
+    int64_t epoch = row.datetime.toEpoch();
+    putVarint( payload_, zigzag( epoch - previous ) );
+    previous = epoch;
+  }
+  putVarint( payload_, curl_errors_.size() );
+  for ( auto v : curl_errors_ ) putVarint( payload_, v );
+  for ( const auto &row : rows_ ) payload_.push_back( static_cast<char>( dictIndex( curl_errors_, row.curl_error ) ) );
+  putVarint( payload_, http_codes_.size() );
+  for ( auto v : http_codes_ ) putVarint( payload_, v );
+  for ( const auto &row : rows_ ) payload_.push_back( static_cast<char>( dictIndex( http_codes_, row.http_code ) ) );
+  putVarint( payload_, http_connects_.size() );
+  for ( auto v : http_connects_ ) putVarint( payload_, v );
+  for ( const auto &row : rows_ ) payload_.push_back( static_cast<char>( dictIndex( http_connects_, row.http_connect ) ) );
+  for ( const auto &row : rows_ ) putVarint( payload_, row.ssl_verify_result );
+  for ( auto column : timing_columns ) {
+    bool micros = all_of( rows_.begin(), rows_.end(), [column]( const CURLProbe &row ) { return isMicros( row.*column ); } );
+    if ( micros ) {
+      payload_.push_back( TIMING_MICROS );
+      for ( const auto &row : rows_ ) putVarint( payload_, zigzag( llround( row.*column * 1.0E6 ) ) );
+    } else {
+      payload_.push_back( TIMING_XOR );
+      uint64_t previous_bits = 0;
+      for ( const auto &row : rows_ ) {
+        uint64_t bits = doubleBits( row.*column );
+        putVarint( payload_, bits ^ previous_bits );
+        previous_bits = bits;
+      }
+    }
+  }
+  for ( const auto &row : rows_ ) putVarint( payload_, row.size_upload );
+  for ( const auto &row : rows_ ) putVarint( payload_, row.size_download );
+  writeBlock( 'Q', payload_ );
+  probes_ += rows_.size();
+  rows_.clear();
+  curl_errors_.clear();
+  http_codes_.clear();
+  http_connects_.clear();
+}
+
+void ArchiveWriter::writeBlock( char type, string_view payload ) {
+  string header( 1, type );
+  putVarint( header, payload.size() );
+  out_.write( header.data(), header.size() );
+  out_.write( payload.data(), payload.size() );
+  if ( !out_ ) throw std::runtime_error( "error writing '" + path_ + "'" );
+  size_ += header.size() + payload.size();
+}
+
+bool isArchive( string_view head ) {
+  return head.size() >= ARCHIVE_MAGIC_SIZE && head.substr( 0, ARCHIVE_MAGIC_SIZE ) == string_view( ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE );
+}
+
+string_view archiveBlocks( string_view data ) {
+  if ( !isArchive( data ) || data.size() <= ARCHIVE_MAGIC_SIZE ) throw std::runtime_error( "not a curlstats archive" );
+  int version = static_cast<uint8_t>( data[ARCHIVE_MAGIC_SIZE] );
+  if ( version != ARCHIVE_VERSION ) throw std::runtime_error( "unsupported archive version " + to_string( version ) );
+  return data.substr( ARCHIVE_MAGIC_SIZE + 1 );
+}
+
+/**
+ * Take the next block from the front of blocks.
+ */
+static void nextBlock( string_view &blocks, char &type, string_view &payload ) {
+  type = blocks[0];
+  blocks.remove_prefix( 1 );
+  uint64_t size = 0;
+  if ( !getVarint( blocks, size ) || size > blocks.size() ) throw std::runtime_error( "corrupt archive block" );
+  payload = blocks.substr( 0, size );
+  blocks.remove_prefix( size );
+}
+
+vector<string_view> splitArchive( string_view blocks, size_t range_size ) {
+  vector<string_view> ranges;
+  string_view rest = blocks;
+  size_t start = 0;
+  while ( rest.size() ) {
+    char type;
+    string_view payload;
+    nextBlock( rest, type, payload );
+    size_t end = blocks.size() - rest.size();
+    if ( end - start >= range_size || rest.empty() ) {
+      ranges.push_back( blocks.substr( start, end - start ) );
+      start = end;
+    }
+  }
+  return ranges;
+}
+
+/**
+ * Read a varint from a block payload.
+ */
+static inline uint64_t getColumnVarint( string_view &in ) {
+  uint64_t value;
+  if ( !getVarint( in, value ) ) throw std::runtime_error( "corrupt archive probe block" );
+  return value;
+}
+
+/**
+ * Read a dictionary column into the member of rows.
+ */
+static void readDictColumn( string_view &in, vector<CURLProbe> &rows, uint16_t CURLProbe::* member ) {
+  uint16_t dict[256];
+  uint64_t size = getColumnVarint( in );
+  if ( size > 256 ) throw std::runtime_error( "corrupt archive dictionary" );
+  for ( size_t i = 0; i < size; i++ ) dict[i] = static_cast<uint16_t>( getColumnVarint( in ) );
+  if ( in.size() < rows.size() ) throw std::runtime_error( "corrupt archive probe block" );
+  for ( size_t i = 0; i < rows.size(); i++ ) {
+    uint8_t index = static_cast<uint8_t>( in[i] );
+    if ( index >= size ) throw std::runtime_error( "corrupt archive dictionary index" );
+    rows[i].*member = dict[index];
+  }
+  in.remove_prefix( rows.size() );
+}
+
+/**
+ * Decode a probe block into rows.
+ * @param in The payload.
+ * @param rows Receives the probes.
+ */
+static void readProbeBlock( string_view in, vector<CURLProbe> &rows ) {
+  uint64_t count = getColumnVarint( in );
+  if ( count > ARCHIVE_BLOCK_ROWS ) throw std::runtime_error( "corrupt archive probe block" );
+  rows.resize( count );
+  int64_t epoch = 0;
+  for ( auto &row : rows ) {
+    epoch += unzigzag( getColumnVarint( in ) );
+    row.datetime.fromEpoch( epoch );
+  }
+  readDictColumn( in, rows, &CURLProbe::curl_error );
+  readDictColumn( in, rows, &CURLProbe::http_code );
+  readDictColumn( in, rows, &CURLProbe::http_connect );
+  for ( auto &row : rows ) row.ssl_verify_result = static_cast<uint32_t>( getColumnVarint( in ) );
+  for ( size_t c = 0; c < TIMING_COLUMNS; c++ ) {
+    auto column = timing_columns[c];
+    if ( in.empty() ) throw std::runtime_error( "corrupt archive probe block" );
+    char mode = in[0];
+    in.remove_prefix( 1 );
+    if ( mode == TIMING_MICROS ) {
+      for ( auto &row : rows ) row.*column = static_cast<double>( unzigzag( getColumnVarint( in ) ) ) / 1.0E6;
+    } else if ( mode == TIMING_XOR ) {
+      uint64_t bits = 0;
+      for ( auto &row : rows ) {
+        bits ^= getColumnVarint( in );
+        row.*column = bitsDouble( bits );
+      }
+    } else throw std::runtime_error( "corrupt archive timing column" );
+  }
+  for ( auto &row : rows ) row.size_upload = getColumnVarint( in );
+  for ( auto &row : rows ) row.size_download = getColumnVarint( in );
+  for ( auto &row : rows ) row.decompose();
+}
+
+void readArchive( ProbeSink &sink, string_view blocks ) {
+  vector<CURLProbe> rows;
+  rows.reserve( ARCHIVE_BLOCK_ROWS );
+  while ( blocks.size() ) {
+    char type;
+    string_view payload;
+    nextBlock( blocks, type, payload );
+    if ( type == 'Q' ) {
+      readProbeBlock( payload, rows );
+      for ( const auto &row : rows ) {
+        if ( options.where.empty() || !options.where_filter.rejects( row ) ) sink.probe( row );
+      }
+    } else if ( type == 'C' ) {
+      sink.comment( payload );
+    }
+    // unknown block types are skipped, so that later versions may add blocks
+  }
+}
@@ -0,0 +1,157 @@
+#ifndef archive_h
+#define archive_h
+
+#include "probesink.h"
+#include "reject.h"
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/** The magic bytes a curlstats archive starts with. */
+#define ARCHIVE_MAGIC "\x89" "CSA\r\n\x1a\n"
+
+/** The size of ARCHIVE_MAGIC. */
+#define ARCHIVE_MAGIC_SIZE 8
+
+/** The archive format version following the magic bytes. */
+#define ARCHIVE_VERSION 2
+
+/** The maximum number of probes in an archive block. */
+#define ARCHIVE_BLOCK_ROWS 4096
+
+/**
+ * Writes probes and comments to a curlstats archive, a columnar binary file that curlstats reads
+ * without text parsing.
+ *
+ * After the magic bytes and the version byte, the archive is a sequence of self-contained blocks,
+ * each a type byte, a varint payload size and the payload. Comment blocks ('C') hold a comment line.
+ * Probe blocks ('Q') hold up to ARCHIVE_BLOCK_ROWS probes stored column by column:
+ *   - the row count
+ *   - the timestamps as zigzag varint epoch seconds, the first absolute, the others as delta to the previous
+ *   - curl_error, http_code and http_connect each as a dictionary of varint values followed by a one byte
+ *     index per row
+ *   - ssl_verify_result as varints
+ *   - the seven timings (time_redirect last), each column either as zigzag varint microseconds if all values
+ *     in the block are whole microseconds, or else as varint of the XOR of the double bits with the previous value
+ *   - size_upload and size_download as varints
+ *
+ * Probes are stored exactly, an analysis of the archive reports the same as an analysis of the text.
+ * Timestamps that do not map to epoch seconds, such as '2020-02-30', cannot be stored and are rejected.
+ */
+class ArchiveWriter : public ProbeSink {
+  public:
+
+    /**
+     * Create the archive, throws a std::runtime_error if the file cannot be created.
+     * @param path The path of the archive.
+     */
+    ArchiveWriter( const string &path );
+
+    void probe( const CURLProbe &curl ) override;
+
+    void comment( string_view line ) override;
+
+    void error( string_view line, ParseResult kind, string_view input, uint64_t number ) override;
+
+    /**
+     * Write the pending probes and close the archive, throws a std::runtime_error on write errors.
+     */
+    void close();
+
+    /**
+     * Return the number of probes written.
+     * @return The number of probes.
+     */
+    size_t probes() const { return probes_; }
+
+    /**
+     * Return the number of bytes written.
+     * @return The number of bytes.
+     */
+    size_t size() const { return size_; }
+
+    /**
+     * Return the malformed lines of the input.
+     * @return The RejectLog.
+     */
+    const RejectLog& rejects() const { return rejects_; }
+
+  private:
+    /**
+     * Write the pending probes as a block.
+     */
+    void flush();
+
+    /**
+     * Write a block.
+     * @param type The block type.
+     * @param payload The block payload.
+     */
+    void writeBlock( char type, string_view payload );
+
+    /** The path of the archive. */
+    string path_;
+
+    /** The archive file. */
+    ofstream out_;
+
+    /** The probes pending for the next block. */
+    vector<CURLProbe> rows_;
+
+    /** The distinct curl_error values in rows_. */
+    vector<uint16_t> curl_errors_;
+
+    /** The distinct http_code values in rows_. */
+    vector<uint16_t> http_codes_;
+
+    /** The distinct http_connect values in rows_. */
+    vector<uint16_t> http_connects_;
+
+    /** The block being encoded. */
+    string payload_;
+
+    /** The number of probes written. */
+    size_t probes_;
+
+    /** The number of bytes written. */
+    size_t size_;
+
+    /** The malformed lines of the input. */
+    RejectLog rejects_;
+};
+
+/**
+ * Return true if data starts with the archive magic bytes.
+ * @param head The first bytes of the data.
+ * @return True for an archive.
+ */
+bool isArchive( string_view head );
+
+/**
+ * Check the header of an archive and return the blocks following it. Throws a std::runtime_error
+ * for an unsupported version.
+ * @param data The archive.
+ * @return The blocks.
+ */
+string_view archiveBlocks( string_view data );
+
+/**
+ * Split archive blocks into ranges of whole blocks.
+ * @param blocks The blocks as returned by archiveBlocks.
+ * @param range_size The minimum size of a range.
+ * @return The ranges, in order.
+ */
+vector<string_view> splitArchive( string_view blocks, size_t range_size );
+
+/**
+ * Read archive blocks into a ProbeSink. Throws a std::runtime_error if the blocks are corrupt.
+ * @param sink The ProbeSink to read into.
+ * @param blocks The blocks as returned by archiveBlocks or splitArchive.
+ */
+void readArchive( ProbeSink &sink, string_view blocks );
+
+#endif
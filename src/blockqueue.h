@@ -0,0 +1,54 @@
+#ifndef blockqueue_h
+#define blockqueue_h
+
+#include "spscring.h"
+
+#include <string>
+
+using namespace std;
+
+/** The default size of a block passed through a BlockQueue. */
+#define DEFAULT_BLOCK_SIZE 1048576
+
+/**
+ * Passes blocks of data from a producer thread to a consumer thread. A fixed number of block buffers
+ * circulate between the two through lock-free SPSCRings, with the default of two blocks the producer
+ * fills one block while the consumer works on the other (double buffering), and no memory is allocated
+ * once both buffers exist.
+ * @code
+ * // producer                         // consumer
+ * string block;                       string block;
+ * while ( queue.getFree( block ) ) {  while ( queue.getFull( block ) ) {
+ *   ... fill block, resize to fill      ... use block
+ *   queue.putFull( move( block ) );     queue.putFree( move( block ) );
+ * }                                   }
+ * queue.close();
+ * @endcode
+ */
+class BlockQueue : public StageQueue<string> {
+  public:
+
+    /**
+     * Construct a BlockQueue.
+     * @param blocks The number of block buffers circulating.
+     * @param block_size The size of each block buffer.
+     */
+    BlockQueue( size_t blocks = 2, size_t block_size = DEFAULT_BLOCK_SIZE ) : StageQueue<string>( blocks ), block_size_(block_size) {}
+
+    /**
+     * Producer: wait for a free block, resized to the block size.
+     * @param block Receives the free block.
+     * @return False if the consumer aborted, the producer should stop.
+     */
+    bool getFree( string &block ) {
+      if ( !StageQueue<string>::getFree( block ) ) return false;
+      block.resize( block_size_ );
+      return true;
+    }
+
+  private:
+    /** The size of a block. */
+    size_t block_size_;
+};
+
+#endif
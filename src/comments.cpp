@@ -37,4 +37,22 @@ void Comments::addComment( const string& line ) {
     }
   }
   //if ( line.length() > 2 && line[2] != 'Y' ) comments[string("s")] = line;
+}
+
+void Comments::merge( const Comments& other ) {
+  for ( const auto &c : other.comments ) {
+    const auto &existing = comments.equal_range( c.first );
+    bool duplicate = false;
+    for ( auto r = existing.first ; r != existing.second; r++ ) {
+      if ( (*r).second == c.second ) {
+        duplicate = true;
+        break;
+      }
+    }
+    if ( ! duplicate ) comments.insert( c );
+  }
+  if ( other.client_fqdn.length() ) client_fqdn = other.client_fqdn;
+  if ( other.client_ip.length() ) client_ip = other.client_ip;
+  if ( other.request.length() ) request = other.request;
+  if ( other.url.length() ) url = other.url;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define comments_h
 
 #include <map>
+#include <string>
 
 using namespace std;
 
@@ -10,6 +11,13 @@ struct Comments {
 
   void addComment( const string& line );
 
+  /**
+   * Merge the comments of another Comments into this one, the other comments are assumed to follow
+   * the comments in this one.
+   * @param other The Comments to merge.
+   */
+  void merge( const Comments& other );
+
   string client_fqdn = "";
   string client_ip = "";
   string request = "";
@@ -4,6 +4,19 @@
 #include "datetime.h"
 #include "waitclass.h"
 
+#include <string_view>
+
+/**
+ * The optional fields of a probe line, a bitmask telling CURLProbe::parse which fields to decode. The
+ * date and time, curl error and HTTP code are always decoded.
+ */
+enum ProbeField : unsigned {
+  pfNone    = 0b00, /**< Only the date and time, curl error and HTTP code. */
+  pfTimings = 0b01, /**< total_time and the time_ fields. */
+  pfSizes   = 0b10, /**< size_upload and size_download. */
+  pfAll     = 0b11  /**< All fields. */
+};
+
 /**
  * Curl probe line.
  */
@@ -18,6 +31,12 @@ struct CURLProbe {
   /** HTTP return code of the probe */
   uint16_t  http_code;
 
+  /** HTTP return code of a proxy CONNECT */
+  uint16_t  http_connect;
+
+  /** TLS certificate verification result */
+  uint32_t  ssl_verify_result;
+
   /** Total time */
   double    total_time;
 
@@ -33,6 +52,9 @@ struct CURLProbe {
   /** local pre-send time */
   double    time_pretransfer;
 
+  /** time spent on redirects before the final transfer */
+  double    time_redirect;
+
   /** first server response */
   double    time_starttransfer;
 
@@ -42,12 +64,24 @@ struct CURLProbe {
   /** bytes received */
   size_t    size_download;
 
+  /** The durations of the WaitClasses, see decompose */
+  WaitClassDurations wait_class_durations;
+
+  /** The WaitClass that contributes most to total_time, see decompose */
+  WaitClass dominant_wait_class;
+
+  /**
+   * Compute wait_class_durations and dominant_wait_class from the timings, done by the parsers once per
+   * probe so that the aggregators do not compute them again.
+   */
+  void decompose();
+
   /**
-   * Calculate the duration of a WaitClass.
+   * Return the duration of a WaitClass.
    * @param wc The WaitClass to get the duration for.
    * @return The duration.
    */
-  double getWaitClassDuration( WaitClass wc ) const;
+  double getWaitClassDuration( WaitClass wc ) const { return wait_class_durations[wc]; }
 
   /**
    * Calculate the contribution of this WaitClass to total_time.
@@ -60,7 +94,7 @@ struct CURLProbe {
    * Return the WaitClass that contributes most to total_time.
    * @return The dominant WaitCLass.
    */
-  WaitClass getDominantWaitClass() const;
+  WaitClass getDominantWaitClass() const { return dominant_wait_class; }
 
   /**
    * Return the probe line as a human-readable string.
@@ -69,11 +103,23 @@ struct CURLProbe {
   string asString() const;
 
   /**
-   * Parse a curl probe line.
+   * Parse a curl probe line in the curl_http_timing.sh layout, see ParsePlan for other layouts.
    * @param line The line to parse.
+   * @param fields The ProbeFields to decode.
+   * @return True if the parse succeeeded.
+   */
+  bool parse( string_view line, unsigned fields = pfAll );
+
+  /**
+   * Parse a curl probe line in the curl_http_timing.sh layout already split into ';' separated tokens. Fields
+   * not in fields are set to 0 and not validated, except that the timings of an HTTP error are always decoded,
+   * as the error trail shows them.
+   * @param tokens The tokens, at least min(count,PARSE_PLAN_MAX_COLUMNS) must be valid.
+   * @param count The number of tokens in the line.
+   * @param fields The ProbeFields to decode.
    * @return True if the parse succeeeded.
    */
-  bool parse( const string &line );
+  bool parse( const string_view* tokens, size_t count, unsigned fields = pfAll );
 
 };
 
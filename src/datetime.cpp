@@ -1,33 +1,115 @@
 #include "datetime.h"
+#include "datekey.h"
 
-#include <ctime>
 #include <iomanip>
+#include <sstream>
 
-bool DateTime::parse( const std::string& src ) {
-  std::stringstream ss;
-  char c;
-  ss << src;
-  ss >> year;
-  ss >> c;
-  if ( c != '-' ) return false;
-  ss >> month;
-  ss >> c;
-  if ( c != '-' ) return false;
-  ss >> day;
-  ss >> hour;
-  ss >> c;
-  if ( c != ':' ) return false;
-  ss >> minute;
-  ss >> c;
-  if ( c != ':' ) return false;
-  ss >> second;
-  std::tm tm_in = { 0, 0, 0, day, month-1, year - 1900 };
-  time_t tmp = mktime( &tm_in );
-  const std::tm* tm_out = std::localtime( &tmp );
-  wday = tm_out->tm_wday;
+/**
+ * Decode an unsigned decimal number at pos, advancing pos past the digits.
+ * @return False if there is no digit at pos.
+ */
+static inline bool decodeNumber( std::string_view src, size_t &pos, int &value ) {
+  size_t start = pos;
+  value = 0;
+  while ( pos < src.size() && src[pos] >= '0' && src[pos] <= '9' ) {
+    value = value * 10 + ( src[pos] - '0' );
+    pos++;
+  }
+  return pos > start && pos - start <= 4;
+}
+
+/**
+ * Expect the separator c at pos, advancing pos past it.
+ * @return False if there is no c at pos.
+ */
+static inline bool expect( std::string_view src, size_t &pos, char c ) {
+  if ( pos < src.size() && src[pos] == c ) {
+    pos++;
+    return true;
+  } else return false;
+}
+
+/**
+ * Return the number of days in a month of the proleptic Gregorian calendar.
+ */
+static inline int daysInMonth( int year, int month ) {
+  static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+  const bool leap = year % 4 == 0 && ( year % 100 != 0 || year % 400 == 0 );
+  return month == 2 && leap ? 29 : days[month - 1];
+}
+
+int daysFromCivil( int year, int month, int day ) {
+  year -= month <= 2;
+  const int era = ( year >= 0 ? year : year - 399 ) / 400;
+  const unsigned yoe = static_cast<unsigned>( year - era * 400 );
+  const unsigned doy = ( 153 * ( month + ( month > 2 ? -3 : 9 ) ) + 2 ) / 5 + day - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int>( doe ) - 719468;
+}
+
+void civilFromDays( int days, int &year, int &month, int &day ) {
+  days += 719468;
+  const int era = ( days >= 0 ? days : days - 146096 ) / 146097;
+  const unsigned doe = static_cast<unsigned>( days - era * 146097 );
+  const unsigned yoe = ( doe - doe / 1460 + doe / 36524 - doe / 146096 ) / 365;
+  const unsigned doy = doe - ( 365 * yoe + yoe / 4 - yoe / 100 );
+  const unsigned mp = ( 5 * doy + 2 ) / 153;
+  day = static_cast<int>( doy - ( 153 * mp + 2 ) / 5 + 1 );
+  month = static_cast<int>( mp < 10 ? mp + 3 : mp - 9 );
+  year = static_cast<int>( yoe ) + era * 400 + ( month <= 2 );
+}
+
+int weekdayFromDays( int days ) {
+  return days >= -4 ? ( days + 4 ) % 7 : ( days + 5 ) % 7 + 6;
+}
+
+bool DateTime::parse( std::string_view src ) {
+  size_t pos = 0;
+  if ( ! decodeNumber( src, pos, year ) ) return false;
+  if ( ! expect( src, pos, '-' ) ) return false;
+  if ( ! decodeNumber( src, pos, month ) ) return false;
+  if ( ! expect( src, pos, '-' ) ) return false;
+  if ( ! decodeNumber( src, pos, day ) ) return false;
+  if ( ! expect( src, pos, ' ' ) ) return false;
+  while ( pos < src.size() && src[pos] == ' ' ) pos++;
+  if ( ! decodeNumber( src, pos, hour ) ) return false;
+  if ( ! expect( src, pos, ':' ) ) return false;
+  if ( ! decodeNumber( src, pos, minute ) ) return false;
+  if ( ! expect( src, pos, ':' ) ) return false;
+  if ( ! decodeNumber( src, pos, second ) ) return false;
+  // only dates and times that survive toEpoch and fromEpoch, so no leap seconds
+  if ( month < 1 || month > 12 || day < 1 || day > daysInMonth( year, month ) || hour > 23 || minute > 59 ||
+       second > 59 ) return false;
+  // consecutive probes almost always share the date, so remember the weekday of the last date seen.
+  thread_local DateKey cached_date( 0, 0, 0 );
+  thread_local int cached_wday = 0;
+  DateKey date( year, month, day );
+  if ( ! ( date == cached_date ) ) {
+    cached_wday = weekdayFromDays( daysFromCivil( year, month, day ) );
+    cached_date = date;
+  }
+  wday = cached_wday;
   return true;
 }
 
+int64_t DateTime::toEpoch() const {
+  return static_cast<int64_t>( daysFromCivil( year, month, day ) ) * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+void DateTime::fromEpoch( int64_t epoch ) {
+  int64_t days = epoch / 86400;
+  int64_t secs = epoch % 86400;
+  if ( secs < 0 ) {
+    secs += 86400;
+    days--;
+  }
+  civilFromDays( static_cast<int>( days ), year, month, day );
+  hour = static_cast<int>( secs / 3600 );
+  minute = static_cast<int>( secs % 3600 / 60 );
+  second = static_cast<int>( secs % 60 );
+  wday = weekdayFromDays( static_cast<int>( days ) );
+}
+
 std::string DateTime::asString() const {
   stringstream ss;
   ss << setfill('0') << setw(4) << year;
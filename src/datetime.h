@@ -1,10 +1,38 @@
 #ifndef datetime_h
 #define datetime_h
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 using namespace std;
 
+/**
+ * Return the number of days since 1970-01-01 of a date in the proleptic Gregorian calendar.
+ * @param year The year.
+ * @param month The month (January=1).
+ * @param day The day within the month.
+ * @return The number of days since 1970-01-01, negative for dates before.
+ */
+int daysFromCivil( int year, int month, int day );
+
+/**
+ * Return the date in the proleptic Gregorian calendar of a number of days since 1970-01-01,
+ * the inverse of daysFromCivil.
+ * @param days The number of days since 1970-01-01.
+ * @param year Receives the year.
+ * @param month Receives the month (January=1).
+ * @param day Receives the day within the month.
+ */
+void civilFromDays( int days, int &year, int &month, int &day );
+
+/**
+ * Return the day of the week of a day number as returned by daysFromCivil.
+ * @param days The number of days since 1970-01-01.
+ * @return The day of the week (Sunday=0).
+ */
+int weekdayFromDays( int days );
+
 /**
  * A date-time value with second precision. Note that there is not attempt to do any timezone conversion,
  * DateTime values are read as-is from the source data.
@@ -32,11 +60,25 @@ struct DateTime {
   int wday = 0;
 
   /**
-   * Parse a string value, format '2020-10-29 22:54:04'
+   * Parse a string value, format '2020-10-29 22:54:04'. The digits are decoded in place, the weekday
+   * is derived from the calendar date so that the result does not depend on the timezone. Days beyond
+   * the end of the month and leap seconds do not parse.
    * @param src The string value to parse.
    * @return True if the string value parsed ok.
    */
-  bool parse( const std::string& src );
+  bool parse( std::string_view src );
+
+  /**
+   * Return the number of seconds since 1970-01-01 00:00:00, ignoring timezones and leap seconds.
+   * @return The number of seconds.
+   */
+  int64_t toEpoch() const;
+
+  /**
+   * Set from a number of seconds since 1970-01-01 00:00:00, the inverse of toEpoch.
+   * @param epoch The number of seconds.
+   */
+  void fromEpoch( int64_t epoch );
 
   /**
    * Return the dateTiem as a string, format '2020-10-29 22:54:04'.
@@ -0,0 +1,161 @@
+#ifndef daytable_h
+#define daytable_h
+
+#include "datekey.h"
+#include "datetime.h"
+
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <memory>
+
+using namespace std;
+
+/** The number of days per DayTable chunk, a power of 2 no larger than 32. */
+#define DAY_TABLE_CHUNK_DAYS 32
+
+/**
+ * A map of dates to values, indexed by the day number (see daysFromCivil) minus that of the first day
+ * of the first chunk. The values are kept in chunks of DAY_TABLE_CHUNK_DAYS consecutive days, allocated
+ * on first use and added at either end, so that a gap of unused days costs a pointer per chunk and the
+ * values do not move as the table grows. Iterating visits the days in use in date order, yielding
+ * entries with a first (the DateKey) and a second (the value) as a map does.
+ */
+template <typename V> class DayTable {
+  private:
+    /** The values of DAY_TABLE_CHUNK_DAYS days. */
+    struct Chunk {
+      /** The values. */
+      V values[DAY_TABLE_CHUNK_DAYS];
+      /** Bit i is set if values[i] is in use. */
+      uint32_t used = 0;
+    };
+
+    /** Return the chunk number of a day number, rounding down also for days before 1970. */
+    static int chunkOf( int day ) {
+      return day >= 0 ? day / DAY_TABLE_CHUNK_DAYS : -( ( DAY_TABLE_CHUNK_DAYS - 1 - day ) / DAY_TABLE_CHUNK_DAYS );
+    }
+
+  public:
+    typedef DateKey key_type;
+    typedef V mapped_type;
+
+    /**
+     * A day in use as yielded by iterating.
+     */
+    struct Entry {
+      /** The date. */
+      DateKey first;
+      /** The value. */
+      const V &second;
+    };
+
+    /**
+     * Iterates the days in use.
+     */
+    class const_iterator {
+      public:
+        typedef forward_iterator_tag iterator_category;
+        typedef Entry value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const Entry* pointer;
+        typedef Entry reference;
+
+        const_iterator( const DayTable* table, size_t index ) : table_(table), index_(index) { skip(); }
+        Entry operator*() const {
+          DateKey key;
+          civilFromDays( table_->first_chunk_ * DAY_TABLE_CHUNK_DAYS + static_cast<int>( index_ ), key.year, key.month, key.day );
+          return Entry{ key, table_->chunks_[index_ / DAY_TABLE_CHUNK_DAYS]->values[index_ % DAY_TABLE_CHUNK_DAYS] };
+        }
+        const_iterator& operator++() { index_++; skip(); return *this; }
+        bool operator==( const const_iterator &other ) const { return index_ == other.index_; }
+        bool operator!=( const const_iterator &other ) const { return index_ != other.index_; }
+
+      private:
+        /** Advance to the next day in use, skipping chunks not allocated. */
+        void skip() {
+          const size_t end = table_->chunks_.size() * DAY_TABLE_CHUNK_DAYS;
+          while ( index_ < end ) {
+            const Chunk* chunk = table_->chunks_[index_ / DAY_TABLE_CHUNK_DAYS].get();
+            if ( !chunk ) index_ = ( index_ / DAY_TABLE_CHUNK_DAYS + 1 ) * DAY_TABLE_CHUNK_DAYS;
+            else if ( chunk->used >> ( index_ % DAY_TABLE_CHUNK_DAYS ) & 1 ) return;
+            else index_++;
+          }
+        }
+        /** The table. */
+        const DayTable* table_;
+        /** The day relative to the first day of the first chunk. */
+        size_t index_;
+    };
+
+    /**
+     * Return the value of a date, which is default constructed if the date is not in use.
+     * @param key The date.
+     * @return The value.
+     */
+    V& operator[]( const DateKey &key ) { return atDay( daysFromCivil( key.year, key.month, key.day ) ); }
+
+    /**
+     * Return the value of a day number, which is default constructed if the day is not in use.
+     * @param day The number of days since 1970-01-01.
+     * @return The value.
+     */
+    V& atDay( int day ) {
+      const int chunk = chunkOf( day );
+      if ( chunks_.empty() ) first_chunk_ = chunk;
+      if ( chunk < first_chunk_ ) {
+        for ( ; first_chunk_ > chunk; first_chunk_-- ) chunks_.emplace_front();
+      } else if ( chunk - first_chunk_ >= static_cast<int>( chunks_.size() ) ) {
+        chunks_.resize( static_cast<size_t>( chunk - first_chunk_ ) + 1 );
+      }
+      unique_ptr<Chunk> &ref = chunks_[static_cast<size_t>( chunk - first_chunk_ )];
+      if ( !ref ) ref.reset( new Chunk() );
+      const unsigned slot = static_cast<unsigned>( day - chunk * DAY_TABLE_CHUNK_DAYS );
+      if ( !( ref->used >> slot & 1 ) ) {
+        ref->used |= 1u << slot;
+        size_++;
+      }
+      return ref->values[slot];
+    }
+
+    /**
+     * Return the value of a date without putting the date in use.
+     * @param key The date.
+     * @return The value, nullptr if the date is not in use.
+     */
+    const V* get( const DateKey &key ) const {
+      const int day = daysFromCivil( key.year, key.month, key.day );
+      const int chunk = chunkOf( day );
+      if ( chunk < first_chunk_ || chunk - first_chunk_ >= static_cast<int>( chunks_.size() ) ) return nullptr;
+      const Chunk* ref = chunks_[static_cast<size_t>( chunk - first_chunk_ )].get();
+      const unsigned slot = static_cast<unsigned>( day - chunk * DAY_TABLE_CHUNK_DAYS );
+      return ref && ref->used >> slot & 1 ? &ref->values[slot] : nullptr;
+    }
+
+    /**
+     * Return the number of dates in use.
+     * @return The number of dates.
+     */
+    size_t size() const { return size_; }
+
+    /**
+     * Return true if no date is in use.
+     * @return True if empty.
+     */
+    bool empty() const { return size_ == 0; }
+
+    const_iterator begin() const { return const_iterator( this, 0 ); }
+    const_iterator end() const { return const_iterator( this, chunks_.size() * DAY_TABLE_CHUNK_DAYS ); }
+
+  private:
+    /** The chunk number (day number / DAY_TABLE_CHUNK_DAYS) of chunks_[0]. */
+    int first_chunk_ = 0;
+
+    /** The chunks, nullptr for chunks without days in use. */
+    deque<unique_ptr<Chunk>> chunks_;
+
+    /** The number of days in use. */
+    size_t size_ = 0;
+};
+
+#endif
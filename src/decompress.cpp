@@ -0,0 +1,236 @@
+#include "decompress.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/** Compressed input is fed to the decompressor in slices of this size. */
+#define COMPRESSED_SLICE_SIZE 1048576
+
+Compression detectCompression( string_view head ) {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>( head.data() );
+  if ( head.size() >= 2 && p[0] == 0x1f && p[1] == 0x8b ) return Compression::Gzip;
+  if ( head.size() >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd ) return Compression::Zstd;
+  return Compression::None;
+}
+
+string compressionName( Compression compression ) {
+  switch ( compression ) {
+    case Compression::None : return "none";
+    case Compression::Gzip : return "gzip";
+    case Compression::Zstd : return "zstd";
+  }
+  return "invalid";
+}
+
+InputReader streamReader( istream &in ) {
+  return [&in]( char* buffer, size_t size ) -> size_t {
+    if ( !in ) return 0;
+    in.read( buffer, size );
+    return in.gcount();
+  };
+}
+
+InputReader descriptorReader( int fd ) {
+  return [fd]( char* buffer, size_t size ) -> size_t {
+    for (;;) {
+      ssize_t n = ::read( fd, buffer, size );
+      if ( n >= 0 ) return static_cast<size_t>( n );
+      if ( errno != EINTR ) throw std::runtime_error( string( "read error: " ) + strerror( errno ) );
+    }
+  };
+}
+
+/**
+ * Thrown inside the decompressor when the consumer aborted.
+ */
+struct DecompressAborted {};
+
+/**
+ * The block a decompressor is filling, handed to the BlockQueue when full.
+ */
+class BlockWriter {
+  public:
+    BlockWriter( BlockQueue &queue ) : queue_(queue), fill_(0) { next(); }
+
+    /** Return the free space in the current block. */
+    char* space() { return block_.data() + fill_; }
+
+    /** Return the number of free bytes in the current block. */
+    size_t room() const { return block_.size() - fill_; }
+
+    /** Account for n bytes written to space(), handing over the block when full. */
+    void commit( size_t n ) {
+      fill_ += n;
+      if ( fill_ == block_.size() ) flush();
+    }
+
+    /** Hand over the current block if it has data. */
+    void flush() {
+      if ( fill_ == 0 ) return;
+      block_.resize( fill_ );
+      queue_.putFull( move( block_ ) );
+      next();
+    }
+
+  private:
+    /** Get a free block. */
+    void next() {
+      if ( !queue_.getFree( block_ ) ) throw DecompressAborted();
+      fill_ = 0;
+    }
+
+    /** The queue. */
+    BlockQueue &queue_;
+
+    /** The current block. */
+    string block_;
+
+    /** The number of bytes filled in block_. */
+    size_t fill_;
+};
+
+/**
+ * Feed head and the remainder of rest to consume in slices.
+ */
+template <typename F> void forEachSlice( string_view head, const InputReader &rest, F consume ) {
+  while ( head.size() ) {
+    string_view slice = head.substr( 0, COMPRESSED_SLICE_SIZE );
+    consume( slice );
+    head.remove_prefix( slice.size() );
+  }
+  if ( rest ) {
+    string buffer( COMPRESSED_SLICE_SIZE, '\0' );
+    while ( size_t n = rest( buffer.data(), buffer.size() ) ) consume( string_view( buffer.data(), n ) );
+  }
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * Decompress gzip input.
+ */
+static void decompressGzip( string_view head, const InputReader &rest, BlockWriter &out ) {
+  z_stream zs = {};
+  // 15 window bits + 32 to detect gzip or zlib headers
+  if ( inflateInit2( &zs, 15 + 32 ) != Z_OK ) throw std::runtime_error( "zlib: cannot initialize inflate" );
+  bool stream_end = false;
+  try {
+    forEachSlice( head, rest, [&]( string_view slice ) {
+      zs.next_in = reinterpret_cast<Bytef*>( const_cast<char*>( slice.data() ) );
+      zs.avail_in = static_cast<uInt>( slice.size() );
+      while ( zs.avail_in > 0 ) {
+        if ( stream_end ) {
+          // another gzip member follows
+          inflateReset( &zs );
+          stream_end = false;
+        }
+        size_t room = out.room();
+        zs.next_out = reinterpret_cast<Bytef*>( out.space() );
+        zs.avail_out = static_cast<uInt>( room );
+        int r = inflate( &zs, Z_NO_FLUSH );
+        out.commit( room - zs.avail_out );
+        if ( r == Z_STREAM_END ) stream_end = true;
+        else if ( r == Z_BUF_ERROR ) break;
+        else if ( r != Z_OK ) throw std::runtime_error( string( "zlib: " ) + ( zs.msg ? zs.msg : "inflate error" ) );
+      }
+    } );
+    // drain output still pending in the inflater
+    while ( !stream_end ) {
+      size_t room = out.room();
+      zs.next_out = reinterpret_cast<Bytef*>( out.space() );
+      zs.avail_out = static_cast<uInt>( room );
+      int r = inflate( &zs, Z_SYNC_FLUSH );
+      out.commit( room - zs.avail_out );
+      if ( r == Z_STREAM_END ) stream_end = true;
+      else if ( r != Z_OK || room == zs.avail_out ) break;
+    }
+  }
+  catch ( ... ) {
+    inflateEnd( &zs );
+    throw;
+  }
+  inflateEnd( &zs );
+  if ( !stream_end ) cerr << "warning: gzip input is truncated" << endl;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+/**
+ * Decompress zstd input.
+ */
+static void decompressZstd( string_view head, const InputReader &rest, BlockWriter &out ) {
+  ZSTD_DCtx* ctx = ZSTD_createDCtx();
+  if ( !ctx ) throw std::runtime_error( "zstd: cannot create decompression context" );
+  size_t pending = 0;
+  try {
+    forEachSlice( head, rest, [&]( string_view slice ) {
+      ZSTD_inBuffer in = { slice.data(), slice.size(), 0 };
+      bool full = false;
+      while ( in.pos < in.size || full ) {
+        size_t room = out.room();
+        ZSTD_outBuffer zout = { out.space(), room, 0 };
+        pending = ZSTD_decompressStream( ctx, &zout, &in );
+        if ( ZSTD_isError( pending ) ) throw std::runtime_error( string( "zstd: " ) + ZSTD_getErrorName( pending ) );
+        full = zout.pos == room;
+        out.commit( zout.pos );
+      }
+    } );
+  }
+  catch ( ... ) {
+    ZSTD_freeDCtx( ctx );
+    throw;
+  }
+  ZSTD_freeDCtx( ctx );
+  if ( pending != 0 ) cerr << "warning: zstd input is truncated" << endl;
+}
+#endif
+
+void decompress( Compression compression, string_view head, const InputReader &rest, BlockQueue &queue ) {
+  try {
+    BlockWriter out( queue );
+    switch ( compression ) {
+      case Compression::Gzip :
+#ifdef HAVE_ZLIB
+        decompressGzip( head, rest, out );
+        break;
+#else
+        throw std::runtime_error( "gzip input, but curlstats was built without zlib" );
+#endif
+      case Compression::Zstd :
+#ifdef HAVE_ZSTD
+        decompressZstd( head, rest, out );
+        break;
+#else
+        throw std::runtime_error( "zstd input, but curlstats was built without zstd" );
+#endif
+      case Compression::None :
+        while ( head.size() ) {
+          size_t n = min( head.size(), out.room() );
+          head.copy( out.space(), n );
+          head.remove_prefix( n );
+          out.commit( n );
+        }
+        if ( rest ) {
+          while ( size_t n = rest( out.space(), out.room() ) ) out.commit( n );
+        }
+        break;
+    }
+    out.flush();
+    queue.close();
+  }
+  catch ( const DecompressAborted& ) {
+    queue.close();
+  }
+  catch ( ... ) {
+    queue.close( current_exception() );
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef decompress_h
+#define decompress_h
+
+#include "blockqueue.h"
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+/**
+ * Compression formats recognized on input.
+ */
+enum class Compression {
+  None,     /**< Plain text. */
+  Gzip,     /**< gzip (or zlib) compressed. */
+  Zstd      /**< zstd compressed. */
+};
+
+/**
+ * Detect the compression of input by its magic bytes.
+ * @param head The first bytes of the input.
+ * @return The Compression detected.
+ */
+Compression detectCompression( string_view head );
+
+/**
+ * Return the name of a Compression.
+ * @param compression The Compression.
+ * @return The name.
+ */
+string compressionName( Compression compression );
+
+/**
+ * Reads up to size bytes of input into buffer, returning the number of bytes read, 0 at the end of
+ * the input. Throws a std::runtime_error on read errors.
+ */
+typedef function<size_t( char* buffer, size_t size )> InputReader;
+
+/**
+ * Return an InputReader reading from a stream.
+ * @param in The stream, which must outlive the InputReader.
+ * @return The InputReader.
+ */
+InputReader streamReader( istream &in );
+
+/**
+ * Return an InputReader reading from a file descriptor with read(2), so that input is read straight
+ * into the caller's buffer.
+ * @param fd The file descriptor.
+ * @return The InputReader.
+ */
+InputReader descriptorReader( int fd );
+
+/**
+ * Decompress input into blocks on a BlockQueue, intended to run on its own thread. The input consists of
+ * head followed by the remainder read by rest (if set). Concatenated gzip members or zstd frames are
+ * decompressed as one stream. Uncompressed input is read by rest directly into the blocks. The queue is
+ * closed when done, errors are passed to the consumer through the queue.
+ * @param compression The Compression of the input.
+ * @param head The first bytes of the input, or all of it.
+ * @param rest Reads the remainder of the input, or empty.
+ * @param queue The BlockQueue receiving decompressed blocks.
+ */
+void decompress( Compression compression, string_view head, const InputReader &rest, BlockQueue &queue );
+
+#endif
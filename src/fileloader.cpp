@@ -0,0 +1,407 @@
+#include "fileloader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+/**
+ * A minimal io_uring, set up with the raw system calls, that reads into buffers. A read is tagged with a
+ * slot number below the number of entries, each slot has its own iovec.
+ */
+class IORing {
+  public:
+    /**
+     * Set up the ring. Throws a std::runtime_error if io_uring is not available.
+     * @param entries The number of submission queue entries, a power of 2.
+     */
+    IORing( unsigned entries );
+
+    ~IORing();
+
+    IORing( const IORing& ) = delete;
+    IORing& operator=( const IORing& ) = delete;
+
+    /**
+     * Queue a read, submitted by the next enter.
+     * @param fd The file descriptor.
+     * @param buffer The buffer.
+     * @param length The number of bytes to read.
+     * @param offset The file offset.
+     * @param slot The slot, returned by complete.
+     */
+    void read( int fd, char* buffer, size_t length, uint64_t offset, unsigned slot );
+
+    /**
+     * Submit the queued reads and wait for completions.
+     * @param wait The number of completions to wait for.
+     */
+    void enter( unsigned wait );
+
+    /**
+     * Take a completion.
+     * @param slot Receives the slot of the read.
+     * @param result Receives the number of bytes read, or minus the errno.
+     * @return False if there are no completions.
+     */
+    bool complete( unsigned &slot, int64_t &result );
+
+#ifdef HAVE_IO_URING
+  private:
+    /**
+     * Unmap the rings and close the ring file descriptor.
+     */
+    void unmap();
+
+    /** The ring file descriptor. */
+    int fd_;
+
+    /** The mapped submission queue ring. */
+    void* sq_ring_;
+
+    /** The size of sq_ring_. */
+    size_t sq_ring_size_;
+
+    /** The mapped completion queue ring, sq_ring_ if the kernel maps both at once. */
+    void* cq_ring_;
+
+    /** The size of cq_ring_. */
+    size_t cq_ring_size_;
+
+    /** The mapped submission queue entries. */
+    io_uring_sqe* sqes_;
+
+    /** The number of submission queue entries. */
+    unsigned entries_;
+
+    /** The submission queue tail, written by us. */
+    unsigned* sq_tail_;
+
+    /** The submission queue index mask. */
+    unsigned sq_mask_;
+
+    /** The submission queue array of sqes_ indexes. */
+    unsigned* sq_array_;
+
+    /** The completion queue head, written by us. */
+    unsigned* cq_head_;
+
+    /** The completion queue tail, written by the kernel. */
+    unsigned* cq_tail_;
+
+    /** The completion queue index mask. */
+    unsigned cq_mask_;
+
+    /** The completion queue entries. */
+    io_uring_cqe* cqes_;
+
+    /** The number of reads queued but not submitted. */
+    unsigned queued_;
+
+    /** The iovec of each slot. */
+    vector<iovec> iovecs_;
+#endif
+};
+
+#ifdef HAVE_IO_URING
+
+IORing::IORing( unsigned entries ) : fd_(-1), sq_ring_(MAP_FAILED), cq_ring_(MAP_FAILED), sqes_(nullptr),
+                                     entries_(entries), queued_(0), iovecs_(entries) {
+  io_uring_params params;
+  memset( &params, 0, sizeof( params ) );
+  fd_ = static_cast<int>( syscall( __NR_io_uring_setup, entries, &params ) );
+  if ( fd_ < 0 ) throw std::runtime_error( string( "io_uring is not available: " ) + strerror( errno ) );
+  entries_ = params.sq_entries;
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe );
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if ( single ) sq_ring_size_ = cq_ring_size_ = max( sq_ring_size_, cq_ring_size_ );
+  sq_ring_ = mmap( nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING );
+  if ( sq_ring_ != MAP_FAILED ) {
+    cq_ring_ = single ? sq_ring_ :
+               mmap( nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING );
+  }
+  void* sqes = MAP_FAILED;
+  if ( cq_ring_ != MAP_FAILED ) {
+    sqes = mmap( nullptr, params.sq_entries * sizeof( io_uring_sqe ), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 fd_, IORING_OFF_SQES );
+  }
+  if ( sqes == MAP_FAILED ) {
+    int err = errno;
+    unmap();
+    throw std::runtime_error( string( "cannot map io_uring: " ) + strerror( err ) );
+  }
+  sqes_ = static_cast<io_uring_sqe*>( sqes );
+  char* sq = static_cast<char*>( sq_ring_ );
+  sq_tail_ = reinterpret_cast<unsigned*>( sq + params.sq_off.tail );
+  sq_mask_ = *reinterpret_cast<unsigned*>( sq + params.sq_off.ring_mask );
+  sq_array_ = reinterpret_cast<unsigned*>( sq + params.sq_off.array );
+  char* cq = static_cast<char*>( cq_ring_ );
+  cq_head_ = reinterpret_cast<unsigned*>( cq + params.cq_off.head );
+  cq_tail_ = reinterpret_cast<unsigned*>( cq + params.cq_off.tail );
+  cq_mask_ = *reinterpret_cast<unsigned*>( cq + params.cq_off.ring_mask );
+  cqes_ = reinterpret_cast<io_uring_cqe*>( cq + params.cq_off.cqes );
+}
+
+IORing::~IORing() {
+  unmap();
+}
+
+void IORing::unmap() {
+  if ( sqes_ ) munmap( sqes_, entries_ * sizeof( io_uring_sqe ) );
+  if ( cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_ ) munmap( cq_ring_, cq_ring_size_ );
+  if ( sq_ring_ != MAP_FAILED ) munmap( sq_ring_, sq_ring_size_ );
+  if ( fd_ >= 0 ) close( fd_ );
+}
+
+void IORing::read( int fd, char* buffer, size_t length, uint64_t offset, unsigned slot ) {
+  // readv rather than read, which needs kernel 5.6
+  iovecs_[slot].iov_base = buffer;
+  iovecs_[slot].iov_len = length;
+  unsigned tail = *sq_tail_;
+  unsigned index = tail & sq_mask_;
+  io_uring_sqe &sqe = sqes_[index];
+  memset( &sqe, 0, sizeof( sqe ) );
+  sqe.opcode = IORING_OP_READV;
+  sqe.fd = fd;
+  sqe.addr = reinterpret_cast<uint64_t>( &iovecs_[slot] );
+  sqe.len = 1;
+  sqe.off = offset;
+  sqe.user_data = slot;
+  sq_array_[index] = index;
+  __atomic_store_n( sq_tail_, tail + 1, __ATOMIC_RELEASE );
+  queued_++;
+}
+
+void IORing::enter( unsigned wait ) {
+  for (;;) {
+    long r = syscall( __NR_io_uring_enter, fd_, queued_, wait, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0 );
+    if ( r >= 0 ) {
+      queued_ -= static_cast<unsigned>( r );
+      // the kernel may submit less than all when short of memory, and returns before waiting
+      if ( !queued_ ) return;
+    } else if ( errno != EINTR && errno != EAGAIN && errno != EBUSY ) {
+      throw std::runtime_error( string( "io_uring_enter failed: " ) + strerror( errno ) );
+    }
+  }
+}
+
+bool IORing::complete( unsigned &slot, int64_t &result ) {
+  unsigned head = *cq_head_;
+  if ( head == __atomic_load_n( cq_tail_, __ATOMIC_ACQUIRE ) ) return false;
+  const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+  slot = static_cast<unsigned>( cqe.user_data );
+  result = cqe.res;
+  __atomic_store_n( cq_head_, head + 1, __ATOMIC_RELEASE );
+  return true;
+}
+
+#else
+
+IORing::IORing( unsigned entries ) {
+  throw std::runtime_error( "io_uring is not available: not supported by this build" );
+}
+
+IORing::~IORing() {
+}
+
+void IORing::read( int fd, char* buffer, size_t length, uint64_t offset, unsigned slot ) {
+}
+
+void IORing::enter( unsigned wait ) {
+}
+
+bool IORing::complete( unsigned &slot, int64_t &result ) {
+  return false;
+}
+
+#endif
+
+FileLoader::FileLoader( const vector<string> &paths, bool uring, bool direct ) : files_(paths.size()), uring_(uring),
+                                                                                 direct_(direct), loaded_(0),
+                                                                                 aborted_(false) {
+  for ( size_t i = 0; i < paths.size(); i++ ) files_[i].path = paths[i];
+  loader_ = thread( [this]() {
+    try {
+      run();
+    }
+    catch ( ... ) {
+      lock_guard<mutex> lock( lock_ );
+      error_ = current_exception();
+      changed_.notify_all();
+    }
+  } );
+}
+
+FileLoader::~FileLoader() {
+  abort();
+  loader_.join();
+  for ( auto &file : files_ ) {
+    if ( file.fd >= 0 ) close( file.fd );
+  }
+}
+
+bool FileLoader::take( size_t index, string_view &data ) {
+  unique_lock<mutex> lock( lock_ );
+  File &file = files_[index];
+  changed_.wait( lock, [&]() { return file.ready || aborted_ || error_; } );
+  if ( aborted_ ) return false;
+  if ( !file.ready ) rethrow_exception( error_ );
+  if ( file.error.length() ) throw std::runtime_error( file.error );
+  data = string_view( file.buffer.get(), file.size );
+  return true;
+}
+
+void FileLoader::release( size_t index ) {
+  lock_guard<mutex> lock( lock_ );
+  File &file = files_[index];
+  file.buffer.reset();
+  loaded_ -= file.capacity;
+  file.capacity = 0;
+  changed_.notify_all();
+}
+
+void FileLoader::abort() {
+  lock_guard<mutex> lock( lock_ );
+  aborted_ = true;
+  changed_.notify_all();
+}
+
+void FileLoader::open( size_t index ) {
+  File &file = files_[index];
+  file.fd = ::open( file.path.c_str(), O_RDONLY | ( direct_ ? O_DIRECT : 0 ) );
+  if ( file.fd < 0 && direct_ && errno == EINVAL ) {
+    cerr << "O_DIRECT is not supported for '" << file.path << "', reading through the page cache" << endl;
+    direct_ = false;
+    file.fd = ::open( file.path.c_str(), O_RDONLY );
+  }
+  if ( file.fd < 0 ) {
+    file.error = "cannot open '" + file.path + "': " + strerror( errno );
+    return;
+  }
+  struct stat st;
+  if ( fstat( file.fd, &st ) != 0 ) {
+    file.error = "cannot stat '" + file.path + "': " + strerror( errno );
+    return;
+  }
+  file.size = st.st_size;
+  file.capacity = ( file.size + FILE_LOADER_ALIGNMENT - 1 ) / FILE_LOADER_ALIGNMENT * FILE_LOADER_ALIGNMENT;
+  if ( file.capacity ) {
+    file.buffer.reset( static_cast<char*>( aligned_alloc( FILE_LOADER_ALIGNMENT, file.capacity ) ) );
+    if ( !file.buffer ) throw bad_alloc();
+  }
+}
+
+bool FileLoader::admit( size_t index, bool idle ) {
+  unique_lock<mutex> lock( lock_ );
+  size_t capacity = files_[index].capacity;
+  auto fits = [&]() { return !loaded_ || loaded_ + capacity <= FILE_LOADER_MEMORY; };
+  if ( idle ) changed_.wait( lock, [&]() { return aborted_ || fits(); } );
+  if ( aborted_ || !fits() ) return false;
+  loaded_ += capacity;
+  return true;
+}
+
+void FileLoader::finish( File &file ) {
+  if ( file.fd >= 0 ) close( file.fd );
+  file.fd = -1;
+  lock_guard<mutex> lock( lock_ );
+  file.ready = true;
+  changed_.notify_all();
+}
+
+void FileLoader::completed( const Read &read, int64_t result ) {
+  File &file = files_[read.file];
+  if ( result == -EINTR || result == -EAGAIN ) {
+    pending_.push_front( read );
+    return;
+  }
+  if ( result < 0 ) {
+    if ( file.error.empty() ) file.error = "cannot read '" + file.path + "': " + strerror( static_cast<int>( -result ) );
+  } else if ( result == 0 ) {
+    // the file shrank since it was opened
+    file.size = min( file.size, static_cast<size_t>( read.offset ) );
+  } else if ( read.offset + result < file.size && static_cast<size_t>( result ) < read.length ) {
+    pending_.push_back( { read.file, read.offset + result, read.length - result } );
+    return;
+  }
+  if ( --file.reads == 0 ) finish( file );
+}
+
+void FileLoader::run() {
+  unique_ptr<IORing> ring;
+  if ( uring_ ) {
+    try {
+      ring = make_unique<IORing>( FILE_LOADER_QUEUE_DEPTH );
+    }
+    catch ( const std::runtime_error &e ) {
+      cerr << e.what() << ", reading with pread" << endl;
+    }
+  }
+  vector<Read> slots( FILE_LOADER_QUEUE_DEPTH );
+  vector<unsigned> free_slots;
+  for ( unsigned i = 0; i < FILE_LOADER_QUEUE_DEPTH; i++ ) free_slots.push_back( FILE_LOADER_QUEUE_DEPTH - 1 - i );
+  size_t next = 0;
+  bool aborted = false;
+  while ( !aborted ) {
+    // start on further files while there are free slots and memory
+    while ( next < files_.size() && pending_.size() < free_slots.size() ) {
+      File &file = files_[next];
+      if ( file.fd < 0 && file.error.empty() ) open( next );
+      if ( !admit( next, pending_.empty() && free_slots.size() == FILE_LOADER_QUEUE_DEPTH ) ) break;
+      for ( uint64_t offset = 0; offset < file.capacity; offset += FILE_LOADER_READ_SIZE ) {
+        pending_.push_back( { next, offset, min( static_cast<size_t>( FILE_LOADER_READ_SIZE ), file.capacity - offset ) } );
+        file.reads++;
+      }
+      next++;
+      if ( !file.reads || file.error.length() ) {
+        file.reads = 0;
+        finish( file );
+      }
+    }
+    {
+      lock_guard<mutex> lock( lock_ );
+      aborted = aborted_;
+    }
+    if ( pending_.empty() && free_slots.size() == FILE_LOADER_QUEUE_DEPTH ) {
+      if ( next == files_.size() ) break;
+      continue;
+    }
+    // issue the pending reads
+    while ( !aborted && pending_.size() && free_slots.size() ) {
+      Read read = pending_.front();
+      pending_.pop_front();
+      File &file = files_[read.file];
+      if ( ring ) {
+        unsigned slot = free_slots.back();
+        free_slots.pop_back();
+        slots[slot] = read;
+        ring->read( file.fd, file.buffer.get() + read.offset, read.length, read.offset, slot );
+      } else {
+        ssize_t r = pread( file.fd, file.buffer.get() + read.offset, read.length, read.offset );
+        completed( read, r < 0 ? -errno : r );
+      }
+    }
+    // wait for a read to complete, at the end for all reads in flight
+    while ( ring && free_slots.size() < FILE_LOADER_QUEUE_DEPTH ) {
+      ring->enter( 1 );
+      unsigned slot;
+      int64_t result;
+      while ( ring->complete( slot, result ) ) {
+        free_slots.push_back( slot );
+        completed( slots[slot], result );
+      }
+      if ( !aborted ) break;
+    }
+  }
+}
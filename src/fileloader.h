@@ -0,0 +1,191 @@
+#ifndef fileloader_h
+#define fileloader_h
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/** The size of the reads issued by a FileLoader, a multiple of FILE_LOADER_ALIGNMENT. */
+#define FILE_LOADER_READ_SIZE 1048576
+
+/** The maximum number of reads a FileLoader keeps in flight. */
+#define FILE_LOADER_QUEUE_DEPTH 32
+
+/** The number of loaded but not yet released bytes beyond which a FileLoader does not start reading another file. */
+#define FILE_LOADER_MEMORY 268435456
+
+/** The alignment of FileLoader buffers, file offsets and read sizes, as required by O_DIRECT. */
+#define FILE_LOADER_ALIGNMENT 4096
+
+/**
+ * Loads files into memory in the order given, on a thread of its own, so that the files are parsed as
+ * they arrive. The files are read in FILE_LOADER_READ_SIZE reads, with up to FILE_LOADER_QUEUE_DEPTH reads
+ * in flight across files on an io_uring, so that the disk is kept busy. If io_uring is not available, or
+ * not asked for, the reads are issued one at a time with pread. Reading ahead stops once
+ * FILE_LOADER_MEMORY bytes are loaded and not yet released, but a file is always read if nothing else is
+ * loaded, so a file larger than that is read in one go.
+ * @code
+ * FileLoader loader( paths, true, false );
+ * string_view data;
+ * for ( size_t i = 0; i < paths.size() && loader.take( i, data ); i++ ) {
+ *   ...
+ *   loader.release( i );
+ * }
+ * @endcode
+ */
+class FileLoader {
+  public:
+
+    /**
+     * Start loading files.
+     * @param paths The files to load.
+     * @param uring If true, read with io_uring, falling back to pread if io_uring is not available.
+     * @param direct If true, open the files with O_DIRECT, so that they are read past the page cache.
+     */
+    FileLoader( const vector<string> &paths, bool uring, bool direct );
+
+    /**
+     * Abort loading and wait for the reads in flight.
+     */
+    ~FileLoader();
+
+    FileLoader( const FileLoader& ) = delete;
+    FileLoader& operator=( const FileLoader& ) = delete;
+
+    /**
+     * Wait for a file to be loaded. Throws a std::runtime_error if the file could not be read.
+     * @param index The index of the file in paths.
+     * @param data Receives the file contents, valid until release( index ).
+     * @return False if loading was aborted.
+     */
+    bool take( size_t index, string_view &data );
+
+    /**
+     * Release the memory of a loaded file, so that further files are read.
+     * @param index The index of the file in paths.
+     */
+    void release( size_t index );
+
+    /**
+     * Stop loading, take returns false from now on.
+     */
+    void abort();
+
+  private:
+
+    /**
+     * Frees memory allocated by aligned_alloc.
+     */
+    struct AlignedFree {
+      void operator()( char* p ) const { free( p ); }
+    };
+
+    /**
+     * A file being loaded.
+     */
+    struct File {
+      /** The path of the file. */
+      string path;
+      /** The file descriptor while reading, -1 otherwise. */
+      int fd = -1;
+      /** The buffer, FILE_LOADER_ALIGNMENT aligned. */
+      unique_ptr<char,AlignedFree> buffer;
+      /** The size of the file. */
+      size_t size = 0;
+      /** The size of buffer, size rounded up to FILE_LOADER_ALIGNMENT. */
+      size_t capacity = 0;
+      /** The number of reads not yet completed. */
+      size_t reads = 0;
+      /** True if the file is loaded, or failed to load. */
+      bool ready = false;
+      /** The error if the file could not be read. */
+      string error;
+    };
+
+    /**
+     * A read of a part of a file.
+     */
+    struct Read {
+      /** The index of the file. */
+      size_t file;
+      /** The file offset. */
+      uint64_t offset;
+      /** The number of bytes to read. */
+      size_t length;
+    };
+
+    /**
+     * The loading thread.
+     */
+    void run();
+
+    /**
+     * Open a file and allocate its buffer.
+     * @param index The index of the file.
+     */
+    void open( size_t index );
+
+    /**
+     * Account for the memory of an opened file, waiting for memory to be released if nothing else is to
+     * be done.
+     * @param index The index of the file.
+     * @param idle True if no reads are pending or in flight.
+     * @return False if the memory is not available (yet), or if loading was aborted.
+     */
+    bool admit( size_t index, bool idle );
+
+    /**
+     * Handle the result of a read, queueing the remainder of a short read.
+     * @param read The read.
+     * @param result The number of bytes read, or minus the errno.
+     */
+    void completed( const Read &read, int64_t result );
+
+    /**
+     * Mark a file as ready (or failed) and wake up take.
+     * @param file The file.
+     */
+    void finish( File &file );
+
+    /** The files. */
+    vector<File> files_;
+
+    /** True to read with io_uring. */
+    bool uring_;
+
+    /** True to open the files with O_DIRECT. */
+    bool direct_;
+
+    /** Reads not yet submitted. */
+    deque<Read> pending_;
+
+    /** Protects the ready and buffer members of files_, loaded_, aborted_ and error_. */
+    mutex lock_;
+
+    /** Signalled when a file is ready, memory is released or loading is aborted. */
+    condition_variable changed_;
+
+    /** The number of bytes allocated to files not yet released. */
+    size_t loaded_;
+
+    /** True if loading was aborted. */
+    bool aborted_;
+
+    /** An error that stopped the loading thread. */
+    exception_ptr error_;
+
+    /** The loading thread. */
+    thread loader_;
+};
+
+#endif
@@ -0,0 +1,375 @@
+#include "filter.h"
+#include "util.h"
+
+#include <cctype>
+#include <cmath>
+
+/**
+ * The fields an expression can read.
+ */
+enum FilterField : uint8_t {
+  ffYear,
+  ffMonth,
+  ffDay,
+  ffDate,
+  ffHour,
+  ffMinute,
+  ffSecond,
+  ffWeekday,
+  ffCurlError,
+  ffHTTPConnect,
+  ffHTTPCode,
+  ffSSLVerifyResult,
+  ffTotalTime,
+  ffNameLookup,
+  ffConnect,
+  ffAppConnect,
+  ffPreTransfer,
+  ffRedirect,
+  ffStartTransfer,
+  ffSizeUpload,
+  ffSizeDownload
+};
+
+/**
+ * The field names.
+ */
+static const struct {
+  const char* name;
+  FilterField field;
+} field_names[] = {
+  { "year", ffYear },
+  { "month", ffMonth },
+  { "day", ffDay },
+  { "date", ffDate },
+  { "hour", ffHour },
+  { "minute", ffMinute },
+  { "second", ffSecond },
+  { "wday", ffWeekday },
+  { "exitcode", ffCurlError },
+  { "curl_error", ffCurlError },
+  { "http_connect", ffHTTPConnect },
+  { "http_code", ffHTTPCode },
+  { "response_code", ffHTTPCode },
+  { "ssl_verify_result", ffSSLVerifyResult },
+  { "time_total", ffTotalTime },
+  { "time_namelookup", ffNameLookup },
+  { "time_connect", ffConnect },
+  { "time_appconnect", ffAppConnect },
+  { "time_pretransfer", ffPreTransfer },
+  { "time_redirect", ffRedirect },
+  { "time_starttransfer", ffStartTransfer },
+  { "size_upload", ffSizeUpload },
+  { "size_download", ffSizeDownload }
+};
+
+/**
+ * Return the ProbeFields a field is decoded with.
+ */
+static unsigned fieldClass( FilterField field ) {
+  if ( field >= ffSizeUpload ) return pfSizes;
+  if ( field >= ffTotalTime ) return pfTimings;
+  return pfNone;
+}
+
+/**
+ * Return the value of a field of a probe, NAN if the field is not decoded.
+ */
+static inline double fieldValue( uint8_t field, const CURLProbe &probe, unsigned decoded ) {
+  switch ( field ) {
+    case ffYear: return probe.datetime.year;
+    case ffMonth: return probe.datetime.month;
+    case ffDay: return probe.datetime.day;
+    case ffDate: return probe.datetime.year * 10000 + probe.datetime.month * 100 + probe.datetime.day;
+    case ffHour: return probe.datetime.hour;
+    case ffMinute: return probe.datetime.minute;
+    case ffSecond: return probe.datetime.second;
+    case ffWeekday: return probe.datetime.wday ? probe.datetime.wday : 7;
+    case ffCurlError: return probe.curl_error;
+    case ffHTTPConnect: return probe.http_connect;
+    case ffHTTPCode: return probe.http_code;
+    case ffSSLVerifyResult: return probe.ssl_verify_result;
+  }
+  if ( field >= ffSizeUpload ) {
+    if ( !( decoded & pfSizes ) ) return NAN;
+    return field == ffSizeUpload ? probe.size_upload : probe.size_download;
+  }
+  if ( !( decoded & pfTimings ) ) return NAN;
+  switch ( field ) {
+    case ffTotalTime: return probe.total_time;
+    case ffNameLookup: return probe.time_namelookup;
+    case ffConnect: return probe.time_connect;
+    case ffAppConnect: return probe.time_appconnect;
+    case ffPreTransfer: return probe.time_pretransfer;
+    case ffRedirect: return probe.time_redirect;
+    default: return probe.time_starttransfer;
+  }
+}
+
+/**
+ * Compiles an expression by recursive descent, emitting the operations in postfix order.
+ */
+class FilterCompiler {
+  public:
+    /** An operand of a comparison. */
+    struct Operand {
+      /** True for a field, false for a number. */
+      bool is_field;
+      /** The field. */
+      uint8_t field;
+      /** The number. */
+      double number;
+    };
+
+    /**
+     * Construct on an expression.
+     * @param expression The expression.
+     */
+    FilterCompiler( string_view expression ) : src_(expression), pos_(0), depth_(0), max_depth_(0), nesting_(0), fields_(pfNone) {}
+
+    /**
+     * Compile the expression.
+     * @param error Receives the reason the expression is invalid.
+     * @return False if the expression is invalid.
+     */
+    bool compile( string &error ) {
+      if ( !parseOr() ) {
+        error = error_;
+        return false;
+      }
+      skipSpace();
+      if ( pos_ < src_.size() ) {
+        error = "unexpected '" + string( src_.substr( pos_ ) ) + "'";
+        return false;
+      }
+      if ( max_depth_ > FILTER_MAX_DEPTH ) {
+        error = "expression is too deeply nested";
+        return false;
+      }
+      return true;
+    }
+
+    /** The emitted code. */
+    vector<ProbeFilter::Instruction> code;
+
+    /**
+     * Return the ProbeFields read.
+     */
+    unsigned fields() const { return fields_; }
+
+  private:
+    /** Skip whitespace. */
+    void skipSpace() {
+      while ( pos_ < src_.size() && isspace( static_cast<unsigned char>( src_[pos_] ) ) ) pos_++;
+    }
+
+    /**
+     * Consume a symbol or a keyword (followed by a non-identifier character) if it is next.
+     */
+    bool accept( string_view word ) {
+      skipSpace();
+      if ( src_.size() - pos_ < word.size() ) return false;
+      for ( size_t i = 0; i < word.size(); i++ ) {
+        if ( tolower( static_cast<unsigned char>( src_[pos_ + i] ) ) != word[i] ) return false;
+      }
+      if ( isalpha( static_cast<unsigned char>( word[0] ) ) && pos_ + word.size() < src_.size() ) {
+        char next = src_[pos_ + word.size()];
+        if ( isalnum( static_cast<unsigned char>( next ) ) || next == '_' ) return false;
+      }
+      pos_ += word.size();
+      return true;
+    }
+
+    /** Emit an instruction, tracking the stack depth. */
+    void emit( ProbeFilter::Op op, uint8_t field = 0, double number = 0.0 ) {
+      code.push_back( { op, field, number } );
+      if ( op == ProbeFilter::opField || op == ProbeFilter::opNumber ) max_depth_ = max( max_depth_, ++depth_ );
+      else if ( op != ProbeFilter::opNot ) depth_--;
+    }
+
+    /** Record an error at the current position. */
+    bool fail( const string &what ) {
+      skipSpace();
+      error_ = what + ( pos_ < src_.size() ? " at '" + string( src_.substr( pos_ ) ) + "'" : " at end" );
+      return false;
+    }
+
+    /** or := and ( ( 'or' | '||' ) and )* */
+    bool parseOr() {
+      if ( !parseAnd() ) return false;
+      while ( accept( "or" ) || accept( "||" ) ) {
+        if ( !parseAnd() ) return false;
+        emit( ProbeFilter::opOr );
+      }
+      return true;
+    }
+
+    /** and := not ( ( 'and' | '&&' ) not )* */
+    bool parseAnd() {
+      if ( !parseNot() ) return false;
+      while ( accept( "and" ) || accept( "&&" ) ) {
+        if ( !parseNot() ) return false;
+        emit( ProbeFilter::opAnd );
+      }
+      return true;
+    }
+
+    /** not := ( 'not' | '!' ) not | '(' or ')' | comparison */
+    bool parseNot() {
+      // repeated nots are collapsed rather than parsed recursively, as not not x is x
+      const size_t nesting = nesting_;
+      bool negate = false;
+      for (;;) {
+        skipSpace();
+        bool bang = pos_ < src_.size() && src_[pos_] == '!' && ( pos_ + 1 == src_.size() || src_[pos_ + 1] != '=' );
+        if ( bang ) pos_++;
+        if ( !bang && !accept( "not" ) ) break;
+        if ( ++nesting_ > FILTER_MAX_NESTING ) return fail( "expression is too deeply nested" );
+        negate = !negate;
+      }
+      if ( accept( "(" ) ) {
+        if ( ++nesting_ > FILTER_MAX_NESTING ) return fail( "expression is too deeply nested" );
+        if ( !parseOr() ) return false;
+        if ( !accept( ")" ) ) return fail( "expected ')'" );
+      } else if ( !parseComparison() ) return false;
+      if ( negate ) emit( ProbeFilter::opNot );
+      nesting_ = nesting;
+      return true;
+    }
+
+    /** comparison := operand ( '=' | '==' | '!=' | '<>' | '<' | '<=' | '>' | '>=' ) operand */
+    bool parseComparison() {
+      Operand a, b;
+      if ( !parseOperand( a ) ) return false;
+      ProbeFilter::Op op;
+      bool swap = false;
+      if ( accept( "==" ) || accept( "=" ) ) op = ProbeFilter::opEqual;
+      else if ( accept( "!=" ) || accept( "<>" ) ) op = ProbeFilter::opNotEqual;
+      else if ( accept( "<=" ) ) op = ProbeFilter::opLessEqual;
+      else if ( accept( "<" ) ) op = ProbeFilter::opLess;
+      else if ( accept( ">=" ) ) { op = ProbeFilter::opLessEqual; swap = true; }
+      else if ( accept( ">" ) ) { op = ProbeFilter::opLess; swap = true; }
+      else return fail( "expected a comparison" );
+      if ( !parseOperand( b ) ) return false;
+      if ( swap ) std::swap( a, b );
+      push( a );
+      push( b );
+      emit( op );
+      return true;
+    }
+
+    /** Emit the push of an operand. */
+    void push( const Operand &operand ) {
+      if ( operand.is_field ) emit( ProbeFilter::opField, operand.field ); else emit( ProbeFilter::opNumber, 0, operand.number );
+    }
+
+    /** operand := field | number */
+    bool parseOperand( Operand &operand ) {
+      skipSpace();
+      size_t start = pos_;
+      if ( pos_ < src_.size() && ( isalpha( static_cast<unsigned char>( src_[pos_] ) ) || src_[pos_] == '_' ) ) {
+        while ( pos_ < src_.size() && ( isalnum( static_cast<unsigned char>( src_[pos_] ) ) || src_[pos_] == '_' ) ) pos_++;
+        string name( src_.substr( start, pos_ - start ) );
+        for ( auto &c : name ) c = static_cast<char>( tolower( static_cast<unsigned char>( c ) ) );
+        for ( const auto &f : field_names ) {
+          if ( name == f.name ) {
+            operand = { true, f.field, 0.0 };
+            fields_ |= fieldClass( f.field );
+            return true;
+          }
+        }
+        pos_ = start;
+        return fail( "unknown field '" + name + "'" );
+      }
+      while ( pos_ < src_.size() ) {
+        char c = src_[pos_];
+        bool sign = ( c == '-' || c == '+' ) && ( pos_ == start || tolower( static_cast<unsigned char>( src_[pos_ - 1] ) ) == 'e' );
+        if ( !isalnum( static_cast<unsigned char>( c ) ) && c != '.' && !sign ) break;
+        pos_++;
+      }
+      double number;
+      string_view token = src_.substr( start, pos_ - start );
+      size_t used = 0;
+      if ( token.size() ) {
+        auto r = std::from_chars( token.data(), token.data() + token.size(), number );
+        if ( r.ec == std::errc() ) used = r.ptr - token.data();
+      }
+      if ( !used || used != token.size() ) {
+        pos_ = start;
+        return fail( "expected a field or a number" );
+      }
+      operand = { false, 0, number };
+      return true;
+    }
+
+    /** The expression. */
+    string_view src_;
+
+    /** The parse position. */
+    size_t pos_;
+
+    /** The stack depth at the end of the emitted code. */
+    size_t depth_;
+
+    /** The maximum stack depth. */
+    size_t max_depth_;
+
+    /** The nesting of parentheses and nots at the parse position. */
+    size_t nesting_;
+
+    /** The ProbeFields read. */
+    unsigned fields_;
+
+    /** The error. */
+    string error_;
+};
+
+ProbeFilter::ProbeFilter() : fields_(pfNone) {
+}
+
+bool ProbeFilter::compile( string_view expression, string &error ) {
+  FilterCompiler compiler( expression );
+  if ( !compiler.compile( error ) ) return false;
+  code_ = move( compiler.code );
+  fields_ = compiler.fields();
+  return true;
+}
+
+bool ProbeFilter::rejects( const CURLProbe &probe, unsigned decoded ) const {
+  // truth values are 1 (true), 0 (false) and NAN (unknown, as a field it depends on is not decoded)
+  double stack[FILTER_MAX_DEPTH];
+  size_t top = 0;
+  for ( const auto &i : code_ ) {
+    switch ( i.op ) {
+      case opField:
+        stack[top++] = fieldValue( i.field, probe, decoded );
+        continue;
+      case opNumber:
+        stack[top++] = i.number;
+        continue;
+      case opNot:
+        stack[top - 1] = isnan( stack[top - 1] ) ? NAN : 1.0 - stack[top - 1];
+        continue;
+      default:
+        break;
+    }
+    double b = stack[--top];
+    double a = stack[top - 1];
+    double &result = stack[top - 1];
+    if ( i.op == opAnd )
+      result = a == 0.0 || b == 0.0 ? 0.0 : ( isnan( a ) || isnan( b ) ? NAN : 1.0 );
+    else if ( i.op == opOr )
+      result = a == 1.0 || b == 1.0 ? 1.0 : ( isnan( a ) || isnan( b ) ? NAN : 0.0 );
+    else if ( isnan( a ) || isnan( b ) )
+      result = NAN;
+    else if ( i.op == opEqual )
+      result = a == b;
+    else if ( i.op == opNotEqual )
+      result = a != b;
+    else if ( i.op == opLess )
+      result = a < b;
+    else
+      result = a <= b;
+  }
+  return code_.size() && stack[0] == 0.0;
+}
@@ -0,0 +1,102 @@
+#ifndef filter_h
+#define filter_h
+
+#include "curlprobe.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/** The maximum depth of the evaluation stack of a ProbeFilter. */
+#define FILTER_MAX_DEPTH 32
+
+/** The maximum nesting of parentheses and nots in a --where expression, bounding the parser recursion. */
+#define FILTER_MAX_NESTING 256
+
+/**
+ * A --where expression compiled into a bytecode for a stack machine, such as
+ * @code
+ * http_code>=500 or (hour>=8 and hour<18 and wday<6)
+ * @endcode
+ * Comparisons (=, ==, !=, <>, <, <=, >, >=) of probe fields and numbers are combined with and (&&),
+ * or (||), not (!) and parentheses. The fields are named as the curl --write-out variables (exitcode,
+ * http_connect, http_code, ssl_verify_result, time_total, time_namelookup, time_connect, time_appconnect,
+ * time_pretransfer, time_redirect, time_starttransfer, size_upload and size_download), and the probe
+ * time as year, month, day, date (YYYYMMDD), hour, minute, second and wday (Monday=1 .. Sunday=7).
+ * Names are case insensitive.
+ *
+ * The expression is evaluated in three-valued logic, with the fields not yet decoded unknown, so that the
+ * parser rejects a probe on its date, time and codes before decoding its timings (see ParsePlan::parse).
+ */
+class ProbeFilter {
+  public:
+    /**
+     * Construct an empty filter, which accepts all probes.
+     */
+    ProbeFilter();
+
+    /**
+     * Compile an expression.
+     * @param expression The expression.
+     * @param error Receives the reason the expression is invalid.
+     * @return False if the expression is invalid.
+     */
+    bool compile( string_view expression, string &error );
+
+    /**
+     * Return true if the filter accepts all probes.
+     * @return True if no expression was compiled.
+     */
+    bool empty() const { return code_.empty(); }
+
+    /**
+     * Return the ProbeFields the expression reads besides the date, time and codes.
+     * @return The ProbeField bitmask.
+     */
+    unsigned fields() const { return fields_; }
+
+    /**
+     * Return true if the expression is false for a probe, whatever the value of the fields not decoded.
+     * @param probe The probe.
+     * @param decoded The ProbeFields decoded into probe, the date, time and codes always are.
+     * @return True if the probe is rejected.
+     */
+    bool rejects( const CURLProbe &probe, unsigned decoded = pfAll ) const;
+
+  private:
+    /** The operations. */
+    enum Op : uint8_t {
+      opField,      /**< Push a field. */
+      opNumber,     /**< Push a number. */
+      opEqual,      /**< Pop b and a, push a = b. */
+      opNotEqual,   /**< Pop b and a, push a != b. */
+      opLess,       /**< Pop b and a, push a < b. */
+      opLessEqual,  /**< Pop b and a, push a <= b. */
+      opAnd,        /**< Pop b and a, push a and b. */
+      opOr,         /**< Pop b and a, push a or b. */
+      opNot         /**< Pop a, push not a. */
+    };
+
+    /** An instruction. */
+    struct Instruction {
+      /** The operation. */
+      Op op;
+      /** The field of opField. */
+      uint8_t field;
+      /** The number of opNumber. */
+      double number;
+    };
+
+    /** The compiled expression. */
+    vector<Instruction> code_;
+
+    /** The ProbeFields read, see fields(). */
+    unsigned fields_;
+
+    friend class FilterCompiler;
+};
+
+#endif
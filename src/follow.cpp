@@ -0,0 +1,204 @@
+#include "follow.h"
+#include "reader.h"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Set by the signal handler to stop following. */
+static volatile sig_atomic_t follow_stop = 0;
+
+/**
+ * Stop following on SIGINT and SIGTERM.
+ */
+static void onStopSignal( int ) {
+  follow_stop = 1;
+}
+
+/**
+ * Return the directory of a path.
+ */
+static string directoryOf( const string &path ) {
+  size_t slash = path.rfind( '/' );
+  if ( slash == string::npos ) return ".";
+  if ( slash == 0 ) return "/";
+  return path.substr( 0, slash );
+}
+
+/**
+ * Write the report to a temporary file and rename it over report_path.
+ */
+static void writeReport( const string &report_path, const string &report ) {
+  string temp = report_path + ".tmp";
+  ofstream out( temp, ios::trunc );
+  if ( !out ) throw std::runtime_error( "cannot create '" + temp + "'" );
+  out << report;
+  out.close();
+  if ( !out ) throw std::runtime_error( "error writing '" + temp + "'" );
+  if ( rename( temp.c_str(), report_path.c_str() ) != 0 )
+    throw std::runtime_error( "cannot rename '" + temp + "' to '" + report_path + "': " + strerror( errno ) );
+}
+
+/**
+ * The input file being followed.
+ */
+class FollowedFile {
+  public:
+    FollowedFile( const string &path, int inotify_fd ) : path_(path), inotify_fd_(inotify_fd), fd_(-1), watch_(-1), offset_(0) {}
+
+    ~FollowedFile() { close(); }
+
+    /**
+     * Open the file at path, if it exists.
+     * @return False if the file does not exist.
+     */
+    bool open() {
+      fd_ = ::open( path_.c_str(), O_RDONLY );
+      if ( fd_ < 0 ) {
+        if ( errno == ENOENT ) return false;
+        throw std::runtime_error( "cannot open '" + path_ + "': " + strerror( errno ) );
+      }
+      watch_ = inotify_add_watch( inotify_fd_, path_.c_str(), IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF );
+      offset_ = 0;
+      return true;
+    }
+
+    /**
+     * Close the file.
+     */
+    void close() {
+      if ( watch_ >= 0 ) inotify_rm_watch( inotify_fd_, watch_ );
+      if ( fd_ >= 0 ) ::close( fd_ );
+      watch_ = -1;
+      fd_ = -1;
+    }
+
+    /** Return true if the file is open. */
+    bool isOpen() const { return fd_ >= 0; }
+
+    /**
+     * Return true if the file was truncated below the read offset.
+     */
+    bool truncated() const {
+      struct stat st;
+      return fstat( fd_, &st ) == 0 && static_cast<size_t>( st.st_size ) < offset_;
+    }
+
+    /**
+     * Return true if path now refers to another file than the one open.
+     */
+    bool rotated() const {
+      struct stat open_st, path_st;
+      if ( fstat( fd_, &open_st ) != 0 ) return true;
+      if ( stat( path_.c_str(), &path_st ) != 0 ) return false;
+      return open_st.st_ino != path_st.st_ino || open_st.st_dev != path_st.st_dev;
+    }
+
+    /**
+     * Restart reading at the start of the file.
+     */
+    void rewind() {
+      lseek( fd_, 0, SEEK_SET );
+      offset_ = 0;
+    }
+
+    /**
+     * Read up to size bytes of new data.
+     * @return The number of bytes read, 0 at the end of the file.
+     */
+    size_t read( char* buffer, size_t size ) {
+      ssize_t n;
+      do {
+        n = ::read( fd_, buffer, size );
+      } while ( n < 0 && errno == EINTR );
+      if ( n < 0 ) throw std::runtime_error( "error reading '" + path_ + "': " + strerror( errno ) );
+      offset_ += n;
+      return static_cast<size_t>( n );
+    }
+
+  private:
+    /** The path of the file. */
+    string path_;
+
+    /** The inotify instance. */
+    int inotify_fd_;
+
+    /** The open file. */
+    int fd_;
+
+    /** The inotify watch on the open file. */
+    int watch_;
+
+    /** The read offset. */
+    size_t offset_;
+};
+
+void follow( Aggregate &agg, const string &path, const string &report_path, unsigned interval,
+             const function<string()> &generate ) {
+  int inotify_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+  if ( inotify_fd < 0 ) throw std::runtime_error( string( "inotify: " ) + strerror( errno ) );
+  // a rotated file reappears in the directory
+  inotify_add_watch( inotify_fd, directoryOf( path ).c_str(), IN_CREATE | IN_MOVED_TO );
+  signal( SIGINT, onStopSignal );
+  signal( SIGTERM, onStopSignal );
+
+  AggregateSink sink( agg );
+  BlockReader reader( sink, path );
+  FollowedFile file( path, inotify_fd );
+  if ( !file.open() ) throw std::runtime_error( "cannot open '" + path + "': " + strerror( ENOENT ) );
+  string buffer( FOLLOW_READ_SIZE, '\0' );
+  auto next_report = chrono::steady_clock::now();
+  size_t reported_probes = SIZE_MAX;
+  try {
+    while ( !follow_stop ) {
+      if ( file.isOpen() ) {
+        if ( file.truncated() ) {
+          cerr << "'" << path << "' was truncated, reading from the start" << endl;
+          reader.finish();
+          file.rewind();
+        }
+        while ( size_t n = file.read( buffer.data(), buffer.size() ) ) reader.feed( string_view( buffer.data(), n ) );
+        if ( file.rotated() ) {
+          // the old file was read to its end above
+          reader.finish();
+          file.close();
+        }
+      }
+      if ( !file.isOpen() && file.open() ) continue;
+
+      auto now = chrono::steady_clock::now();
+      if ( now >= next_report ) {
+        if ( agg.globalstats.total_probes != reported_probes ) {
+          writeReport( report_path, generate() );
+          reported_probes = agg.globalstats.total_probes;
+        }
+        next_report = now + chrono::seconds( interval );
+      }
+
+      // wait for changes or the next report
+      int timeout = static_cast<int>( chrono::duration_cast<chrono::milliseconds>( next_report - now ).count() );
+      struct pollfd pfd = { inotify_fd, POLLIN, 0 };
+      if ( poll( &pfd, 1, max( timeout, 0 ) ) > 0 ) {
+        char events[4096];
+        while ( ::read( inotify_fd, events, sizeof(events) ) > 0 );
+      }
+    }
+    if ( agg.globalstats.total_probes != reported_probes ) writeReport( report_path, generate() );
+  }
+  catch ( ... ) {
+    close( inotify_fd );
+    throw;
+  }
+  close( inotify_fd );
+}
@@ -0,0 +1,30 @@
+#ifndef follow_h
+#define follow_h
+
+#include "variables.h"
+
+#include <functional>
+#include <string>
+
+using namespace std;
+
+/** The size of the buffer new input is read into when following. */
+#define FOLLOW_READ_SIZE 1048576
+
+/**
+ * Follow a growing input file, like tail -F, aggregating new lines as they are appended. inotify
+ * signals changes to the file and to its directory, so that rotation (the file is renamed or deleted and
+ * recreated) and truncation are detected; after rotation the new file is read from its start. A line
+ * being written is parsed once complete. The report is regenerated at most every interval seconds, and
+ * only if probes were added, by writing it to a temporary file renamed over report_path. Following
+ * stops on SIGINT or SIGTERM, after writing a final report.
+ * @param agg The Aggregate to add to.
+ * @param path The input file.
+ * @param report_path The report file.
+ * @param interval The minimum number of seconds between reports.
+ * @param generate Returns the report.
+ */
+void follow( Aggregate &agg, const string &path, const string &report_path, unsigned interval,
+             const function<string()> &generate );
+
+#endif
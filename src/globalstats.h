@@ -24,7 +24,9 @@ struct GlobalStats {
     total_time(0),
     total_slow_time(0),
     first_time(),
-    last_time() {};
+    last_time(),
+    size_upload(0),
+    size_download(0) {};
 
   /**
    * Global WaitClassStats
@@ -85,6 +87,27 @@ struct GlobalStats {
    * Aggregate download size
    */
   size_t size_download;
+
+  /**
+   * Merge the statistics of another GlobalStats into this one.
+   * @param other The GlobalStats to merge.
+   */
+  void merge( const GlobalStats& other ) {
+    wait_class_stats.merge( other.wait_class_stats );
+    response_stats.merge( other.response_stats );
+    timed_probes += other.timed_probes;
+    total_probes += other.total_probes;
+    items_slow += other.items_slow;
+    total_time += other.total_time;
+    total_slow_time += other.total_slow_time;
+    if ( other.first_time.year != 0 && ( first_time.year == 0 || other.first_time < first_time ) )
+      first_time = other.first_time;
+    if ( other.last_time.year != 0 && ( last_time.year == 0 || other.last_time > last_time ) )
+      last_time = other.last_time;
+    findings.insert( findings.end(), other.findings.begin(), other.findings.end() );
+    size_upload += other.size_upload;
+    size_download += other.size_download;
+  }
 };
 
 
@@ -0,0 +1,153 @@
+#include "histogram.h"
+
+#include <algorithm>
+
+/**
+ * Integer ceil( a / b ) for b > 0.
+ */
+static inline int64_t ceilDiv( int64_t a, int64_t b ) {
+  return a >= 0 ? ( a + b - 1 ) / b : -( -a / b );
+}
+
+void Histogram::merge( const Histogram &other ) {
+  if ( other.empty() ) return;
+  grow( other.first_ );
+  grow( other.first_ + static_cast<int64_t>( other.counts_.size() ) - 1 );
+  size_t offset = static_cast<size_t>( other.first_ - first_ );
+  for ( size_t i = 0; i < other.counts_.size(); i++ ) counts_[offset + i] += other.counts_[i];
+}
+
+void Histogram::addBucket( int64_t index, uint64_t count ) {
+  counts_[grow( index )] += count;
+}
+
+size_t Histogram::grow( int64_t index ) {
+  if ( counts_.empty() ) {
+    first_ = index;
+    counts_.resize( 1 );
+  } else if ( index < first_ ) {
+    // extend down by at least the current size (but not below 0 for a value from 0), so that a run of ever
+    // lower values moves the counts a logarithmic number of times, as resize does up
+    int64_t low = first_ - max( first_ - index, static_cast<int64_t>( counts_.size() ) );
+    if ( index >= 0 ) low = max( low, static_cast<int64_t>( 0 ) );
+    counts_.insert( counts_.begin(), static_cast<size_t>( first_ - low ), 0 );
+    first_ = low;
+  } else if ( index >= first_ + static_cast<int64_t>( counts_.size() ) ) {
+    counts_.resize( static_cast<size_t>( index - first_ ) + 1 );
+  }
+  return static_cast<size_t>( index - first_ );
+}
+
+void Histogram::rangeOf( int64_t index, int64_t &first, int64_t &last ) {
+  if ( index == 0 ) {
+    first = last = 0;
+    return;
+  }
+  int64_t i = index > 0 ? index - 1 : -1 - index;
+  int64_t shift = max( static_cast<int64_t>( 0 ), ( i >> HISTOGRAM_SUB_BUCKET_BITS ) - 1 );
+  int64_t low = ( i - ( shift << HISTOGRAM_SUB_BUCKET_BITS ) ) << shift;
+  int64_t width = static_cast<int64_t>( 1 ) << shift;
+  if ( index > 0 ) {
+    first = low + 1;
+    last = low + width;
+  } else {
+    first = -( low + width - 1 );
+    last = -low;
+  }
+}
+
+int64_t Histogram::middleOf( int64_t index ) {
+  int64_t first, last;
+  rangeOf( index, first, last );
+  // round towards zero as the bucket of a positive value is closed above
+  return index > 0 ? first + ( last - first ) / 2 : last - ( last - first ) / 2;
+}
+
+double Histogram::quantile( double q ) const {
+  uint64_t total = 0;
+  for ( const auto n : counts_ ) total += n;
+  if ( total == 0 ) return 0.0;
+  uint64_t rank = static_cast<uint64_t>( ceil( q * static_cast<double>( total ) ) );
+  if ( rank < 1 ) rank = 1;
+  uint64_t seen = 0;
+  size_t i = 0;
+  for ( ; i + 1 < counts_.size(); i++ ) {
+    seen += counts_[i];
+    if ( seen >= rank ) break;
+  }
+  return static_cast<double>( middleOf( first_ + static_cast<int64_t>( i ) ) ) * HISTOGRAM_UNIT;
+}
+
+/**
+ * The values of a bucket with a count, clipped to the values added.
+ */
+struct HistogramRange {
+  /** The first value in units. */
+  int64_t first;
+  /** The last value in units. */
+  int64_t last;
+  /** The count. */
+  uint64_t count;
+};
+
+/**
+ * Split the count of a range across the decimal buckets of size units by the cumulative share of the range
+ * up to each bucket edge, so that the pieces add up to the count. Call f( n, count ) for the decimal buckets
+ * n that get a count, in ascending order, visiting only those, stop when f returns false.
+ */
+template <typename F> static bool splitRange( const HistogramRange &r, int64_t size, F f ) {
+  const unsigned __int128 width = static_cast<unsigned __int128>( r.last - r.first + 1 );
+  uint64_t assigned = 0;
+  while ( assigned < r.count ) {
+    // the first unit at which the share exceeds assigned
+    const int64_t cum = static_cast<int64_t>( ( ( static_cast<unsigned __int128>( assigned ) + 1 ) * width +
+                                                r.count - 1 ) / r.count );
+    const int64_t n = ceilDiv( r.first + cum - 1, size );
+    const int64_t upto = min( r.last, n * size );
+    const uint64_t share = static_cast<uint64_t>(
+      static_cast<unsigned __int128>( r.count ) * static_cast<unsigned __int128>( upto - r.first + 1 ) / width );
+    if ( !f( n, share - assigned ) ) return false;
+    assigned = share;
+  }
+  return true;
+}
+
+HistogramView Histogram::view( unsigned max_buckets, double min, double max ) const {
+  HistogramView result;
+  if ( empty() ) return result;
+  const int64_t lowest = llround( min / HISTOGRAM_UNIT );
+  const int64_t highest = llround( max / HISTOGRAM_UNIT );
+  // the ranges ascend and do not overlap
+  vector<HistogramRange> ranges;
+  forEachBucket( [&]( int64_t index, uint64_t count ) {
+    HistogramRange r{ 0, 0, count };
+    rangeOf( index, r.first, r.last );
+    r.first = std::max( r.first, lowest );
+    r.last = std::min( r.last, highest );
+    if ( r.first > r.last ) r.first = r.last = std::min( std::max( r.first, lowest ), highest );
+    ranges.push_back( r );
+  } );
+  const size_t limit = std::max( max_buckets, 1u );
+  int64_t size = 1;
+  for ( ; size < INT64_MAX / 10; size *= 10, result.bucket *= 10.0 ) {
+    size_t buckets = 0;
+    int64_t previous = 0;
+    bool fits = true;
+    for ( const auto &r : ranges ) {
+      fits = splitRange( r, size, [&]( int64_t n, uint64_t ) {
+        if ( buckets == 0 || n != previous ) buckets++;
+        previous = n;
+        return buckets <= limit;
+      } );
+      if ( !fits ) break;
+    }
+    if ( fits ) break;
+  }
+  for ( const auto &r : ranges ) {
+    splitRange( r, size, [&]( int64_t n, uint64_t count ) {
+      result.buckets[static_cast<double>( n ) * result.bucket] += count;
+      return true;
+    } );
+  }
+  return result;
+}
@@ -0,0 +1,140 @@
+#ifndef histogram_h
+#define histogram_h
+
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+using namespace std;
+
+/** The value of a Histogram unit, values are counted in whole microseconds. */
+#define HISTOGRAM_UNIT 1.0E-6
+
+/** The number of bits of the sub-bucket within a power of 2, so that a bucket is at most 1/32 of its value. */
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+
+/**
+ * A histogram coarsened for display, see Histogram::view.
+ */
+struct HistogramView {
+  /** The bucket size in seconds. */
+  double bucket = HISTOGRAM_UNIT;
+
+  /** The number of values by the upper bound of their bucket. */
+  map<double,size_t> buckets;
+};
+
+/**
+ * A log-linear (HDR) histogram of values in seconds. Values are rounded to whole units (HISTOGRAM_UNIT) and
+ * counted in buckets that are exact up to 2^HISTOGRAM_SUB_BUCKET_BITS units and, above that, split each
+ * power of 2 into 2^HISTOGRAM_SUB_BUCKET_BITS equal buckets. Adding a value is a single increment of a
+ * bucket computed without branches and histograms merge exactly. The counts cover the range of buckets in
+ * use, growing in either direction in amortized constant time, so memory is not fixed but grows with the
+ * log of the range of the values (about 3KB for 1us to 1s) rather than with their number.
+ *
+ * Buckets are closed on the side away from zero, as the decimal buckets of view.
+ */
+class Histogram {
+  public:
+    /**
+     * Add a value.
+     * @param d The value in seconds.
+     */
+    void add( double d ) {
+      int64_t index = indexOf( llround( d / HISTOGRAM_UNIT ) );
+      // a single unsigned compare covers indexes below and above the range
+      size_t slot = static_cast<size_t>( index - first_ );
+      if ( slot >= counts_.size() ) slot = grow( index );
+      counts_[slot]++;
+    }
+
+    /**
+     * Add the values of another histogram.
+     * @param other The histogram to merge.
+     */
+    void merge( const Histogram &other );
+
+    /**
+     * Return true if no values were added.
+     * @return True if empty.
+     */
+    bool empty() const { return counts_.empty(); }
+
+    /**
+     * Add a count to a bucket, as saved by forEachBucket.
+     * @param index The bucket index.
+     * @param count The count.
+     */
+    void addBucket( int64_t index, uint64_t count );
+
+    /**
+     * Call f( index, count ) for each bucket with a count, in index order.
+     * @param f The function.
+     */
+    template <typename F> void forEachBucket( F f ) const {
+      for ( size_t i = 0; i < counts_.size(); i++ ) if ( counts_[i] ) f( first_ + static_cast<int64_t>( i ), counts_[i] );
+    }
+
+    /**
+     * Return the value below or at which a fraction of the values falls (the nearest rank), as the middle
+     * of its bucket, so within 1/64 of the value or half a unit.
+     * @param q The fraction, 0 < q <= 1.
+     * @return The value in seconds, 0 if empty.
+     */
+    double quantile( double q ) const;
+
+    /**
+     * Coarsen to decimal buckets (1us, 10us, 100us, ...) of the smallest size that yields at most max_buckets
+     * buckets. Each bucket counts the values v with (n-1)*bucket < v <= n*bucket. A log-linear bucket that
+     * straddles decimal buckets, clipped to the smallest and largest value added, is split across them in
+     * proportion to the units of its range in each, so that no decimal bucket is shown outside those values.
+     * @param max_buckets The maximum number of buckets.
+     * @param min The smallest value added in seconds.
+     * @param max The largest value added in seconds.
+     * @return The coarsened histogram.
+     */
+    HistogramView view( unsigned max_buckets, double min, double max ) const;
+
+  private:
+    /**
+     * Return the index of the log-linear bucket of a magnitude, values from 0.
+     */
+    static int64_t logIndex( uint64_t u ) {
+      unsigned shift = 63 - __builtin_clzll( u | ( 1ull << HISTOGRAM_SUB_BUCKET_BITS ) ) - HISTOGRAM_SUB_BUCKET_BITS;
+      return static_cast<int64_t>( ( static_cast<uint64_t>( shift ) << HISTOGRAM_SUB_BUCKET_BITS ) + ( u >> shift ) );
+    }
+
+    /**
+     * Return the bucket index of a value in units, 0 for 0, positive for positive values (v-1 falls in
+     * logIndex( v-1 )), negative for negative values.
+     */
+    static int64_t indexOf( int64_t v ) {
+      if ( v > 0 ) return 1 + logIndex( static_cast<uint64_t>( v ) - 1 );
+      if ( v < 0 ) return -1 - logIndex( 0 - static_cast<uint64_t>( v ) );
+      return 0;
+    }
+
+    /**
+     * Return the first and last value in units of a bucket.
+     */
+    static void rangeOf( int64_t index, int64_t &first, int64_t &last );
+
+    /**
+     * Return the value in units representing a bucket, the middle of its values.
+     */
+    static int64_t middleOf( int64_t index );
+
+    /**
+     * Extend the counts to cover index, return its slot.
+     */
+    size_t grow( int64_t index );
+
+    /** The index of counts_[0]. */
+    int64_t first_ = 0;
+
+    /** The counts of the buckets from first_, empty until a value is added. */
+    vector<uint64_t> counts_;
+};
+
+#endif
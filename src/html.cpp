@@ -36,6 +36,7 @@ const string color_slow_probe = "orange";
 const string color_good = "#0c5922";
 const string color_mean = "#333366";
 const string color_stddev = "#aa3333";
+const string color_p99 = "#999999";
 
 const string chartarea_linechart = "chartArea:{left:80,top:30,bottom:50,right:120,width:'100%',height:'100%'}";
 const string chartarea_piechart  = "chartArea:{left:20,top:20,bottom:20,right:20,width:'100%',height:'100%'}";
@@ -298,40 +299,40 @@ void generatePieChartOptions( ostringstream& oss, const string& name, const stri
 void generateSummaryMinMaxChart( ostringstream& oss ) {
   oss << "  var minMax_data = google.visualization.arrayToDataTable([" << endl;
   oss << "    ['DNS', "
-      << globalstats.wait_class_stats.namelookup.min << ", "
-      << globalstats.wait_class_stats.namelookup.getMean() << ", "
-      << globalstats.wait_class_stats.namelookup.getMean() + globalstats.wait_class_stats.namelookup.getSigma() << ", "
-      << globalstats.wait_class_stats.namelookup.max
+      << globalstats.wait_class_stats.namelookup().min << ", "
+      << globalstats.wait_class_stats.namelookup().getMean() << ", "
+      << globalstats.wait_class_stats.namelookup().getMean() + globalstats.wait_class_stats.namelookup().getSigma() << ", "
+      << globalstats.wait_class_stats.namelookup().max
       << " ]," << endl;
   oss << "    ['TCP', "
-      << globalstats.wait_class_stats.connect.min << ", "
-      << globalstats.wait_class_stats.connect.getMean() << ", "
-      << globalstats.wait_class_stats.connect.getMean() + globalstats.wait_class_stats.connect.getSigma() << ", "
-      << globalstats.wait_class_stats.connect.max
+      << globalstats.wait_class_stats.connect().min << ", "
+      << globalstats.wait_class_stats.connect().getMean() << ", "
+      << globalstats.wait_class_stats.connect().getMean() + globalstats.wait_class_stats.connect().getSigma() << ", "
+      << globalstats.wait_class_stats.connect().max
       << " ]," << endl;
   oss << "    ['TLS', "
-      << globalstats.wait_class_stats.appconnect.min << ", "
-      << globalstats.wait_class_stats.appconnect.getMean() << ", "
-      << globalstats.wait_class_stats.appconnect.getMean() + globalstats.wait_class_stats.appconnect.getSigma() << ", "
-      << globalstats.wait_class_stats.appconnect.max
+      << globalstats.wait_class_stats.appconnect().min << ", "
+      << globalstats.wait_class_stats.appconnect().getMean() << ", "
+      << globalstats.wait_class_stats.appconnect().getMean() + globalstats.wait_class_stats.appconnect().getSigma() << ", "
+      << globalstats.wait_class_stats.appconnect().max
       << " ]," << endl;
   oss << "    ['REQ', "
-      << globalstats.wait_class_stats.pretransfer.min << ", "
-      << globalstats.wait_class_stats.pretransfer.getMean() << ", "
-      << globalstats.wait_class_stats.pretransfer.getMean() + globalstats.wait_class_stats.pretransfer.getSigma() << ", "
-      << globalstats.wait_class_stats.pretransfer.max
+      << globalstats.wait_class_stats.pretransfer().min << ", "
+      << globalstats.wait_class_stats.pretransfer().getMean() << ", "
+      << globalstats.wait_class_stats.pretransfer().getMean() + globalstats.wait_class_stats.pretransfer().getSigma() << ", "
+      << globalstats.wait_class_stats.pretransfer().max
       << " ]," << endl;
   oss << "    ['RSP', "
-      << globalstats.wait_class_stats.starttransfer.min << ", "
-      << globalstats.wait_class_stats.starttransfer.getMean() << ", "
-      << globalstats.wait_class_stats.starttransfer.getMean() + globalstats.wait_class_stats.starttransfer.getSigma() << ", "
-      << globalstats.wait_class_stats.starttransfer.max
+      << globalstats.wait_class_stats.starttransfer().min << ", "
+      << globalstats.wait_class_stats.starttransfer().getMean() << ", "
+      << globalstats.wait_class_stats.starttransfer().getMean() + globalstats.wait_class_stats.starttransfer().getSigma() << ", "
+      << globalstats.wait_class_stats.starttransfer().max
       << " ]," << endl;
   oss << "    ['DAT', "
-      << globalstats.wait_class_stats.endtransfer.min << ", "
-      << globalstats.wait_class_stats.endtransfer.getMean() << ", "
-      << globalstats.wait_class_stats.endtransfer.getMean() + globalstats.wait_class_stats.endtransfer.getSigma() << ", "
-      << globalstats.wait_class_stats.endtransfer.max
+      << globalstats.wait_class_stats.endtransfer().min << ", "
+      << globalstats.wait_class_stats.endtransfer().getMean() << ", "
+      << globalstats.wait_class_stats.endtransfer().getMean() + globalstats.wait_class_stats.endtransfer().getSigma() << ", "
+      << globalstats.wait_class_stats.endtransfer().max
       << " ]," << endl;
   oss << "    ], true );" << endl;
 
@@ -383,18 +384,18 @@ void generateSummaryQoSPieChart( ostringstream& oss ) {
 void generateSummaryWCAveragePieChart( ostringstream& oss ) {
   oss << "  var waitClassPie_data = google.visualization.arrayToDataTable([" << endl;
   oss << "  ['Wait class','mean']," << endl;
-  oss << "    ['" << "DNS " << num(globalstats.wait_class_stats.namelookup.getMean()*1000.0,2)
-      << "ms', " << globalstats.wait_class_stats.namelookup.getMean()*1000.0 << "]," << endl;
-  oss << "    ['" << "TCP " << num(globalstats.wait_class_stats.connect.getMean()*1000.0,2)
-      << "ms', " << globalstats.wait_class_stats.connect.getMean()*1000.0 << "]," << endl;
-  oss << "    ['" << "TLS " << num(globalstats.wait_class_stats.appconnect.getMean()*1000.0,2)
-      << "ms', " << globalstats.wait_class_stats.appconnect.getMean()*1000.0 << "]," << endl;
-  oss << "    ['" << "REQ " << num(globalstats.wait_class_stats.pretransfer.getMean()*1000.0,2)
-      << "ms', " << globalstats.wait_class_stats.pretransfer.getMean()*1000.0 << "]," << endl;
-  oss << "    ['" << "RSP " << num(globalstats.wait_class_stats.starttransfer.getMean()*1000.0,2)
-      << "ms', " << globalstats.wait_class_stats.starttransfer.getMean()*1000.0 << "]," << endl;
-  oss << "    ['" << "DAT " << num(globalstats.wait_class_stats.endtransfer.getMean()*1000.0,2)
-      << "ms', " << globalstats.wait_class_stats.endtransfer.getMean()*1000.0 << "]" << endl;
+  oss << "    ['" << "DNS " << num(globalstats.wait_class_stats.namelookup().getMean()*1000.0,2)
+      << "ms', " << globalstats.wait_class_stats.namelookup().getMean()*1000.0 << "]," << endl;
+  oss << "    ['" << "TCP " << num(globalstats.wait_class_stats.connect().getMean()*1000.0,2)
+      << "ms', " << globalstats.wait_class_stats.connect().getMean()*1000.0 << "]," << endl;
+  oss << "    ['" << "TLS " << num(globalstats.wait_class_stats.appconnect().getMean()*1000.0,2)
+      << "ms', " << globalstats.wait_class_stats.appconnect().getMean()*1000.0 << "]," << endl;
+  oss << "    ['" << "REQ " << num(globalstats.wait_class_stats.pretransfer().getMean()*1000.0,2)
+      << "ms', " << globalstats.wait_class_stats.pretransfer().getMean()*1000.0 << "]," << endl;
+  oss << "    ['" << "RSP " << num(globalstats.wait_class_stats.starttransfer().getMean()*1000.0,2)
+      << "ms', " << globalstats.wait_class_stats.starttransfer().getMean()*1000.0 << "]," << endl;
+  oss << "    ['" << "DAT " << num(globalstats.wait_class_stats.endtransfer().getMean()*1000.0,2)
+      << "ms', " << globalstats.wait_class_stats.endtransfer().getMean()*1000.0 << "]" << endl;
   oss << "    ]);" << endl;
   generatePieChartOptions( oss, "waitClassPie_options", "Wait class mean all probes (ms)", overview_piechart_width,
                            overview_piechart_height, wait_class_colors, 2 );
@@ -408,12 +409,12 @@ void generateSummaryWCAveragePieChart( ostringstream& oss ) {
 void generateSummaryWCSlowTotalPieChart( ostringstream& oss ) {
   oss << "  var waitClassSlowPie_data = google.visualization.arrayToDataTable([" << endl;
   oss << "  ['Wait class','mean']," << endl;
-  oss << "    ['" << "DNS " << num(slow_map[wcDNS].total) << "', " << slow_map[wcDNS].total << "]," << endl;
-  oss << "    ['" << "TCP " << num(slow_map[wcTCPHandshake].total) << "', " << slow_map[wcTCPHandshake].total << "]," << endl;
-  oss << "    ['" << "TLS " << num(slow_map[wcSSLHandshake].total) << "', " << slow_map[wcSSLHandshake].total << "]," << endl;
-  oss << "    ['" << "REQ " << num(slow_map[wcSendStart].total) << "', " << slow_map[wcSendStart].total << "]," << endl;
-  oss << "    ['" << "RSP " << num(slow_map[wcWaitEnd].total) << "', " << slow_map[wcWaitEnd].total << "]," << endl;
-  oss << "    ['" << "DAT " << num(slow_map[wcReceiveEnd].total) << "', " << slow_map[wcReceiveEnd].total << "]," << endl;
+  oss << "    ['" << "DNS " << num(lookup( slow_map, wcDNS ).total) << "', " << lookup( slow_map, wcDNS ).total << "]," << endl;
+  oss << "    ['" << "TCP " << num(lookup( slow_map, wcTCPHandshake ).total) << "', " << lookup( slow_map, wcTCPHandshake ).total << "]," << endl;
+  oss << "    ['" << "TLS " << num(lookup( slow_map, wcSSLHandshake ).total) << "', " << lookup( slow_map, wcSSLHandshake ).total << "]," << endl;
+  oss << "    ['" << "REQ " << num(lookup( slow_map, wcSendStart ).total) << "', " << lookup( slow_map, wcSendStart ).total << "]," << endl;
+  oss << "    ['" << "RSP " << num(lookup( slow_map, wcWaitEnd ).total) << "', " << lookup( slow_map, wcWaitEnd ).total << "]," << endl;
+  oss << "    ['" << "DAT " << num(lookup( slow_map, wcReceiveEnd ).total) << "', " << lookup( slow_map, wcReceiveEnd ).total << "]," << endl;
   oss << "    ]);" << endl;
   generatePieChartOptions( oss, "waitClassSlowPie_options", "Wait class total slow probes", overview_piechart_width,
                            overview_piechart_height, wait_class_colors, 2 );
@@ -431,7 +432,7 @@ void generateHistoryQosChart( ostringstream& oss ) {
   for ( const auto &d : qos_by_date ) {
     //oss << "    ['" << d.first.asString()
     oss << "    [ new Date(" << d.first.year << ", " << d.first.month-1 << ", " <<  d.first.day << ").toDateString(),"
-        << total_date_map[d.first].probe.items << ", "
+        << lookup( total_date_map, d.first ).probe().items << ", "
         << d.second.slow << ", "
         << d.second.curl_errors << ", "
         << d.second.http_errors <<  "]," << endl;
@@ -576,17 +577,18 @@ void generateErrorTrail( ostringstream& oss ) {
  */
 void generateHistoryWCChart( ostringstream& oss ) {
   oss << "  var dateWaitClassTrail_data = google.visualization.arrayToDataTable([" << endl;
-  oss << "  ['date','DNS', 'TCP', 'TLS', 'REQ', 'RSP', 'DAT','Mean','Standard deviation' ]," << endl;
+  oss << "  ['date','DNS', 'TCP', 'TLS', 'REQ', 'RSP', 'DAT','Mean','Standard deviation','p99' ]," << endl;
   for ( const auto &d : total_date_map ) {
     oss << "    [ new Date(" << d.first.year << ", " << d.first.month-1 << ", " <<  d.first.day << ").toDateString(),";
-    oss << d.second.namelookup.getMean() << ", ";
-    oss << d.second.connect.getMean() << ", ";
-    oss << d.second.appconnect.getMean() << ", ";
-    oss << d.second.pretransfer.getMean() << ", ";
-    oss << d.second.starttransfer.getMean() << ", ";
-    oss << d.second.endtransfer.getMean() << ", ";
-    oss << d.second.probe.getMean() << ", ";
-    oss << d.second.probe.getSigma() << "], " << endl;
+    oss << d.second.namelookup().getMean() << ", ";
+    oss << d.second.connect().getMean() << ", ";
+    oss << d.second.appconnect().getMean() << ", ";
+    oss << d.second.pretransfer().getMean() << ", ";
+    oss << d.second.starttransfer().getMean() << ", ";
+    oss << d.second.endtransfer().getMean() << ", ";
+    oss << d.second.probe().getMean() << ", ";
+    oss << d.second.probe().getSigma() << ", ";
+    oss << d.second.probe().getPercentile( 99.0 ) << "], " << endl;
   }
   oss << "    ]);" << endl;
 
@@ -606,6 +608,7 @@ void generateHistoryWCChart( ostringstream& oss ) {
   oss << string(indent+4,' ') << "5: {type: 'bars', color: '" + color_dat + "',curveType: 'function', dataOpacity: 0.8}," << endl;
   oss << string(indent+4,' ') << "6: {type: 'line', color: '" + color_mean + "',curveType: 'function', opacity: 0.8}," << endl;
   oss << string(indent+4,' ') << "7: {type: 'line', color: '" + color_stddev + "',curveType: 'function', opacity: 0.8}," << endl;
+  oss << string(indent+4,' ') << "8: {type: 'line', color: '" + color_p99 + "',curveType: 'function', opacity: 0.8}," << endl;
   oss << string(indent+2,' ') << "}," << endl;
   oss << string(indent+2,' ') << "lineWidth: 2," << endl;
   oss << string(indent+2,' ') << "fontSize: 10," << endl;
@@ -634,12 +637,12 @@ void generateAverageDayChart( ostringstream& oss ) {
   oss << "  ['date','DNS', 'TCP', 'TLS', 'REQ', 'RSP', 'DAT' ]," << endl;
   for ( const auto &d : total_day_map ) {
     oss << "    ['" << d.first.asString() << "', ";
-    oss << d.second.namelookup.getMean() << ", ";
-    oss << d.second.connect.getMean() << ", ";
-    oss << d.second.appconnect.getMean() << ", ";
-    oss << d.second.pretransfer.getMean() << ", ";
-    oss << d.second.starttransfer.getMean() << ", ";
-    oss << d.second.endtransfer.getMean() << "], " << endl;
+    oss << d.second.namelookup().getMean() << ", ";
+    oss << d.second.connect().getMean() << ", ";
+    oss << d.second.appconnect().getMean() << ", ";
+    oss << d.second.pretransfer().getMean() << ", ";
+    oss << d.second.starttransfer().getMean() << ", ";
+    oss << d.second.endtransfer().getMean() << "], " << endl;
   }
   oss << "    ]);" << endl;
 
@@ -672,19 +675,20 @@ void generateAverageDayChart( ostringstream& oss ) {
 /**
  * Generate Google chart JavaScript for a histogram chart on the given QtyStats.
  */
-void generateQtyStatsHistogram( ostringstream& oss, const QtyStats &stats, const string &title, const string &id  ) {
+void generateQtyStatsHistogram( ostringstream& oss, const QtyView &stats, const string &title, const string &id  ) {
   oss << "  var " << id << "_data = google.visualization.arrayToDataTable([" << endl;
   oss << "    ['bucket','probes' ]," << endl;
-  if ( stats.buckets.size() == 0 ) oss << "    ['<0', 0 ]" << endl;
+  HistogramView view = stats.getHistogram();
+  if ( view.buckets.size() == 0 ) oss << "    ['<0', 0 ]" << endl;
 
-  for ( const auto &b : stats.buckets ) {
+  for ( const auto &b : view.buckets ) {
     oss << "    ['< " << fixed << b.first << "', " << b.second << "]," << endl;
   }
   oss << "    ]);" << endl;
 
   unsigned indent = 2;
   oss << string(indent,' ')   << "var " << id << "_options= {" << endl;
-  oss << string(indent+2,' ') << "title: '" << title << " (bucket " << stats.current_bucket << "s)'," << endl;
+  oss << string(indent+2,' ') << "title: '" << title << " (bucket " << view.bucket << "s)'," << endl;
   oss << string(indent+2,' ') << "isStacked: 'absolute'," << endl;
   oss << string(indent+2,' ') << chartarea_histogram << "," << endl;
   oss << string(indent+2,' ') << "width: " << 400 << "," << endl;
@@ -712,12 +716,12 @@ void generateQtyStatsHistogram( ostringstream& oss, const QtyStats &stats, const
  */
 void generateTotalHistogram( ostringstream& oss ) {
   generateQtyStatsHistogram( oss, globalstats.response_stats, "Total response", "totalHistogram" );
-  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.namelookup, "DNS", "dnsHistogram" );
-  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.connect, "TCP", "tcpHistogram" );
-  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.appconnect, "TLS", "tlsHistogram" );
-  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.pretransfer, "REQ", "reqHistogram" );
-  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.starttransfer, "RSP", "rspHistogram" );
-  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.endtransfer, "DAT", "datHistogram" );
+  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.namelookup(), "DNS", "dnsHistogram" );
+  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.connect(), "TCP", "tcpHistogram" );
+  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.appconnect(), "TLS", "tlsHistogram" );
+  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.pretransfer(), "REQ", "reqHistogram" );
+  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.starttransfer(), "RSP", "rspHistogram" );
+  generateQtyStatsHistogram( oss, globalstats.wait_class_stats.endtransfer(), "DAT", "datHistogram" );
 }
 
 /**
@@ -809,12 +813,17 @@ void generateSummary( ostringstream& oss ) {
   oss << "<tr><th>slow probes</th><td>" << globalstats.items_slow << "</td></tr>" << endl;
   oss << "<tr><th>probe errors</th><td>" << curl_error_list.size() << "</td></tr>" << endl;
   oss << "<tr><th>HTTP errors</th><td>" << http_error_list.size() << "</td></tr>" << endl;
+  if ( rejects.total() ) oss << "<tr><th>malformed lines</th><td>" << rejects.asString() << "</td></tr>" << endl;
   size_t total_outside_qos = globalstats.items_slow + curl_error_list.size() + http_error_list.size();
   oss << "<tr><th>QoS</th><td>" << num( (1.0-(double)total_outside_qos/(double)globalstats.total_probes)*100.0 ) << "%</td></tr>" << endl;
   oss << "<tr><th>mean response</th><td>" << num( globalstats.total_time / globalstats.timed_probes ) << "s</td></tr>" << endl;
   oss << "<tr><th>ideal response</th><td>" << num( globalstats.wait_class_stats.getIdealResponse() ) << "s</td></tr>" << endl;
   oss << "<tr><th>minimum response</th><td>" << num( globalstats.response_stats.min ) << "s</td></tr>" << endl;
   oss << "<tr><th>maximum response</th><td>" << num( globalstats.response_stats.max ) << "s</td></tr>" << endl;
+  oss << "<tr><th>p50/p90 response</th><td>" << num( globalstats.response_stats.getPercentile( 50.0 ) ) << "s / "
+      << num( globalstats.response_stats.getPercentile( 90.0 ) ) << "s</td></tr>" << endl;
+  oss << "<tr><th>p99/p99.9 response</th><td>" << num( globalstats.response_stats.getPercentile( 99.0 ) ) << "s / "
+      << num( globalstats.response_stats.getPercentile( 99.9 ) ) << "s</td></tr>" << endl;
   oss << "<tr><th>estimate route RTT</th><td>" << num( globalstats.wait_class_stats.getNetworkRoundtrip()*1000.0 ) << "ms</td></tr>" << endl;
   oss << "<tr><th>avg bytes up</th><td>" << num( (double)globalstats.size_upload/(double)globalstats.timed_probes/1024.0 ) << "KiB</td></tr>" << endl;
   oss << "<tr><th>avg bytes down</th><td>" << num( (double)globalstats.size_download/(double)globalstats.timed_probes/1024.0 ) << "KiB</td></tr>" << endl;
@@ -1037,12 +1046,16 @@ void generateWeekmapResponse( ostringstream& oss ) {
   for ( const auto &wd : weekmap_qtystats ) {
     oss << "<tr><th>" << dowStr( wd.first ) << "</th>" << endl;
     for ( const auto &t : timebuckets ) {
-      const auto i = wd.second.find( t );
-      if ( i != wd.second.end() ) {
+      const QtyStats* q = wd.second.get( t );
+      if ( q ) {
         oss << "<td style=\"background-color: "
-            << colorGradient( (*i).second.getMean(), options.slow_threshold, minval, maxval ) << "\" ";
+            << colorGradient( q->getMean(), options.slow_threshold, minval, maxval ) << "\" ";
         oss << "title=\"" << dowStr( wd.first ) << " " << t.asString() << " response time="
-            << num( (*i).second.getMean() ) <<  "s\">&nbsp;</td>" << endl;
+            << num( q->getMean() ) << "s p50="
+            << num( q->getPercentile( 50.0 ) ) << "s p90="
+            << num( q->getPercentile( 90.0 ) ) << "s p99="
+            << num( q->getPercentile( 99.0 ) ) << "s p99.9="
+            << num( q->getPercentile( 99.9 ) ) <<  "s\">&nbsp;</td>" << endl;
       } else {
         oss << "<td style=\"background-color: #888888\" ";
         oss << "title=\"no data\">&nbsp;</td>" << endl;
@@ -1091,15 +1104,15 @@ void generateWeekmapQoS( ostringstream& oss ) {
   for ( const auto &wp : weekmap_probestats ) {
     oss << "<tr><th>" << dowStr( wp.first ) << "</th>" << endl;
     for ( const auto &t : timebuckets ) {
-      const auto i = wp.second.find( t );
-      if ( i != wp.second.end() ) {
+      const QoS* q = wp.second.get( t );
+      if ( q ) {
         oss << "<td style=\"background-color: "
-            << colorGradient( 100.0 - (*i).second.getQoS(), qos_cutoff,  minval, maxval ) << "\" ";
+            << colorGradient( 100.0 - q->getQoS(), qos_cutoff,  minval, maxval ) << "\" ";
         oss << "title=\"" << dowStr( wp.first ) << " "
-            << t.asString() << " QoS=" << num( (*i).second.getQoS(), 1 ) << "% "
-            << num( (*i).second.getProbeErrorPct(),1  ) << "% probe errors "
-            << num( (*i).second.getHTTPErrorPct(),1  ) << "% http errors "
-            << num( (*i).second.getSlowPct(),1  ) << "% slow "
+            << t.asString() << " QoS=" << num( q->getQoS(), 1 ) << "% "
+            << num( q->getProbeErrorPct(),1  ) << "% probe errors "
+            << num( q->getHTTPErrorPct(),1  ) << "% http errors "
+            << num( q->getSlowPct(),1  ) << "% slow "
             <<  "\">&nbsp;</td>" << endl;
       } else {
         oss << "<td style=\"background-color: #888888\" ";
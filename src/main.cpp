@@ -13,14 +13,18 @@
 #include <cmath>
 
 #include "comments.h"
+#include "archive.h"
 #include "curlprobe.h"
 #include "datekey.h"
 #include "datetime.h"
+#include "follow.h"
 #include "globalstats.h"
 #include "html.h"
 #include "options.h"
 #include "output.h"
 #include "qtystats.h"
+#include "reader.h"
+#include "state.h"
 #include "text.h"
 #include "timekey.h"
 #include "util.h"
@@ -29,140 +33,42 @@
 
 using namespace std;
 
-
-
 /**
- * Read and parse data.
+ * Generate the report of the aggregate in the output format.
+ * @return The report.
  */
-void read( std::istream& in ) {
-  string line;
-  getline( in, line );
-  while ( in.good()  ) {
-    if ( !isCommment( line ) ) {
-      CURLProbe curl;
-      if ( curl.parse( line ) ) {
-        DateKey dkey = DateKey( curl.datetime.year, curl.datetime.month, curl.datetime.day );
-        TimeKey tkey = TimeKey( curl.datetime.hour, curl.datetime.minute );        
-        const auto &qos_ref = qos_by_date.find( dkey );
-        if ( qos_ref == qos_by_date.end() ) qos_by_date[dkey] = { 0, 0, 0 };
-        qos_by_date[dkey].total++;
-        weekmap_probestats[curl.datetime.wday][bucket(tkey,options.weekmap_bucket)].total++;
-        curl_error_map[curl.curl_error]++;
-        if ( curl.curl_error == 0 ) { 
-          http_code_map[curl.http_code]++;
-          if ( curl.http_code >= 400 ) {
-            weekmap_probestats[curl.datetime.wday][bucket(tkey,options.weekmap_bucket)].http_errors++;
-            qos_by_date[dkey].http_errors++;
-            http_error_list.push_back( curl );
-          } else {
-            recent_probes.push_front( curl );
-            while ( recent_probes.size() > 700 ) recent_probes.pop_back();
-            if ( curl.total_time >= options.slow_threshold ) {
-              qos_by_date[dkey].slow++;
-              weekmap_probestats[curl.datetime.wday][bucket(tkey,options.weekmap_bucket)].slow++;
-              slow_map[curl.getDominantWaitClass()].addValue( curl.getWaitClassDuration( curl.getDominantWaitClass() ) );
-              wait_class_map[curl.getDominantWaitClass()]++;
-              if ( options.hasMode( omSlowTrail ) ) slow_repsonse_list.push_back( curl );
-              globalstats.items_slow++;
-              globalstats.total_slow_time += curl.total_time;
-              if ( options.hasMode( omWeekdayMap ) || options.hasMode( omWeekdaySlowMap ) ) {
-                auto &ref = slow_dow_map[curl.datetime.wday];
-                ref.addValues( curl.getWaitClassDuration( wcDNS ), 
-                               curl.getWaitClassDuration( wcTCPHandshake ),
-                               curl.getWaitClassDuration( wcSSLHandshake ),
-                               curl.getWaitClassDuration( wcSendStart ),
-                               curl.getWaitClassDuration( wcWaitEnd ),
-                               curl.getWaitClassDuration( wcReceiveEnd ) );
-              }
-              if ( options.hasMode( om24hMap ) || options.hasMode( om24hSlowMap ) ) {
-                auto &ref = slow_day_map[bucket(tkey,options.day_bucket)];
-                ref.addValues( curl.getWaitClassDuration( wcDNS ), 
-                               curl.getWaitClassDuration( wcTCPHandshake ),
-                               curl.getWaitClassDuration( wcSSLHandshake ),
-                               curl.getWaitClassDuration( wcSendStart ),
-                               curl.getWaitClassDuration( wcWaitEnd ),
-                               curl.getWaitClassDuration( wcReceiveEnd ) );
-              }
-
-              if ( options.hasMode( omDailyTrail ) ) {
-                auto &ref = slow_date_map[dkey];
-                ref.addValues( curl.getWaitClassDuration( wcDNS ), 
-                               curl.getWaitClassDuration( wcTCPHandshake ),
-                               curl.getWaitClassDuration( wcSSLHandshake ),
-                               curl.getWaitClassDuration( wcSendStart ),
-                               curl.getWaitClassDuration( wcWaitEnd ),
-                               curl.getWaitClassDuration( wcReceiveEnd ) );
-              }
-
-            }
-            globalstats.total_time += curl.total_time;
-            globalstats.response_stats.addValue( curl.total_time );
-
-            globalstats.wait_class_stats.namelookup.addValue( curl.getWaitClassDuration( wcDNS ) );
-            globalstats.wait_class_stats.connect.addValue( curl.getWaitClassDuration( wcTCPHandshake ) );
-            globalstats.wait_class_stats.appconnect.addValue( curl.getWaitClassDuration( wcSSLHandshake ) );
-            globalstats.wait_class_stats.pretransfer.addValue( curl.getWaitClassDuration( wcSendStart ) );
-            globalstats.wait_class_stats.starttransfer.addValue( curl.getWaitClassDuration( wcWaitEnd ) );
-            globalstats.wait_class_stats.endtransfer.addValue( curl.getWaitClassDuration( wcReceiveEnd ) );
-
-            if ( options.hasMode( omDailyTrail ) ) {
-              auto &ref = total_date_map[dkey];
-              ref.addValues( curl.getWaitClassDuration( wcDNS ), 
-                              curl.getWaitClassDuration( wcTCPHandshake ),
-                              curl.getWaitClassDuration( wcSSLHandshake ),
-                              curl.getWaitClassDuration( wcSendStart ),
-                              curl.getWaitClassDuration( wcWaitEnd ),
-                              curl.getWaitClassDuration( wcReceiveEnd ) );
-            }
-
-            if ( options.hasMode( om24hMap ) || options.hasMode( om24hSlowMap ) ) {
-              auto &ref = total_day_map[bucket(tkey,options.day_bucket)];
-              ref.addValues( curl.getWaitClassDuration( wcDNS ), 
-                              curl.getWaitClassDuration( wcTCPHandshake ),
-                              curl.getWaitClassDuration( wcSSLHandshake ),
-                              curl.getWaitClassDuration( wcSendStart ),
-                              curl.getWaitClassDuration( wcWaitEnd ),
-                              curl.getWaitClassDuration( wcReceiveEnd ) );
-            }
-
-            if ( options.hasMode( omWeekdayMap ) || options.hasMode( omWeekdaySlowMap ) ) {
-              auto &ref = total_dow_map[curl.datetime.wday];
-              ref.addValues( curl.getWaitClassDuration( wcDNS ), 
-                              curl.getWaitClassDuration( wcTCPHandshake ),
-                              curl.getWaitClassDuration( wcSSLHandshake ),
-                              curl.getWaitClassDuration( wcSendStart ),
-                              curl.getWaitClassDuration( wcWaitEnd ),
-                              curl.getWaitClassDuration( wcReceiveEnd ) );
-            }
-
-            globalstats.size_upload += curl.size_upload;
-            globalstats.size_download += curl.size_download;          
-
-            if ( globalstats.first_time.year == 0 || curl.datetime < globalstats.first_time )
-              globalstats.first_time = curl.datetime;
-            if ( globalstats.last_time.year == 0 ||  curl.datetime > globalstats.last_time )
-              globalstats.last_time = curl.datetime;
-
-            globalstats.timed_probes++;          
-            weekmap_qtystats[curl.datetime.wday][bucket(tkey,options.weekmap_bucket)].addValue( curl.total_time );            
-          }
-        } else {
-          qos_by_date[dkey].curl_errors++;
-          weekmap_probestats[curl.datetime.wday][bucket(tkey,options.weekmap_bucket)].curl_errors++;
-          curl_error_list.push_back( curl );
-        }
-        globalstats.total_probes++;
-      } else {
-        cerr << "error on line " << globalstats.total_probes << endl;
-      }
-    } else {
-      comments.addComment( line );      
-    }
-    getline( in, line );
+static string generateReport() {
+  if ( options.output_format == Options::OutputFormat::HTML ) {
+    HTML html;
+    return html.generate();
   }
+  stringstream ss;
+  streambuf* previous = cout.rdbuf( ss.rdbuf() );
+  try {
+    summary_text();
+  }
+  catch ( ... ) {
+    cout.rdbuf( previous );
+    throw;
+  }
+  cout.rdbuf( previous );
+  return ss.str();
 }
 
+/**
+ * Report the number of duplicate probes dropped by --merge.
+ */
+static void reportDuplicates( size_t duplicates ) {
+  if ( duplicates ) cerr << "dropped " << duplicates << " duplicate probes" << endl;
+}
 
+/**
+ * Report the number of malformed input lines, and write them to the --reject file if given.
+ */
+static void reportRejects( const RejectLog &rejects ) {
+  if ( rejects.total() ) cerr << "skipped malformed lines " << rejects.asString() << endl;
+  if ( options.reject_file.length() ) rejects.write( options.reject_file );
+}
 
 /**
  * Program entry.
@@ -172,16 +78,43 @@ int main( int argc, char* argv[] ) {
     if ( parseArgs( argc, argv, options ) ) {
       StopWatch sw;
       sw.start();
-      read( cin );
+      if ( options.convert_file.length() ) {
+        ArchiveWriter archive( options.convert_file );
+        if ( options.merge )
+          reportDuplicates( mergeFiles( archive, options.input_files ) );
+        else if ( options.input_files.size() )
+          readFiles( archive, options.input_files );
+        else
+          readDescriptor( archive, STDIN_FILENO );
+        archive.close();
+        reportRejects( archive.rejects() );
+        sw.stop();
+        cerr << fixed << setprecision(3) << "converted " << archive.probes() << " probes into " << archive.size() << " bytes in " << sw.getElapsedSeconds() << "s" << endl;
+        return 0;
+      }
+      if ( options.follow_interval ) {
+        follow( aggregate, options.input_files[0], options.report_file, options.follow_interval, generateReport );
+        reportRejects( aggregate.rejects );
+        return 0;
+      }
+      if ( options.state_file.length() ) {
+        readWithState( aggregate, options.input_files[0], options.state_file, options.threads );
+      } else if ( options.merge ) {
+        AggregateSink sink( aggregate );
+        reportDuplicates( mergeFiles( sink, options.input_files ) );
+      } else if ( options.input_engine != Options::InputEngine::Map ) {
+        readLoadedFiles( aggregate, options.input_files, options.threads );
+      } else if ( options.input_files.size() ) {
+        readFiles( aggregate, options.input_files, options.threads );
+      } else {
+        AggregateSink sink( aggregate );
+        readDescriptor( sink, STDIN_FILENO );
+      }
       sw.stop();
       double parse_time = sw.getElapsedSeconds();
+      reportRejects( aggregate.rejects );
       sw.start();
-      if ( options.output_format == Options::OutputFormat::Text )
-        summary_text();
-      else if ( options.output_format == Options::OutputFormat::HTML ) {
-        HTML html;
-        cout << html.generate();
-      }
+      cout << generateReport();
       sw.stop();
       double generation_time = sw.getElapsedSeconds();
       cerr << fixed << setprecision(3) << "parse " << parse_time << "s generation " << generation_time << "s" << endl;
@@ -0,0 +1,38 @@
+#include "mappedfile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile( const string &path ) : path_(path), data_(nullptr), size_(0), device_(0), inode_(0) {
+  int fd = open( path.c_str(), O_RDONLY );
+  if ( fd < 0 ) throw std::runtime_error( "cannot open '" + path + "': " + strerror( errno ) );
+  struct stat st;
+  if ( fstat( fd, &st ) != 0 ) {
+    int err = errno;
+    close( fd );
+    throw std::runtime_error( "cannot stat '" + path + "': " + strerror( err ) );
+  }
+  size_ = st.st_size;
+  device_ = st.st_dev;
+  inode_ = st.st_ino;
+  if ( size_ > 0 ) {
+    void* p = mmap( nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if ( p == MAP_FAILED ) {
+      int err = errno;
+      close( fd );
+      throw std::runtime_error( "cannot mmap '" + path + "': " + strerror( err ) );
+    }
+    madvise( p, size_, MADV_SEQUENTIAL );
+    data_ = static_cast<const char*>( p );
+  }
+  close( fd );
+}
+
+MappedFile::~MappedFile() {
+  if ( data_ ) munmap( const_cast<char*>( data_ ), size_ );
+}
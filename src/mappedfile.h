@@ -0,0 +1,88 @@
+#ifndef mappedfile_h
+#define mappedfile_h
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+/**
+ * A read-only memory mapping of an entire file. The mapping lives as long as the MappedFile object,
+ * string_views handed out by view() must not outlive it.
+ * @code
+ * MappedFile file( "probes.dat" );
+ * string_view data = file.view();
+ * @endcode
+ */
+class MappedFile {
+  public:
+
+    /**
+     * Map the file read-only. Throws a std::runtime_error if the file cannot be opened or mapped.
+     * @param path The file to map.
+     */
+    MappedFile( const string &path );
+
+    /**
+     * Unmap the file.
+     */
+    ~MappedFile();
+
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+
+    /**
+     * Return the start of the mapped data.
+     * @return The mapped data, nullptr if the file is empty.
+     */
+    const char* data() const { return data_; }
+
+    /**
+     * Return the size of the mapped data.
+     * @return The size in bytes.
+     */
+    size_t size() const { return size_; }
+
+    /**
+     * Return the mapped data as a string_view.
+     * @return The mapped data.
+     */
+    string_view view() const { return string_view( data_, size_ ); }
+
+    /**
+     * Return the device of the mapped file.
+     * @return The device number.
+     */
+    uint64_t device() const { return device_; }
+
+    /**
+     * Return the inode of the mapped file.
+     * @return The inode number.
+     */
+    uint64_t inode() const { return inode_; }
+
+    /**
+     * Return the path of the mapped file.
+     * @return The path.
+     */
+    const string& path() const { return path_; }
+
+  private:
+    /** The file path. */
+    string path_;
+
+    /** The mapped data. */
+    const char* data_;
+
+    /** The size of the mapped data. */
+    size_t size_;
+
+    /** The device of the file. */
+    uint64_t device_;
+
+    /** The inode of the file. */
+    uint64_t inode_;
+};
+
+#endif
@@ -1,24 +1,56 @@
 #include "options.h"
 
 #include <cstring>
+#include <getopt.h>
+#include <glob.h>
 
 Options options;
 
 void printHelp() {
   cout << endl;
-  cout << "curlstats reads from standard input" << endl;
+  cout << "curlstats reads from the files given as arguments, or from standard input" << endl;
+  cout << "gzip and zstd compressed input is detected and decompressed" << endl;
   cout << "see https://github.com/jmspit/curlstats" << endl;
   cout << endl;
-  cout << "usage: " << endl;
+  cout << "usage: curlstats [options] [file...]" << endl;
+  cout << "       curlstats convert archive [file...]" << endl;
   cout << "  -b buckets" << endl;
   cout << "     (uint) maximum number of buckets per histogram" << endl;
   cout << "     default: " << DEFAULT_MAX_BUCKETS << " buckets" << endl;
   cout << "  -d threshold" << endl;
   cout << "     (real) specify a slow threshold in seconds" << endl;
   cout << "     default: " << DEFAULT_SLOW_DURATION << " seconds" << endl;
+  cout << "  --direct" << endl;
+  cout << "     with --io uring or pread, open the input files with O_DIRECT, so that reading them does not fill" << endl;
+  cout << "     the page cache" << endl;
+  cout << "  -F seconds" << endl;
+  cout << "     (uint) follow the input file as it grows, like tail -F, and rewrite the --report file at most" << endl;
+  cout << "     every this many seconds. Survives rotation and truncation of the input file, stops on SIGINT" << endl;
+  cout << "     or SIGTERM. Requires a single plain text input file" << endl;
+  cout << "  --from time" << endl;
+  cout << "     only read probes at or after time, format 'YYYY-MM-DD' or 'YYYY-MM-DD HH:MI:SS'. Plain text input" << endl;
+  cout << "     files, which must be in time order, are binary searched rather than read entirely" << endl;
   cout << "  -f format" << endl;
   cout << "     (text) specify the output format, either 'text' or 'html'" << endl;
   cout << "     default: 'text'" << endl;
+  cout << "  --index" << endl;
+  cout << "     keep a sparse index of timestamps next to each plain text input file (file.csidx), built on first" << endl;
+  cout << "     use and updated as the file grows, to find the --from and --to time range and to split the file" << endl;
+  cout << "     over threads" << endl;
+  cout << "  --io engine" << endl;
+  cout << "     how the input files are read" << endl;
+  cout << "       mmap  : memory map the files, large files are split over threads" << endl;
+  cout << "       uring : read the files with io_uring, keeping many large reads in flight across files, and" << endl;
+  cout << "               parse each file on a single thread as soon as it is read, for many (rotated) files." << endl;
+  cout << "               Falls back to pread if io_uring is not available" << endl;
+  cout << "       pread : as uring, but read with pread, one read at a time" << endl;
+  cout << "     default: 'mmap'" << endl;
+  cout << "  -j threads" << endl;
+  cout << "     (uint) number of threads parsing the input files, large files are split over multiple threads" << endl;
+  cout << "     default: " << DEFAULT_THREADS << " threads" << endl;
+  cout << "  --merge" << endl;
+  cout << "     merge the input files, each in time order, by time and drop duplicate probes, for overlapping" << endl;
+  cout << "     logs such as those of a restarted prober or copies taken from several hosts" << endl;
   cout << "  -o option" << endl;
   cout << "     limit the output, multiple options can be given by repeating -o" << endl;
   cout << "       24hmap     : show 24h map of all probes" << endl;
@@ -37,6 +69,22 @@ void printHelp() {
   cout << "  -p threshold" << endl;
   cout << "     only show histogram buckets with % total probes larger than this value (-o histo)" << endl;
   cout << "     default: " << DEFAULT_HISTO_MIN_PCT << " %" <<endl;
+  cout << "  --reject file" << endl;
+  cout << "     write the malformed input lines, which are skipped, to file as 'input:line number: kind: line'." << endl;
+  cout << "     Malformed lines are counted by kind in any case" << endl;
+  cout << "  --report file" << endl;
+  cout << "     the report file written by -F" << endl;
+  cout << "  --schema columns" << endl;
+  cout << "     the ';' separated columns of the probe lines, as curl --write-out variables such as" << endl;
+  cout << "     'datetime;exitcode;http_code;time_total;time_namelookup;...' or as in the curl_http_timing.sh" << endl;
+  cout << "     header. Unknown columns are skipped. By default, the header comment at the start of the input" << endl;
+  cout << "     names the columns, or the curl_http_timing.sh layout is assumed" << endl;
+  cout << "  --state file" << endl;
+  cout << "     keep the aggregated statistics in a state file, so that the next run on the same (growing) input" << endl;
+  cout << "     file only parses the probes appended since. Requires a single plain text input file, a state saved" << endl;
+  cout << "     with different -d, -T, -W, -o or --where options is ignored" << endl;
+  cout << "  --to time" << endl;
+  cout << "     only read probes before time, format as --from" << endl;
   cout << "  -T minutes" << endl;
   cout << "     (uint) 24 hour time bucket in minutes ( 0 < x <= 60 ) (-o 24hmap, 24hslowmap)" << endl;
   cout << "     default: " << DEFAULT_DAY_BUCKET << " minutes" << endl;
@@ -44,6 +92,20 @@ void printHelp() {
   cout << "     (uint) 24 hour weekmap time bucket in minutes ( 0 < x <= 60 ). 60 Must be an integer multiple" << endl;
   cout << "     of this value" << endl;
   cout << "     default: " << DEFAULT_DAY_BUCKET << " minutes" << endl;  
+  cout << "  --where expression" << endl;
+  cout << "     only read the probes for which expression holds, such as" << endl;
+  cout << "     'http_code>=500 or (hour>=8 and hour<18 and wday<6)'. Comparisons (= != < <= > >=) of numbers and" << endl;
+  cout << "     the fields year, month, day, date (YYYYMMDD), hour, minute, second, wday (Monday=1 .. Sunday=7)," << endl;
+  cout << "     exitcode, http_connect, http_code, ssl_verify_result, time_total, time_namelookup, time_connect," << endl;
+  cout << "     time_appconnect, time_pretransfer, time_redirect, time_starttransfer (seconds), size_upload and" << endl;
+  cout << "     size_download, combined with and, or, not and parentheses. Conditions on the time and codes are" << endl;
+  cout << "     checked before the timings of a probe are decoded" << endl;
+  cout << endl;
+  cout << "file arguments containing wildcards (*?[) are expanded, so quoted patterns such as" << endl;
+  cout << "'data/*.dat' work regardless of the shell" << endl;
+  cout << endl;
+  cout << "curlstats convert stores the input in a compact binary archive, which curlstats reads" << endl;
+  cout << "without text parsing, as any other input file" << endl;
   cout << endl;
   cout << waitClass2String( wcDNS, true )  << endl;
   cout << waitClass2String( wcTCPHandshake, true )  << endl;
@@ -53,14 +115,63 @@ void printHelp() {
   cout << waitClass2String( wcReceiveEnd, true )  << endl;
 }
 
+/**
+ * Add an input file argument to options, expanding wildcards.
+ * @return False if a pattern does not match any file.
+ */
+static bool addInputFile( const string &arg, Options &options ) {
+  if ( arg.find_first_of( "*?[" ) == string::npos ) {
+    options.input_files.push_back( arg );
+    return true;
+  }
+  glob_t matches;
+  int r = glob( arg.c_str(), 0, nullptr, &matches );
+  if ( r == 0 ) {
+    for ( size_t i = 0; i < matches.gl_pathc; i++ ) options.input_files.push_back( matches.gl_pathv[i] );
+  }
+  globfree( &matches );
+  if ( r != 0 ) {
+    cerr << "no files match '" << arg << "'" << endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Parse a --from or --to time, either 'YYYY-MM-DD' or 'YYYY-MM-DD HH:MI:SS'.
+ * @return False if the time is invalid.
+ */
+static bool parseTime( const string &arg, int64_t &epoch ) {
+  DateTime dt;
+  if ( !dt.parse( arg.length() == 10 ? arg + " 00:00:00" : arg ) ) return false;
+  epoch = dt.toEpoch();
+  return true;
+}
+
 /**
  * Parse command line arguments.
  */
 bool parseArgs( int argc, char* argv[], Options &options ) {
   string mode = "";
+  bool convert = argc > 1 && strcmp( argv[1], "convert" ) == 0;
+  if ( convert ) optind = 2;
+  static const struct option long_options[] = {
+    { "direct", no_argument, nullptr, 'D' },
+    { "from", required_argument, nullptr, 'N' },
+    { "index", no_argument, nullptr, 'I' },
+    { "io", required_argument, nullptr, 'E' },
+    { "merge", no_argument, nullptr, 'M' },
+    { "reject", required_argument, nullptr, 'J' },
+    { "report", required_argument, nullptr, 'R' },
+    { "schema", required_argument, nullptr, 'L' },
+    { "state", required_argument, nullptr, 'S' },
+    { "to", required_argument, nullptr, 'U' },
+    { "where", required_argument, nullptr, 'G' },
+    { nullptr, 0, nullptr, 0 }
+  };
   for(;;)
   {
-    switch( getopt(argc, argv, "d:tb:T:W:p:o:f:h") )
+    switch( getopt_long(argc, argv, "d:tb:T:W:p:o:f:F:j:h", long_options, nullptr) )
     {
       case 'b':
         try {
@@ -82,6 +193,22 @@ bool parseArgs( int argc, char* argv[], Options &options ) {
           return false;
         }
         continue;
+      case 'D':
+        options.direct_io = true;
+        continue;
+      case 'E':
+        if ( strcmp( optarg, "mmap" ) == 0 )
+          options.input_engine = Options::InputEngine::Map;
+        else if ( strcmp( optarg, "uring" ) == 0 )
+          options.input_engine = Options::InputEngine::Uring;
+        else if ( strcmp( optarg, "pread" ) == 0 )
+          options.input_engine = Options::InputEngine::Pread;
+        else {
+          cerr << "invalid --io engine '" << optarg << "'" << endl;
+          printHelp();
+          return false;
+        }
+        continue;
       case 'f':
         if ( strncmp( optarg, "text", 4) == 0 ) 
           options.output_format = Options::OutputFormat::Text;
@@ -93,6 +220,78 @@ bool parseArgs( int argc, char* argv[], Options &options ) {
           return false;
         }          
         continue;        
+      case 'F': {
+        int interval = 0;
+        try {
+          interval = stoi( optarg );
+        }
+        catch ( const exception& e ) {
+          cerr << "invalid -F value '" << optarg << "'" << endl;
+          printHelp();
+          return false;
+        }
+        if ( interval < 1 ) {
+          cerr << "-F value must be > 0 '" << optarg << "'" << endl;
+          printHelp();
+          return false;
+        }
+        options.follow_interval = static_cast<unsigned>( interval );
+        continue;
+      }
+      case 'G': {
+        string error;
+        options.where = optarg;
+        if ( options.where.empty() || !options.where_filter.compile( options.where, error ) ) {
+          cerr << "invalid --where value '" << optarg << "': " << ( error.length() ? error : "empty" ) << endl;
+          printHelp();
+          return false;
+        }
+        continue;
+      }
+      case 'I':
+        options.time_index = true;
+        continue;
+      case 'j': {
+        int threads = 0;
+        try {
+          threads = stoi( optarg );
+        }
+        catch ( const exception& e ) {
+          cerr << "invalid -j value '" << optarg << "'" << endl;
+          printHelp();
+          return false;
+        }
+        if ( threads < 1 || threads > MAX_THREADS ) {
+          cerr << "-j value must be > 0 and <= " << MAX_THREADS << " '" << optarg << "'" << endl;
+          printHelp();
+          return false;
+        }
+        options.threads = static_cast<unsigned>( threads );
+        continue;
+      }
+      case 'J':
+        options.reject_file = optarg;
+        continue;
+      case 'L': {
+        string error;
+        options.schema = optarg;
+        if ( options.schema.empty() || !options.schema_plan.compile( options.schema, error ) ) {
+          cerr << "invalid --schema value '" << optarg << "': " << ( error.length() ? error : "empty" ) << endl;
+          printHelp();
+          return false;
+        }
+        continue;
+      }
+      case 'M':
+        options.merge = true;
+        continue;
+      case 'N':
+        if ( !parseTime( optarg, options.from_time ) ) {
+          cerr << "invalid --from value '" << optarg << "'" << endl;
+          printHelp();
+          return false;
+        }
+        continue;
       case 'o':
         mode = optarg;
         if ( mode == "all" ) options.output_mode |= omAll;
@@ -125,6 +324,12 @@ bool parseArgs( int argc, char* argv[], Options &options ) {
         }
         if ( options.histo_min_pct > 10.0 ) options.histo_min_pct = DEFAULT_HISTO_MIN_PCT;
         continue;
+      case 'R':
+        options.report_file = optarg;
+        continue;
+      case 'S':
+        options.state_file = optarg;
+        continue;
       case 'T':
         try {
           options.day_bucket = stoi( optarg );
@@ -140,6 +345,13 @@ bool parseArgs( int argc, char* argv[], Options &options ) {
           return false;
         }
         continue;
+      case 'U':
+        if ( !parseTime( optarg, options.to_time ) ) {
+          cerr << "invalid --to value '" << optarg << "'" << endl;
+          printHelp();
+          return false;
+        }
+        continue;
       case 'W':
         try {
           options.weekmap_bucket = stoi( optarg );
@@ -165,11 +377,63 @@ bool parseArgs( int argc, char* argv[], Options &options ) {
     }
     break;
   }
+  if ( convert ) {
+    if ( optind == argc ) {
+      cerr << "convert requires an archive file argument" << endl;
+      printHelp();
+      return false;
+    }
+    options.convert_file = argv[optind++];
+  }
+  for ( ; optind < argc; optind++ ) {
+    if ( !addInputFile( argv[optind], options ) ) return false;
+  }
+  if ( options.state_file.length() && ( options.input_files.size() != 1 || options.convert_file.length() ) ) {
+    cerr << "--state requires a single input file" << endl;
+    return false;
+  }
+  if ( options.hasTimeRange() && options.state_file.length() ) {
+    cerr << "--from and --to cannot be combined with --state" << endl;
+    return false;
+  }
+  if ( options.merge && ( options.input_files.empty() || options.state_file.length() || options.follow_interval ) ) {
+    cerr << "--merge requires input files and cannot be combined with --state or -F" << endl;
+    return false;
+  }
+  if ( options.input_engine != Options::InputEngine::Map &&
+       ( options.input_files.empty() || options.state_file.length() || options.follow_interval || options.merge ||
+         options.convert_file.length() ) ) {
+    cerr << "--io uring or pread requires input files and cannot be combined with --state, -F, --merge or convert" << endl;
+    return false;
+  }
+  if ( options.direct_io && options.input_engine == Options::InputEngine::Map ) {
+    cerr << "--direct requires --io uring or pread" << endl;
+    return false;
+  }
+  if ( options.from_time >= options.to_time ) {
+    cerr << "--from must be before --to" << endl;
+    return false;
+  }
+  if ( options.follow_interval ) {
+    if ( options.input_files.size() != 1 || options.convert_file.length() || options.state_file.length() ) {
+      cerr << "-F requires a single input file and cannot be combined with --state or convert" << endl;
+      return false;
+    }
+    if ( options.report_file.empty() ) {
+      cerr << "-F requires a --report file" << endl;
+      return false;
+    }
+  } else if ( options.report_file.length() ) {
+    cerr << "--report requires -F" << endl;
+    return false;
+  }
   if ( options.output_mode == omNone ) options.output_mode = omAll;
   if ( options.output_format == Options::OutputFormat::HTML && options.output_mode != omAll ) {
     cerr << "cannot specify -o mode with -f html unless mode is 'all'" << endl;
     return false;
   }
+  // an archive must hold all fields
+  options.probe_fields = options.convert_file.length() ? pfAll : options.requiredProbeFields();
   return true;
 }
 
@@ -178,4 +442,13 @@ bool Options::hasMode( OutputMode mode ) const {
   unsigned long t = static_cast<unsigned long>(output_mode);
   unsigned long m = static_cast<unsigned long>(mode);
   return ((t & m) || (t & omAll));
-}
\ No newline at end of file
+}
+
+unsigned Options::requiredProbeFields() const {
+  unsigned fields = pfNone;
+  if ( hasMode( omGlobal ) || hasMode( omHistograms ) || hasMode( omSlowTrail ) || hasMode( omSlowWaitClass ) ||
+       hasMode( omDailyTrail ) || hasMode( om24hMap ) || hasMode( om24hSlowMap ) || hasMode( omWeekdayMap ) ||
+       hasMode( omWeekdaySlowMap ) ) fields |= pfTimings;
+  if ( hasMode( omGlobal ) ) fields |= pfSizes;
+  return fields;
+}
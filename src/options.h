@@ -1,10 +1,17 @@
 #ifndef options_h
 #define options_h
 
+#include "curlprobe.h"
+#include "datetime.h"
+#include "filter.h"
+#include "parseplan.h"
 #include "waitclass.h"
 #include "output.h"
 
+#include <cstdint>
+#include <string>
 #include <unistd.h>
+#include <vector>
 
 /** The default time of day bucket. */
 #define DEFAULT_DAY_BUCKET 60
@@ -24,6 +31,15 @@
 /** Default weekmap_bucket in minutes .*/
 #define DEFAULT_WEEKMAP_BUCKET 30
 
+/** The number of most recent probes kept for the recent trail. */
+#define RECENT_PROBES 700
+
+/** The default number of threads parsing the input. */
+#define DEFAULT_THREADS 1
+
+/** The maximum number of threads parsing the input. */
+#define MAX_THREADS 1024
+
 /**
  * Options passed through command line.
  */
@@ -34,6 +50,12 @@ struct Options {
     HTML      /**< Output as HTML. */
   };
 
+  enum class InputEngine {
+    Map,      /**< Memory map the input files. */
+    Uring,    /**< Load the input files with io_uring, see FileLoader. */
+    Pread     /**< Load the input files with pread, see FileLoader. */
+  };
+
   /**
    * Default constructor.
    */
@@ -43,7 +65,16 @@ struct Options {
               histo_min_pct(DEFAULT_HISTO_MIN_PCT),
               output_format(OutputFormat::Text),
               weekmap_bucket(DEFAULT_WEEKMAP_BUCKET),
-              output_mode(omNone) {};
+              output_mode(omNone),
+              threads(DEFAULT_THREADS),
+              follow_interval(0),
+              from_time(INT64_MIN),
+              to_time(INT64_MAX),
+              time_index(false),
+              merge(false),
+              input_engine(InputEngine::Map),
+              direct_io(false),
+              probe_fields(pfAll) {};
 
   /** Maximum number of buckets in a histogram. */
   unsigned   histo_max_buckets;
@@ -66,6 +97,77 @@ struct Options {
   /** A bitmask of output modes. */
   OutputMode output_mode;
 
+  /** The input files, in the order given, read from standard input if empty. */
+  vector<string> input_files;
+
+  /** The archive written by 'curlstats convert', empty when not converting. */
+  string convert_file;
+
+  /** The state file for incremental reads of a growing input file, empty if not used. */
+  string state_file;
+
+  /** The number of threads parsing the input files. */
+  unsigned threads;
+
+  /** The minimum number of seconds between reports when following the input file, 0 if not following. */
+  unsigned follow_interval;
+
+  /** The report file written when following the input file. */
+  string report_file;
+
+  /** The file the malformed input lines are written to, empty if not written. */
+  string reject_file;
+
+  /** Only probes at or after this time (in seconds since the epoch) are read, INT64_MIN if not limited. */
+  int64_t from_time;
+
+  /** Only probes before this time (in seconds since the epoch) are read, INT64_MAX if not limited. */
+  int64_t to_time;
+
+  /** If true, plain text input files are sliced and split using a sidecar TimeIndex. */
+  bool time_index;
+
+  /** If true, the input files are merged in time order, dropping duplicate probes, see mergeFiles. */
+  bool merge;
+
+  /** How the input files are read. */
+  InputEngine input_engine;
+
+  /** If true, loaded input files are opened with O_DIRECT. */
+  bool direct_io;
+
+  /** The --schema column names, empty if not given. */
+  string schema;
+
+  /** The ParsePlan compiled from schema, used instead of the input headers if schema is given. */
+  ParsePlan schema_plan;
+
+  /** The --where expression, empty if not given. */
+  string where;
+
+  /** The ProbeFilter compiled from where, applied as the probes are read. */
+  ProbeFilter where_filter;
+
+  /** The ProbeFields decoded from probe lines, see requiredProbeFields. */
+  unsigned probe_fields;
+
+  /**
+   * Return true if the probes read are limited to a time range.
+   * @return True if --from or --to was given.
+   */
+  bool hasTimeRange() const { return from_time != INT64_MIN || to_time != INT64_MAX; }
+
+  /**
+   * Return true if a probe time is within the --from and --to time range.
+   * @param dt The probe time.
+   * @return True if the probe is to be read.
+   */
+  bool inTimeRange( const DateTime &dt ) const {
+    if ( !hasTimeRange() ) return true;
+    int64_t epoch = dt.toEpoch();
+    return epoch >= from_time && epoch < to_time;
+  }
+
   /** 
    * Return true if the mode was turned on.
    * @param mode The OutputMode to check.
@@ -73,6 +175,13 @@ struct Options {
    */
   bool hasMode( OutputMode mode ) const;
 
+  /**
+   * Return the ProbeFields the output modes need, so that probe lines are only decoded, and probes
+   * only aggregated, as far as the output requires.
+   * @return The ProbeField bitmask.
+   */
+  unsigned requiredProbeFields() const;
+
   /**
    * Return a description of the slow limit.
    * @return a description of the slow limit.
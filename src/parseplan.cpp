@@ -0,0 +1,463 @@
+#include "parseplan.h"
+#include "options.h"
+#include "scanner.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+static_assert( PARSE_PLAN_MAX_COLUMNS <= SCANNER_MAX_FIELDS, "the LineScanner must keep all columns a ParsePlan can decode" );
+
+/**
+ * The probe columns known to ParsePlan.
+ */
+enum class ProbeColumn : uint8_t {
+  DateTime,
+  CurlError,
+  HTTPConnect,
+  HTTPCode,
+  SSLVerifyResult,
+  TotalTime,
+  NameLookup,
+  Connect,
+  AppConnect,
+  PreTransfer,
+  Redirect,
+  StartTransfer,
+  SizeUpload,
+  SizeDownload,
+  Count
+};
+
+/**
+ * The names of the probe columns, as written in the curl_http_timing.sh header and as curl --write-out
+ * variables, normalized by normalizeName.
+ */
+static const struct {
+  const char* name;
+  ProbeColumn column;
+} column_names[] = {
+  { "yyyy hh:mi:ss", ProbeColumn::DateTime },
+  { "yyyy-mm-dd hh:mi:ss", ProbeColumn::DateTime },
+  { "datetime", ProbeColumn::DateTime },
+  { "timestamp", ProbeColumn::DateTime },
+  { "curl error", ProbeColumn::CurlError },
+  { "curl_error", ProbeColumn::CurlError },
+  { "exitcode", ProbeColumn::CurlError },
+  { "http connect code", ProbeColumn::HTTPConnect },
+  { "http_connect", ProbeColumn::HTTPConnect },
+  { "http response code", ProbeColumn::HTTPCode },
+  { "http_code", ProbeColumn::HTTPCode },
+  { "response_code", ProbeColumn::HTTPCode },
+  { "ssl verify result", ProbeColumn::SSLVerifyResult },
+  { "ssl_verify_result", ProbeColumn::SSLVerifyResult },
+  { "total_time", ProbeColumn::TotalTime },
+  { "time_total", ProbeColumn::TotalTime },
+  { "dns lookup", ProbeColumn::NameLookup },
+  { "time_namelookup", ProbeColumn::NameLookup },
+  { "tcp handshake", ProbeColumn::Connect },
+  { "time_connect", ProbeColumn::Connect },
+  { "ssl handshake", ProbeColumn::AppConnect },
+  { "time_appconnect", ProbeColumn::AppConnect },
+  { "dns lookup+tcp+ssl handshake", ProbeColumn::PreTransfer },
+  { "time_pretransfer", ProbeColumn::PreTransfer },
+  { "redirect time", ProbeColumn::Redirect },
+  { "time_redirect", ProbeColumn::Redirect },
+  { "time to first byte sent", ProbeColumn::StartTransfer },
+  { "time_starttransfer", ProbeColumn::StartTransfer },
+  { "bytes uploaded", ProbeColumn::SizeUpload },
+  { "size_upload", ProbeColumn::SizeUpload },
+  { "bytes downloaded", ProbeColumn::SizeDownload },
+  { "size_download", ProbeColumn::SizeDownload },
+};
+
+/**
+ * The curl_http_timing.sh layout.
+ */
+static const ProbeColumn standard_layout[] = {
+  ProbeColumn::DateTime, ProbeColumn::CurlError, ProbeColumn::HTTPConnect, ProbeColumn::HTTPCode,
+  ProbeColumn::SSLVerifyResult, ProbeColumn::TotalTime, ProbeColumn::NameLookup, ProbeColumn::Connect,
+  ProbeColumn::AppConnect, ProbeColumn::PreTransfer, ProbeColumn::Redirect, ProbeColumn::StartTransfer,
+  ProbeColumn::SizeUpload, ProbeColumn::SizeDownload
+};
+
+/**
+ * Lowercase a column name, strip whitespace and a %{} around it, and collapse inner whitespace.
+ */
+static string normalizeName( string_view name ) {
+  string result;
+  bool space = false;
+  for ( char c : name ) {
+    if ( isspace( static_cast<unsigned char>( c ) ) ) {
+      space = !result.empty();
+      continue;
+    }
+    if ( space ) result.push_back( ' ' );
+    space = false;
+    result.push_back( static_cast<char>( tolower( static_cast<unsigned char>( c ) ) ) );
+  }
+  if ( result.size() > 3 && result.compare( 0, 2, "%{" ) == 0 && result.back() == '}' )
+    result = result.substr( 2, result.size() - 3 );
+  return result;
+}
+
+/**
+ * Return the ProbeColumn named name, or ProbeColumn::Count for an unknown name.
+ */
+static ProbeColumn columnOf( const string &name ) {
+  for ( const auto &c : column_names ) {
+    if ( name == c.name ) return c.column;
+  }
+  return ProbeColumn::Count;
+}
+
+/** The decoders, indexed by ProbeColumn. */
+static bool (* const decoders[])( string_view, CURLProbe& ) = {
+  []( string_view t, CURLProbe &p ) { return p.datetime.parse( t ); },
+  []( string_view t, CURLProbe &p ) { return parseInt( t, p.curl_error ); },
+  []( string_view t, CURLProbe &p ) { return parseInt( t, p.http_connect ); },
+  []( string_view t, CURLProbe &p ) { return parseInt( t, p.http_code ); },
+  []( string_view t, CURLProbe &p ) { return parseInt( t, p.ssl_verify_result ); },
+  []( string_view t, CURLProbe &p ) { return parseReal( t, p.total_time ); },
+  []( string_view t, CURLProbe &p ) { return parseReal( t, p.time_namelookup ); },
+  []( string_view t, CURLProbe &p ) { return parseReal( t, p.time_connect ); },
+  []( string_view t, CURLProbe &p ) { return parseReal( t, p.time_appconnect ); },
+  []( string_view t, CURLProbe &p ) { return parseReal( t, p.time_pretransfer ); },
+  []( string_view t, CURLProbe &p ) { return parseReal( t, p.time_redirect ); },
+  []( string_view t, CURLProbe &p ) { return parseReal( t, p.time_starttransfer ); },
+  []( string_view t, CURLProbe &p ) { return parseInt( t, p.size_upload ); },
+  []( string_view t, CURLProbe &p ) { return parseInt( t, p.size_download ); },
+};
+
+static_assert( sizeof(decoders) / sizeof(decoders[0]) == static_cast<size_t>( ProbeColumn::Count ), "a decoder per ProbeColumn" );
+
+/**
+ * Return true if column is decoded only when pfTimings is requested.
+ */
+static bool isTiming( ProbeColumn column ) {
+  return column >= ProbeColumn::TotalTime && column <= ProbeColumn::StartTransfer;
+}
+
+/**
+ * Return true if column is decoded only when pfSizes is requested.
+ */
+static bool isSize( ProbeColumn column ) {
+  return column == ProbeColumn::SizeUpload || column == ProbeColumn::SizeDownload;
+}
+
+/**
+ * Return the ParseResult of a column that does not decode.
+ */
+static ParseResult columnError( ProbeColumn column ) {
+  if ( column == ProbeColumn::DateTime ) return prDateTime;
+  if ( isTiming( column ) ) return prTiming;
+  if ( isSize( column ) ) return prSize;
+  return prCode;
+}
+
+const char* parseErrorName( ParseResult result ) {
+  static const char* const names[PARSE_ERROR_KINDS] = {
+    "too few columns", "bad date and time", "bad code", "bad timing", "bad size", "malformed JSON"
+  };
+  return names[result - PARSE_ERROR_FIRST];
+}
+
+ParsePlan::ParsePlan() : min_tokens_(0), datetime_column_(0) {
+  for ( size_t i = 0; i < sizeof(standard_layout) / sizeof(standard_layout[0]); i++ ) {
+    Step step = { static_cast<uint8_t>( i ), decoders[static_cast<size_t>( standard_layout[i] )], columnError( standard_layout[i] ) };
+    if ( isSize( standard_layout[i] ) ) sizes_.push_back( step );
+    else {
+      if ( isTiming( standard_layout[i] ) ) timings_.push_back( step ); else base_.push_back( step );
+      min_tokens_ = i + 1;
+    }
+  }
+}
+
+bool ParsePlan::compile( string_view layout, string &error ) {
+  if ( layout.size() && layout[0] == '#' ) layout.remove_prefix( 1 );
+  vector<string> names = split( string( layout ), ';' );
+  vector<Step> base, timings, sizes;
+  size_t min_tokens = 0;
+  size_t datetime_column = 0;
+  bool seen[static_cast<size_t>( ProbeColumn::Count )] = {};
+  for ( size_t i = 0; i < names.size(); i++ ) {
+    string name = normalizeName( names[i] );
+    ProbeColumn column = columnOf( name );
+    if ( column == ProbeColumn::Count ) continue;
+    if ( seen[static_cast<size_t>( column )] ) {
+      error = "column '" + name + "' appears twice";
+      return false;
+    }
+    if ( i >= PARSE_PLAN_MAX_COLUMNS ) {
+      error = "column '" + name + "' is beyond column " + to_string( PARSE_PLAN_MAX_COLUMNS );
+      return false;
+    }
+    seen[static_cast<size_t>( column )] = true;
+    if ( column == ProbeColumn::DateTime ) datetime_column = i;
+    Step step = { static_cast<uint8_t>( i ), decoders[static_cast<size_t>( column )], columnError( column ) };
+    if ( isSize( column ) ) sizes.push_back( step );
+    else {
+      if ( isTiming( column ) ) timings.push_back( step ); else base.push_back( step );
+      min_tokens = max( min_tokens, i + 1 );
+    }
+  }
+  if ( !seen[static_cast<size_t>( ProbeColumn::DateTime )] ) {
+    error = "no date and time column";
+    return false;
+  }
+  base_ = move( base );
+  timings_ = move( timings );
+  sizes_ = move( sizes );
+  min_tokens_ = min_tokens;
+  datetime_column_ = datetime_column;
+  return true;
+}
+
+ParseResult ParsePlan::parse( CURLProbe &probe, const string_view* tokens, size_t count, unsigned fields,
+                             const ProbeFilter* filter ) const {
+  if ( count < min_tokens_ ) return prColumns;
+  probe.curl_error = 0;
+  probe.http_connect = 0;
+  probe.http_code = 0;
+  probe.ssl_verify_result = 0;
+  for ( const auto &step : base_ ) {
+    if ( !step.decode( tokens[step.token], probe ) ) return step.error;
+  }
+  if ( filter ) {
+    if ( filter->rejects( probe, pfNone ) ) return prFiltered;
+    fields |= filter->fields();
+  }
+  probe.total_time         = 0.0;
+  probe.time_namelookup    = 0.0;
+  probe.time_connect       = 0.0;
+  probe.time_appconnect    = 0.0;
+  probe.time_pretransfer   = 0.0;
+  probe.time_redirect      = 0.0;
+  probe.time_starttransfer = 0.0;
+  if ( ( fields & pfTimings ) || ( probe.curl_error == 0 && probe.http_code >= 400 ) ) {
+    for ( const auto &step : timings_ ) {
+      if ( !step.decode( tokens[step.token], probe ) ) return step.error;
+    }
+  }
+  probe.size_upload   = 0;
+  probe.size_download = 0;
+  if ( fields & pfSizes ) {
+    for ( const auto &step : sizes_ ) {
+      if ( step.token < count && !step.decode( tokens[step.token], probe ) ) return step.error;
+    }
+  }
+  if ( filter && filter->fields() && filter->rejects( probe ) ) return prFiltered;
+  probe.decompose();
+  return prProbe;
+}
+
+/** The number of slots of the JSON key table, a power of 2. */
+#define JSON_KEY_SLOTS 256
+
+/**
+ * Return the slot of a JSON key, from its length and its first and last bytes.
+ */
+static inline size_t jsonSlot( string_view key ) {
+  return ( key.size() * 31 + static_cast<uint8_t>( key.front() ) * 7 + static_cast<uint8_t>( key.back() ) ) &
+         ( JSON_KEY_SLOTS - 1 );
+}
+
+/**
+ * The column names usable as JSON keys (those without spaces, except the date and time) hashed by jsonSlot,
+ * so that most keys are dismissed without a string compare.
+ */
+static const vector<pair<string_view,ProbeColumn>>* jsonKeys() {
+  static const auto keys = [] {
+    vector<vector<pair<string_view,ProbeColumn>>> keys( JSON_KEY_SLOTS );
+    for ( const auto &c : column_names ) {
+      string_view name( c.name );
+      if ( name.find( ' ' ) != string_view::npos || c.column == ProbeColumn::DateTime ) continue;
+      keys[jsonSlot( name )].push_back( { name, c.column } );
+    }
+    return keys;
+  }();
+  return keys.data();
+}
+
+/**
+ * Return the ProbeColumn named by a JSON key, or ProbeColumn::Count.
+ */
+static inline ProbeColumn jsonColumn( string_view key ) {
+  if ( key.empty() ) return ProbeColumn::Count;
+  for ( const auto &k : jsonKeys()[jsonSlot( key )] ) {
+    if ( k.first == key ) return k.second;
+  }
+  return ProbeColumn::Count;
+}
+
+/**
+ * Return true if c is JSON whitespace.
+ */
+static inline bool isSpace( char c ) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/**
+ * Skip JSON whitespace.
+ */
+static inline const char* skipSpace( const char* p, const char* end ) {
+  while ( p < end && isSpace( *p ) ) p++;
+  return p;
+}
+
+/**
+ * Finds the unescaped quotes of a JSON text, 64 bytes at a time, so that the bytes inside strings are
+ * never looked at one by one.
+ */
+class QuoteCursor {
+  public:
+    QuoteCursor( const char* end ) : end_(end), block_(nullptr), mask_(0) {}
+
+    /**
+     * Return the first unescaped quote at or after p, or end.
+     */
+    const char* next( const char* p ) {
+      for (;;) {
+        if ( p < block_ || p >= block_ + 64 ) load( p );
+        uint64_t mask = mask_ >> ( p - block_ );
+        if ( !mask ) {
+          if ( block_ + 64 >= end_ ) return end_;
+          p = block_ + 64;
+          continue;
+        }
+        const char* q = p + __builtin_ctzll( mask );
+        // the quote is escaped if preceded by an odd number of backslashes
+        const char* b = q;
+        while ( b > p && b[-1] == '\\' ) b--;
+        if ( ( q - b ) % 2 == 0 ) return q;
+        p = q + 1;
+      }
+    }
+
+  private:
+    /** Compute the mask of the (up to) 64 bytes at p. */
+    void load( const char* p ) {
+      block_ = p;
+      if ( end_ - p >= 64 ) mask_ = quoteMask( p );
+      else {
+        mask_ = 0;
+        for ( const char* c = p; c < end_; c++ ) mask_ |= static_cast<uint64_t>( *c == '"' ) << ( c - p );
+      }
+    }
+
+    /** The end of the text. */
+    const char* end_;
+
+    /** The start of the 64 byte block in mask_. */
+    const char* block_;
+
+    /** The quotes in the block. */
+    uint64_t mask_;
+};
+
+/**
+ * Return the end of the JSON object or array starting at p, or end.
+ */
+static const char* nestedEnd( const char* p, const char* end, QuoteCursor &quotes ) {
+  size_t depth = 0;
+  while ( p < end ) {
+    char c = *p++;
+    if ( c == '"' ) {
+      p = quotes.next( p );
+      if ( p < end ) p++;
+    } else if ( c == '{' || c == '[' ) depth++;
+    else if ( c == '}' || c == ']' ) {
+      if ( --depth == 0 ) return p;
+    }
+  }
+  return end;
+}
+
+ParseResult parseJSON( CURLProbe &probe, const string_view* tokens, size_t json_token, string_view line, unsigned fields,
+                       const ProbeFilter* filter ) {
+  static const ParsePlan plan = [] {
+    // the tokens are the values indexed by ProbeColumn
+    ParsePlan plan;
+    string error;
+    plan.compile( "datetime;curl_error;http_connect;http_code;ssl_verify_result;time_total;time_namelookup;"
+                  "time_connect;time_appconnect;time_pretransfer;time_redirect;time_starttransfer;size_upload;"
+                  "size_download", error );
+    return plan;
+  }();
+  string_view values[static_cast<size_t>( ProbeColumn::Count )];
+  for ( auto &v : values ) v = "0";
+  values[static_cast<size_t>( ProbeColumn::DateTime )] = tokens[0];
+  // once all columns are found, the rest of the object is not scanned
+  const unsigned all = ( 1u << static_cast<unsigned>( ProbeColumn::Count ) ) - 1;
+  unsigned found = 1u << static_cast<unsigned>( ProbeColumn::DateTime );
+  if ( json_token == 2 ) found |= 1u << static_cast<unsigned>( ProbeColumn::CurlError );
+  const char* p = tokens[json_token].data() + 1;
+  const char* end = line.data() + line.size();
+  QuoteCursor quotes( end );
+  for (;;) {
+    p = skipSpace( p, end );
+    if ( p == end ) return prJSON;
+    if ( *p == '}' ) break;
+    if ( *p != '"' ) return prJSON;
+    const char* key = ++p;
+    p = quotes.next( p );
+    if ( p == end ) return prJSON;
+    ProbeColumn column = jsonColumn( string_view( key, p - key ) );
+    p = skipSpace( p + 1, end );
+    if ( p == end || *p != ':' ) return prJSON;
+    p = skipSpace( p + 1, end );
+    if ( p == end ) return prJSON;
+    const char* value = p;
+    const char* value_end;
+    if ( *p == '"' ) {
+      value = ++p;
+      p = quotes.next( p );
+      if ( p == end ) return prJSON;
+      value_end = p++;
+    } else if ( *p == '{' || *p == '[' ) {
+      p = nestedEnd( p, end, quotes );
+      value_end = p;
+    } else {
+      while ( p < end && *p != ',' && *p != '}' && !isSpace( *p ) ) p++;
+      value_end = p;
+    }
+    string_view v( value, value_end - value );
+    if ( column != ProbeColumn::Count && v != "null" ) {
+      values[static_cast<size_t>( column )] = v;
+      found |= 1u << static_cast<unsigned>( column );
+      if ( found == all ) break;
+    }
+    p = skipSpace( p, end );
+    if ( p == end ) return prJSON;
+    if ( *p == '}' ) break;
+    if ( *p != ',' ) return prJSON;
+    p++;
+  }
+  if ( json_token == 2 ) values[static_cast<size_t>( ProbeColumn::CurlError )] = tokens[1];
+  return plan.parse( probe, values, static_cast<size_t>( ProbeColumn::Count ), fields, filter );
+}
+
+ParseState::ParseState() : plan(options.schema_plan), header_allowed(options.schema.empty()), line_number(0) {
+}
+
+void ParseState::header( string_view line ) {
+  if ( line.find( ';' ) == string_view::npos ) return;
+  ParsePlan header_plan;
+  string error;
+  if ( header_plan.compile( line, error ) ) plan = move( header_plan );
+}
+
+ParseState leadingParseState( string_view data, string_view input ) {
+  ParseState state;
+  state.input = input;
+  for ( size_t pos = 0; pos < data.size() && state.header_allowed; ) {
+    size_t end = data.find( '\n', pos );
+    if ( end == string_view::npos ) end = data.size();
+    string_view line = stripCR( data.substr( pos, end - pos ) );
+    if ( isCommment( line ) ) state.comment( line ); else state.probe();
+    pos = end + 1;
+  }
+  state.probe();
+  return state;
+}
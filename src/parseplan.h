@@ -0,0 +1,220 @@
+#ifndef parseplan_h
+#define parseplan_h
+
+#include "curlprobe.h"
+#include "filter.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/** The maximum number of ';' separated columns of a probe line that can be decoded. */
+#define PARSE_PLAN_MAX_COLUMNS 32
+
+/**
+ * The outcome of decoding a probe line, the results from prColumns on are the kinds of malformed line.
+ */
+enum ParseResult {
+  prProbe,     /**< The line decoded into a probe. */
+  prFiltered,  /**< The probe was rejected by the --where ProbeFilter. */
+  prColumns,   /**< The line has too few columns. */
+  prDateTime,  /**< The date and time do not decode. */
+  prCode,      /**< The curl error, an HTTP code or the SSL verify result does not decode. */
+  prTiming,    /**< A timing does not decode. */
+  prSize,      /**< A size does not decode. */
+  prJSON       /**< The JSON object is malformed. */
+};
+
+/** The first ParseResult that is a malformed line. */
+#define PARSE_ERROR_FIRST prColumns
+
+/** The number of kinds of malformed line. */
+#define PARSE_ERROR_KINDS ( prJSON - prColumns + 1 )
+
+/**
+ * Return true if a ParseResult is a malformed line.
+ * @param result The ParseResult.
+ * @return True for prColumns and later.
+ */
+inline bool isParseError( ParseResult result ) { return result >= PARSE_ERROR_FIRST; }
+
+/**
+ * Return a description of a kind of malformed line, such as "bad timing".
+ * @param result The ParseResult, prColumns or later.
+ * @return The description.
+ */
+const char* parseErrorName( ParseResult result );
+
+/**
+ * The layout of probe lines compiled into a table of column index and decoder, so that lines in any column
+ * order, or with extra columns, are decoded at the same cost as the fixed curl_http_timing.sh layout.
+ *
+ * A layout is a ';' separated list of column names, either the names in the header comment written by
+ * curl_http_timing.sh, such as
+ * @code
+ * # YYYY HH:MI:SS ; curl error ; http connect code ; http response code ; ssl verify result ; total_time ; ...
+ * @endcode
+ * or curl --write-out variable names, with or without %{}, such as
+ * @code
+ * datetime;%{exitcode};%{http_code};%{time_total};%{time_namelookup};%{time_connect}
+ * @endcode
+ * Names are case insensitive, columns with unknown names are skipped.
+ */
+class ParsePlan {
+  public:
+    /**
+     * Construct the plan of the curl_http_timing.sh layout.
+     */
+    ParsePlan();
+
+    /**
+     * Compile a layout.
+     * @param layout The ';' separated column names, a leading '#' is ignored.
+     * @param error Receives the reason the layout is invalid.
+     * @return False if the layout has no date and time column, names a column twice, or places a column
+     * beyond PARSE_PLAN_MAX_COLUMNS.
+     */
+    bool compile( string_view layout, string &error );
+
+    /**
+     * Decode a probe line split into ';' separated tokens. Fields not in fields are set to 0 and not
+     * validated, except that the timings of an HTTP error are always decoded, as the error trail shows them.
+     * Columns absent from the layout are set to 0, as are the size columns if the line ends before them.
+     * A filter is applied as soon as the date, time and codes are decoded, so that the timings of rejected
+     * probes are not decoded unless the filter needs them.
+     * @param probe Receives the probe.
+     * @param tokens The tokens, at least min(count,PARSE_PLAN_MAX_COLUMNS) must be valid.
+     * @param count The number of tokens in the line.
+     * @param fields The ProbeFields to decode.
+     * @param filter The filter, nullptr to accept all probes.
+     * @return prColumns if the line has too few tokens, the kind of the first token that does not decode
+     * (prDateTime, prCode, prTiming or prSize), or prFiltered if the filter rejects the probe.
+     */
+    ParseResult parse( CURLProbe &probe, const string_view* tokens, size_t count, unsigned fields,
+                       const ProbeFilter* filter = nullptr ) const;
+
+    /**
+     * Return the index of the date and time column, lines are only searched by time (see sliceTimeRange)
+     * if it is the first column.
+     * @return The column index.
+     */
+    size_t datetimeColumn() const { return datetime_column_; }
+
+  private:
+    /** Decodes a token into a CURLProbe member. */
+    typedef bool (*Decoder)( string_view token, CURLProbe &probe );
+
+    /** A column to decode. */
+    struct Step {
+      /** The index of the token. */
+      uint8_t token;
+      /** The decoder. */
+      Decoder decode;
+      /** The ParseResult if the token does not decode. */
+      ParseResult error;
+    };
+
+    /** The columns that are always decoded. */
+    vector<Step> base_;
+
+    /** The timing columns, decoded if pfTimings is requested. */
+    vector<Step> timings_;
+
+    /** The size columns, decoded if pfSizes is requested and present. */
+    vector<Step> sizes_;
+
+    /** The minimum number of tokens in a line, up to and including the last non-size column. */
+    size_t min_tokens_;
+
+    /** The index of the date and time column. */
+    size_t datetime_column_;
+};
+
+/**
+ * Return the index of the token starting a curl %{json} write-out object, which follows the date and time
+ * and optionally the curl exit code, as in
+ * @code
+ * 2020-11-01 08:03:43;0;{"content_type":"text/html","exitcode":0,"http_code":200,...,"time_total":0.538611,...}
+ * @endcode
+ * @param tokens The ';' separated tokens of a probe line.
+ * @param count The number of tokens.
+ * @return 1 or 2, or 0 if the line is not a JSON probe line.
+ */
+inline size_t jsonToken( const string_view* tokens, size_t count ) {
+  if ( count > 1 && tokens[1].size() && tokens[1][0] == '{' ) return 1;
+  if ( count > 2 && tokens[2].size() && tokens[2][0] == '{' ) return 2;
+  return 0;
+}
+
+/**
+ * Decode a JSON probe line. The object is scanned on demand, without building a document: the values of
+ * the keys naming probe columns (the curl --write-out variable names, see ParsePlan) are picked out, all
+ * other values are skipped. Absent keys decode as 0. A curl exit code preceding the object takes precedence
+ * over an "exitcode" key. Fields are decoded as by ParsePlan::parse.
+ * @param probe Receives the probe.
+ * @param tokens The ';' separated tokens of the line, pointing into line.
+ * @param json_token The index of the token starting the object, as returned by jsonToken.
+ * @param line The line.
+ * @param fields The ProbeFields to decode.
+ * @param filter The filter, nullptr to accept all probes.
+ * @return prJSON if the object is malformed, the kind of a value that does not decode as by ParsePlan::parse,
+ * or prFiltered if the filter rejects the probe.
+ */
+ParseResult parseJSON( CURLProbe &probe, const string_view* tokens, size_t json_token, string_view line, unsigned fields,
+                       const ProbeFilter* filter = nullptr );
+
+/**
+ * The ParsePlan in effect while reading a file or stream. Unless --schema was given, a header among
+ * the comment lines preceding the first probe line sets the plan, later headers are ignored.
+ */
+struct ParseState {
+  /**
+   * Construct a ParseState with the --schema plan, or the curl_http_timing.sh plan.
+   */
+  ParseState();
+
+  /**
+   * Handle a comment line.
+   * @param line The comment line.
+   */
+  void comment( string_view line ) {
+    if ( header_allowed ) header( line );
+  }
+
+  /**
+   * Handle a probe line, after which headers are ignored.
+   */
+  void probe() { header_allowed = false; }
+
+  /** The plan. */
+  ParsePlan plan;
+
+  /** True until the first probe line, if --schema was not given. */
+  bool header_allowed;
+
+  /** The name of the input, the path of a file or "-" for standard input, reported with malformed lines. */
+  string_view input;
+
+  /** The number of lines read, counted by the readers. */
+  uint64_t line_number;
+
+  private:
+    /**
+     * Compile a header comment line into plan.
+     */
+    void header( string_view line );
+};
+
+/**
+ * Return the ParseState in effect after the comment lines at the start of data, so that parts of data
+ * can be parsed independently.
+ * @param data The data.
+ * @param input The name of the input.
+ * @return The ParseState, with header_allowed false and no lines read.
+ */
+ParseState leadingParseState( string_view data, string_view input );
+
+#endif
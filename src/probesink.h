@@ -0,0 +1,51 @@
+#ifndef probesink_h
+#define probesink_h
+
+#include "curlprobe.h"
+#include "parseplan.h"
+
+#include <cstdint>
+#include <string_view>
+
+using namespace std;
+
+/**
+ * Receives the probes and comments read from input, in input order. The readers in reader.h parse
+ * input into a ProbeSink, which either aggregates the probes for a report or, as an ArchiveWriter,
+ * stores them.
+ */
+struct ProbeSink {
+
+  virtual ~ProbeSink() {}
+
+  /**
+   * Receive a parsed probe.
+   * @param curl The probe.
+   */
+  virtual void probe( const CURLProbe &curl ) = 0;
+
+  /**
+   * Receive a probe parsed from an input line still in memory, by default as probe().
+   * @param curl The probe.
+   * @param line The line it was parsed from, without line terminator.
+   */
+  virtual void probeLine( const CURLProbe &curl, string_view line ) { probe( curl ); }
+
+  /**
+   * Receive a comment line.
+   * @param line The comment line, without line terminator.
+   */
+  virtual void comment( string_view line ) = 0;
+
+  /**
+   * Receive a malformed line.
+   * @param line The line, without line terminator.
+   * @param kind The kind of malformation, see isParseError.
+   * @param input The name of the input, see ParseState::input.
+   * @param number The line number, counted from the start of the data read, see ParseState::line_number.
+   */
+  virtual void error( string_view line, ParseResult kind, string_view input, uint64_t number ) = 0;
+
+};
+
+#endif
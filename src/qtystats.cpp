@@ -12,7 +12,6 @@ QtyStats::QtyStats() :
   total(0.0),
   _M(0.0),
   _C(0.0),
-  current_bucket(initial_bucket),
   items(0) {
 
   };
@@ -31,21 +30,28 @@ void QtyStats::addValue( double d ) {
     _C += delta * (d - _M);
   }
   total += d;
-  double buck = bucket( d, current_bucket );
-  buckets[ buck ]++;
-  while ( buckets.size() > options.histo_max_buckets ) reBucket();
+  histogram.add( d );
 }
 
-void QtyStats::reBucket() {
-  current_bucket *= 10.0;
-  map<double,size_t> tmp;
-  for ( const auto& old : buckets ) {
-    tmp[ bucket( old.first, current_bucket ) ] += old.second;
-  }
-  buckets = tmp;
+void QtyStats::merge( const QtyStats& other ) {
+  if ( other.items == 0 ) return;
+  if ( items == 0 || other.min < min ) min = other.min;
+  if ( items == 0 || other.max > max ) max = other.max;
+  // combine mean and variance trackers (Chan et al.)
+  double n = (double)items + (double)other.items;
+  double delta = other._M - _M;
+  _M += delta * (double)other.items / n;
+  _C += other._C + delta * delta * (double)items * (double)other.items / n;
+  items += other.items;
+  total += other.total;
+  histogram.merge( other.histogram );
+}
+
+HistogramView QtyView::getHistogram() const {
+  return histogram.view( options.histo_max_buckets, min, max );
 }
 
-string QtyStats::asString( bool stddev ) {
+string QtyView::asString( bool stddev ) const {
   stringstream ss;
   ss << FIXED3W7 << min << " ";
   ss << FIXED3W7 << max << " ";
@@ -56,7 +62,16 @@ string QtyStats::asString( bool stddev ) {
   return ss.str();
 }
 
-string QtyStats::consistency() {
+string QtyView::percentileString() const {
+  stringstream ss;
+  ss << FIXED3W7 << getPercentile( 50.0 ) << " ";
+  ss << FIXED3W7 << getPercentile( 90.0 ) << " ";
+  ss << FIXED3W7 << getPercentile( 99.0 ) << " ";
+  ss << FIXED3W7 << getPercentile( 99.9 ) << " ";
+  return ss.str();
+}
+
+string QtyView::consistency() const {
   const double avg = getMean();
   const double sdev = getSigma();
   // what is the relation between minimum=ideal and the average?
@@ -85,12 +100,13 @@ string QtyStats::consistency() {
   return ss.str();
 }  
 
-double QtyStats::getMean() const {
-  return _M;
-}
-
-double QtyStats::getSigma() const {
+double QtyView::getSigma() const {
   double sdev = 0;
   if ( items > 1 ) sdev = sqrt( _C / ( items - 1) );
   return sdev;
-}
\ No newline at end of file
+}
+
+double QtyView::getPercentile( double pct ) const {
+  if ( items == 0 ) return 0.0;
+  return std::min( max, std::max( min, histogram.quantile( pct / 100.0 ) ) );
+}
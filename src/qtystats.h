@@ -1,20 +1,108 @@
 #ifndef qtytats_h
 #define qtytats_h
 
+#include "histogram.h"
+
 #include <cmath>
-#include <map>
+#include <string>
 
 using namespace std;
 
+struct QtyStats;
+
+/**
+ * A read-only view of statistics kept elsewhere, a QtyStats or a lane of a ProbeStats, that reads them as
+ * QtyStats does, holding the histogram by reference so that a view is cheap to make and pass by value.
+ */
+struct QtyView {
+
+  /**
+   * View a QtyStats.
+   * @param stats The QtyStats, which must outlive the view.
+   */
+  QtyView( const QtyStats &stats );
+
+  /**
+   * View statistics as the members of QtyStats.
+   */
+  QtyView( double min, double max, double total, double M, double C, size_t items, const Histogram &histogram ) :
+    min(min), max(max), total(total), _M(M), _C(C), items(items), histogram(histogram) {}
+
+  /** The minimum value added. */
+  double min;
+
+  /** The maximum value added. */
+  double max;
+
+  /** The sum of values added. */
+  double total;
+
+  /** To track average and stddev. */
+  double _M;
+
+  /** To track average and stddev. */
+  double _C;
+
+  /** The number of values added. */
+  size_t items;
+
+  /** The histogram. */
+  const Histogram &histogram;
+
+  /**
+   * Return the histogram coarsened to at most -b buckets.
+   * @return The coarsened histogram.
+   */
+  HistogramView getHistogram() const;
+
+  /**
+   * Return the statistics as a formatted string.
+   * @param stddev If true, include the standard deviation.
+   * @return the formatted string.
+   */
+  string asString( bool stddev = false ) const;
+
+  /**
+   * Return the p50, p90, p99 and p99.9 percentiles as a formatted string, in the layout of asString.
+   * @return the formatted string.
+   */
+  string percentileString() const;
+
+  /**
+   * Return a word describing the consistency of the timings. To convince managers who think numbers are also incomprehensible.
+   * Please do not take this too seriously - look at the numbers instead.
+   * @return A juding word.
+   */
+  string consistency() const;
+
+  /**
+   * Return the average (mean) of the added values.
+   * @return The average.
+   */
+  double getMean() const { return _M; }
+
+  /**
+   * Return the standard deviation in the added values.
+   * @return The standard deviation.
+   */
+  double getSigma() const;
+
+  /**
+   * Return the value below or at which a percentage of the added values falls, from the histogram, so
+   * within about 1.6% of the value.
+   * @param pct The percentage, such as 99.9.
+   * @return The percentile, between min and max, 0 if no values were added.
+   */
+  double getPercentile( double pct ) const;
+
+};
+
 /**
- * Statistics automaton that tracks min, max, average, stddev, an auto-sclaing histogram
+ * Statistics automaton that tracks min, max, average, stddev, a log-linear histogram
  * and the number of samples (values) added.
  */
 struct QtyStats {
 
-  /** The initial (smallest) size of a bucket. */
-  const double initial_bucket = 1.0E-6;
-
   /**
    * Construct and init defaults.
    */
@@ -35,11 +123,8 @@ struct QtyStats {
   /** To track average and stddev. */
   double _C;
 
-  /** The current bucket size of auto-scaloing buckets. */
-  double current_bucket;
-
   /** The histogram. */
-  map<double,size_t> buckets;
+  Histogram histogram;
 
   /** The number of values added. */
   size_t items;
@@ -52,42 +137,58 @@ struct QtyStats {
   void addValue( double d );
 
   /**
-   * Rescale the histogram.
+   * Merge the values added to another QtyStats into this one, as if they were added here.
+   * @param other The QtyStats to merge.
    */
-  void reBucket();
+  void merge( const QtyStats& other );
 
   /**
-   * fill bucket gaps.
+   * Return the histogram coarsened to at most -b buckets, see QtyView.
+   * @return The coarsened histogram.
    */
-  void fillBuckets();
+  HistogramView getHistogram() const { return QtyView( *this ).getHistogram(); }
 
   /**
-   * Return the statistics as a formatted string.
+   * Return the statistics as a formatted string, see QtyView.
    * @param stddev If true, include the standard deviation.
    * @return the formatted string.
    */
-  string asString( bool stddev = false );
+  string asString( bool stddev = false ) const { return QtyView( *this ).asString( stddev ); }
 
+  /**
+   * Return the p50, p90, p99 and p99.9 percentiles as a formatted string, see QtyView.
+   * @return the formatted string.
+   */
+  string percentileString() const { return QtyView( *this ).percentileString(); }
 
   /**
-   * Return a word describing the consistency of the timings. To convince managers who think numbers are also incomprehensible.
-   * Please do not take this too seriously - look at the numbers instead.
+   * Return a word describing the consistency of the timings, see QtyView.
    * @return A juding word.
    */
-  string consistency();
+  string consistency() const { return QtyView( *this ).consistency(); }
 
   /**
    * Return the average (mean) of the added values.
    * @return The average.
    */
-  double getMean() const;
+  double getMean() const { return _M; }
 
   /**
-   * Return the standard deviation in the added values.
+   * Return the standard deviation in the added values, see QtyView.
    * @return The standard deviation.
    */
-  double getSigma() const;
+  double getSigma() const { return QtyView( *this ).getSigma(); }
+
+  /**
+   * Return the percentile of the added values, see QtyView.
+   * @param pct The percentage, such as 99.9.
+   * @return The percentile, between min and max, 0 if no values were added.
+   */
+  double getPercentile( double pct ) const { return QtyView( *this ).getPercentile( pct ); }
 
 };
 
+inline QtyView::QtyView( const QtyStats &stats ) :
+  QtyView( stats.min, stats.max, stats.total, stats._M, stats._C, stats.items, stats.histogram ) {}
+
 #endif
\ No newline at end of file
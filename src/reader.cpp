@@ -0,0 +1,797 @@
+#include "reader.h"
+#include "archive.h"
+#include "fileloader.h"
+#include "mappedfile.h"
+#include "options.h"
+#include "parseplan.h"
+#include "scanner.h"
+#include "taskpool.h"
+#include "timeindex.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+/** Plain files are split into tasks of at least this size. */
+#define MIN_TASK_SIZE 1048576
+
+/** The number of tasks per thread plain files are split into. */
+#define TASKS_PER_THREAD 4
+
+/** The maximum number of threads per hardware thread, -j beyond that only adds overhead. */
+#define THREADS_PER_CORE 4
+
+/** The approximate ratio of text size to archive size, used to size archive tasks. */
+#define ARCHIVE_TASK_RATIO 8
+
+/** The number of blocks circulating between the reading and parsing stages of readStream. */
+#define STREAM_BLOCKS 4
+
+/** The number of probes (and comment or error lines) per ProbeBatch. */
+#define PROBE_BATCH_SIZE 1024
+
+/** The number of ProbeBatches circulating between the parsing and aggregating stages of readStream. */
+#define PROBE_BATCHES 4
+
+/** The pipe buffer size requested for piped input, so that the writer can run ahead of curlstats. */
+#define PIPE_BUFFER_SIZE 1048576
+
+void addProbe( Aggregate &agg, const CURLProbe &curl, uint64_t location ) {
+  if ( !options.inTimeRange( curl.datetime ) ) return;
+  const int day = daysFromCivil( curl.datetime.year, curl.datetime.month, curl.datetime.day );
+  TimeKey tkey = TimeKey( curl.datetime.hour, curl.datetime.minute );        
+  QoS &day_qos = agg.qos_by_date.atDay( day );
+  day_qos.total++;
+  // the time-of-day slots are computed once for all the tables they index
+  const size_t day_slot = timeSlot( tkey, options.day_bucket );
+  const size_t week_slot = timeSlot( tkey, options.weekmap_bucket );
+  QoS &week_qos = agg.weekmap_probestats[curl.datetime.wday].atSlot( week_slot );
+  week_qos.total++;
+  agg.curl_error_map[curl.curl_error]++;
+  if ( curl.curl_error == 0 ) { 
+    agg.http_code_map[curl.http_code]++;
+    if ( curl.http_code >= 400 ) {
+      week_qos.http_errors++;
+      day_qos.http_errors++;
+      agg.http_error_list.add( curl, location );
+    } else {
+      // without timings (see Options::requiredProbeFields), only the probe counts are aggregated
+      if ( options.probe_fields & pfTimings ) {
+        agg.recent_probes.push_front( curl );
+        while ( agg.recent_probes.size() > RECENT_PROBES ) agg.recent_probes.pop_back();
+        if ( curl.total_time >= options.slow_threshold ) {
+          day_qos.slow++;
+          week_qos.slow++;
+          agg.slow_map[curl.dominant_wait_class].addValue( curl.wait_class_durations[curl.dominant_wait_class] );
+          agg.wait_class_map[curl.dominant_wait_class]++;
+          if ( options.hasMode( omSlowTrail ) ) agg.slow_repsonse_list.add( curl, location );
+          agg.globalstats.items_slow++;
+          agg.globalstats.total_slow_time += curl.total_time;
+          if ( options.hasMode( omWeekdayMap ) || options.hasMode( omWeekdaySlowMap ) ) {
+            auto &ref = agg.slow_dow_map[curl.datetime.wday];
+            ref.addValues( curl.wait_class_durations );
+          }
+          if ( options.hasMode( om24hMap ) || options.hasMode( om24hSlowMap ) ) {
+            auto &ref = agg.slow_day_map.atSlot( day_slot );
+            ref.addValues( curl.wait_class_durations );
+          }
+
+          if ( options.hasMode( omDailyTrail ) ) {
+            auto &ref = agg.slow_date_map.atDay( day );
+            ref.addValues( curl.wait_class_durations );
+          }
+
+        }
+        agg.globalstats.total_time += curl.total_time;
+        agg.globalstats.response_stats.addValue( curl.total_time );
+
+        agg.globalstats.wait_class_stats.addValues( curl.wait_class_durations );
+
+        if ( options.hasMode( omDailyTrail ) ) {
+          auto &ref = agg.total_date_map.atDay( day );
+          ref.addValues( curl.wait_class_durations );
+        }
+
+        if ( options.hasMode( om24hMap ) || options.hasMode( om24hSlowMap ) ) {
+          auto &ref = agg.total_day_map.atSlot( day_slot );
+          ref.addValues( curl.wait_class_durations );
+        }
+
+        if ( options.hasMode( omWeekdayMap ) || options.hasMode( omWeekdaySlowMap ) ) {
+          auto &ref = agg.total_dow_map[curl.datetime.wday];
+          ref.addValues( curl.wait_class_durations );
+        }
+        agg.weekmap_qtystats[curl.datetime.wday].atSlot( week_slot ).addValue( curl.total_time );
+      }
+
+      agg.globalstats.size_upload += curl.size_upload;
+      agg.globalstats.size_download += curl.size_download;          
+
+      if ( agg.globalstats.first_time.year == 0 || curl.datetime < agg.globalstats.first_time )
+        agg.globalstats.first_time = curl.datetime;
+      if ( agg.globalstats.last_time.year == 0 ||  curl.datetime > agg.globalstats.last_time )
+        agg.globalstats.last_time = curl.datetime;
+
+      agg.globalstats.timed_probes++;          
+    }
+  } else {
+    day_qos.curl_errors++;
+    week_qos.curl_errors++;
+    agg.curl_error_list.add( curl, location );
+  }
+  agg.globalstats.total_probes++;
+}
+
+void processLine( ProbeSink &sink, string_view line, ParseState &state ) {
+  line = stripCR( line );
+  state.line_number++;
+  if ( !isCommment( line ) ) {
+    state.probe();
+    string_view tokens[PARSE_PLAN_MAX_COLUMNS];
+    size_t count = split( line, tokens, PARSE_PLAN_MAX_COLUMNS, ';' );
+    CURLProbe curl;
+    const ProbeFilter* filter = options.where.empty() ? nullptr : &options.where_filter;
+    size_t json = jsonToken( tokens, count );
+    ParseResult result = json ? parseJSON( curl, tokens, json, line, options.probe_fields, filter )
+                              : state.plan.parse( curl, tokens, count, options.probe_fields, filter );
+    if ( result == prProbe ) sink.probeLine( curl, line );
+    else if ( isParseError( result ) ) sink.error( line, result, state.input, state.line_number );
+  } else {
+    state.comment( line );
+    sink.comment( line );
+  }
+}
+
+void BlockReader::feed( string_view block ) {
+  if ( carry_.size() ) {
+    size_t nl = block.find( '\n' );
+    if ( nl == string_view::npos ) {
+      carry_.append( block );
+      return;
+    }
+    carry_.append( block.substr( 0, nl ) );
+    processLine( sink_, carry_, state_ );
+    carry_.clear();
+    block.remove_prefix( nl + 1 );
+  }
+  size_t last = block.rfind( '\n' );
+  if ( last != string_view::npos ) {
+    read( sink_, block.substr( 0, last + 1 ), state_ );
+    block.remove_prefix( last + 1 );
+  }
+  carry_.assign( block );
+}
+
+void BlockReader::finish() {
+  if ( carry_.size() ) processLine( sink_, carry_, state_ );
+  carry_.clear();
+  state_ = ParseState();
+  state_.input = input_;
+}
+
+/**
+ * Probes parsed by the parsing stage of readStream, with the comment and error lines in between, in
+ * input order.
+ */
+class ProbeBatch : public ProbeSink {
+  public:
+    void probe( const CURLProbe &curl ) override { probes_.push_back( curl ); }
+
+    void comment( string_view line ) override { lines_.push_back( { probes_.size(), prProbe, {}, 0, string( line ) } ); }
+
+    void error( string_view line, ParseResult kind, string_view input, uint64_t number ) override {
+      lines_.push_back( { probes_.size(), kind, string( input ), number, string( line ) } );
+    }
+
+    /** Return true if the batch is to be handed over. */
+    bool full() const { return probes_.size() + lines_.size() >= PROBE_BATCH_SIZE; }
+
+    /** Return true if the batch is empty. */
+    bool empty() const { return probes_.empty() && lines_.empty(); }
+
+    /** Empty the batch, keeping its capacity. */
+    void clear() {
+      probes_.clear();
+      lines_.clear();
+      next_probe_ = 0;
+      next_line_ = 0;
+    }
+
+    /**
+     * Take the next probe, passing the comment and error lines preceding it to a sink.
+     * @param sink The ProbeSink.
+     * @param curl Receives the probe.
+     * @return False if the batch is exhausted, after passing its trailing lines.
+     */
+    bool next( ProbeSink &sink, CURLProbe &curl ) {
+      for ( ; next_line_ < lines_.size() && lines_[next_line_].probes == next_probe_; next_line_++ ) {
+        lines_[next_line_].replay( sink );
+      }
+      if ( next_probe_ == probes_.size() ) return false;
+      curl = probes_[next_probe_++];
+      return true;
+    }
+
+    /**
+     * Pass the batch to a sink in input order.
+     * @param sink The ProbeSink.
+     */
+    void replay( ProbeSink &sink ) const {
+      size_t p = 0;
+      for ( const auto &line : lines_ ) {
+        for ( ; p < line.probes; p++ ) sink.probe( probes_[p] );
+        line.replay( sink );
+      }
+      for ( ; p < probes_.size(); p++ ) sink.probe( probes_[p] );
+    }
+
+  private:
+    /** A comment or malformed line. */
+    struct Line {
+      /** The number of probes preceding the line in the batch. */
+      size_t probes;
+      /** The kind of a malformed line, prProbe for a comment. */
+      ParseResult kind;
+      /** The name of the input of a malformed line, a copy as the batch may outlive the input. */
+      string input;
+      /** The line number of a malformed line. */
+      uint64_t number;
+      /** The line. */
+      string text;
+
+      /** Pass the line to a sink. */
+      void replay( ProbeSink &sink ) const {
+        if ( isParseError( kind ) ) sink.error( text, kind, input, number ); else sink.comment( text );
+      }
+    };
+
+    /** The probes. */
+    vector<CURLProbe> probes_;
+
+    /** The comment and error lines. */
+    vector<Line> lines_;
+
+    /** The next probe taken by next. */
+    size_t next_probe_ = 0;
+
+    /** The next line passed by next. */
+    size_t next_line_ = 0;
+};
+
+/**
+ * Thrown inside the parsing stage when the aggregating stage aborted.
+ */
+struct StageAborted {};
+
+/**
+ * A ProbeSink filling ProbeBatches, handing them over to the aggregating stage when full.
+ */
+class BatchWriter : public ProbeSink {
+  public:
+    BatchWriter( StageQueue<ProbeBatch> &queue ) : queue_(queue) { next(); }
+
+    void probe( const CURLProbe &curl ) override {
+      batch_.probe( curl );
+      if ( batch_.full() ) flush();
+    }
+
+    void comment( string_view line ) override {
+      batch_.comment( line );
+      if ( batch_.full() ) flush();
+    }
+
+    void error( string_view line, ParseResult kind, string_view input, uint64_t number ) override {
+      batch_.error( line, kind, input, number );
+      if ( batch_.full() ) flush();
+    }
+
+    /** Hand over the current batch if it is not empty. */
+    void flush() {
+      if ( batch_.empty() ) return;
+      queue_.putFull( move( batch_ ) );
+      next();
+    }
+
+  private:
+    /** Get a free batch. */
+    void next() {
+      if ( !queue_.getFree( batch_ ) ) throw StageAborted();
+      batch_.clear();
+    }
+
+    /** The queue. */
+    StageQueue<ProbeBatch> &queue_;
+
+    /** The current batch. */
+    ProbeBatch batch_;
+};
+
+/**
+ * The parsing stage of readStream, parses blocks into batches. Decompressed archives are read whole
+ * by readArchive.
+ */
+static void parseBlocks( string_view input, BlockQueue &blocks, StageQueue<ProbeBatch> &batches ) {
+  try {
+    BatchWriter writer( batches );
+    string block;
+    // compressed archives are only recognized by the magic bytes of the decompressed data
+    string head;
+    while ( head.size() < ARCHIVE_MAGIC_SIZE && blocks.getFull( block ) ) {
+      head.append( block );
+      blocks.putFree( move( block ) );
+    }
+    if ( isArchive( head ) ) {
+      while ( blocks.getFull( block ) ) {
+        head.append( block );
+        blocks.putFree( move( block ) );
+      }
+      readArchive( writer, archiveBlocks( head ) );
+    } else {
+      BlockReader reader( writer, input );
+      reader.feed( head );
+      while ( blocks.getFull( block ) ) {
+        reader.feed( block );
+        blocks.putFree( move( block ) );
+      }
+      reader.finish();
+    }
+    writer.flush();
+    batches.close();
+  }
+  catch ( const StageAborted& ) {
+    blocks.abort();
+    batches.close();
+  }
+  catch ( ... ) {
+    blocks.abort();
+    batches.close( current_exception() );
+  }
+}
+
+void readDescriptor( ProbeSink &sink, int fd ) {
+#ifdef F_SETPIPE_SZ
+  // fails harmlessly if fd is not a pipe
+  fcntl( fd, F_SETPIPE_SZ, PIPE_BUFFER_SIZE );
+#endif
+  InputReader in = descriptorReader( fd );
+  char magic[ARCHIVE_MAGIC_SIZE];
+  size_t size = 0;
+  while ( size < sizeof(magic) ) {
+    size_t n = in( magic + size, sizeof(magic) - size );
+    if ( n == 0 ) break;
+    size += n;
+  }
+  string_view head( magic, size );
+  if ( isArchive( head ) ) {
+    string data( head );
+    string buffer( DEFAULT_BLOCK_SIZE, '\0' );
+    while ( size_t n = in( buffer.data(), buffer.size() ) ) data.append( buffer.data(), n );
+    readArchive( sink, archiveBlocks( data ) );
+  } else readStream( sink, "-", detectCompression( head ), head, in );
+}
+
+void readStream( ProbeSink &sink, string_view input, Compression compression, string_view head, const InputReader &rest ) {
+  BlockQueue blocks( STREAM_BLOCKS );
+  StageQueue<ProbeBatch> batches( PROBE_BATCHES );
+  thread reader( decompress, compression, head, std::cref( rest ), std::ref( blocks ) );
+  thread parser( parseBlocks, input, std::ref( blocks ), std::ref( batches ) );
+  try {
+    ProbeBatch batch;
+    while ( batches.getFull( batch ) ) {
+      batch.replay( sink );
+      batches.putFree( move( batch ) );
+    }
+  }
+  catch ( ... ) {
+    batches.abort();
+    parser.join();
+    reader.join();
+    throw;
+  }
+  parser.join();
+  reader.join();
+}
+
+void read( ProbeSink &sink, string_view data, ParseState &state ) {
+  const ProbeFilter* filter = options.where.empty() ? nullptr : &options.where_filter;
+  LineScanner scanner( data );
+  ScannedLine line;
+  while ( scanner.next( line ) ) {
+    state.line_number++;
+    if ( !line.comment ) {
+      state.probe();
+      CURLProbe curl;
+      size_t json = jsonToken( line.fields, line.count );
+      ParseResult result = json ? parseJSON( curl, line.fields, json, line.line, options.probe_fields, filter )
+                                : state.plan.parse( curl, line.fields, line.count, options.probe_fields, filter );
+      if ( result == prProbe ) sink.probeLine( curl, line.line );
+      else if ( isParseError( result ) ) sink.error( line.line, result, state.input, state.line_number );
+    } else {
+      state.comment( line.line );
+      sink.comment( line.line );
+    }
+  }
+}
+
+vector<string_view> splitLines( string_view data, size_t parts ) {
+  vector<string_view> ranges;
+  size_t start = 0;
+  for ( size_t i = 1; i <= parts && start < data.size(); i++ ) {
+    size_t end = data.size();
+    if ( i < parts ) {
+      end = data.find( '\n', max( start, data.size() / parts * i ) );
+      end = ( end == string_view::npos ) ? data.size() : end + 1;
+    }
+    ranges.push_back( data.substr( start, end - start ) );
+    start = end;
+  }
+  return ranges;
+}
+
+/**
+ * Return the part of a plain text file within the --from and --to time range, found by the TimeIndex
+ * if --index was given and by binary search otherwise. Lines with the date and time in another than the
+ * first column are not searched, addProbe filters their probes.
+ * @param file The file.
+ * @param plan The ParsePlan of the file.
+ * @param index The TimeIndex of the file, created if --index was given.
+ * @return The lines within the time range.
+ */
+static string_view selectTimeRange( const MappedFile &file, const ParsePlan &plan, unique_ptr<TimeIndex> &index ) {
+  if ( plan.datetimeColumn() != 0 ) return file.view();
+  if ( options.time_index ) index = make_unique<TimeIndex>( file );
+  if ( !options.hasTimeRange() ) return file.view();
+  if ( index ) return index->slice( options.from_time, options.to_time );
+  return sliceTimeRange( file.view(), options.from_time, options.to_time );
+}
+
+void readFiles( ProbeSink &sink, const vector<string> &paths ) {
+  for ( const auto &path : paths ) {
+    MappedFile file( path );
+    Compression compression = detectCompression( file.view() );
+    if ( isArchive( file.view() ) )
+      readArchive( sink, archiveBlocks( file.view() ) );
+    else if ( compression != Compression::None )
+      readStream( sink, path, compression, file.view() );
+    else {
+      ParseState state = leadingParseState( file.view(), path );
+      unique_ptr<TimeIndex> index;
+      string_view selected = selectTimeRange( file, state.plan, index );
+      // the sink cannot locate the lines, so number them from the start of the file
+      if ( options.reject_file.length() ) state.line_number = count( file.data(), selected.data(), '\n' );
+      read( sink, selected, state );
+    }
+  }
+}
+
+/**
+ * A part of the input parsed by a single task.
+ */
+struct ReadTask {
+  /** True if data are archive blocks. */
+  bool archive;
+  /** The Compression of data. */
+  Compression compression;
+  /** The data. */
+  string_view data;
+  /** The ParseState of plain text data. */
+  ParseState state;
+  /** The TrailRange of plain text data. */
+  TrailRange range;
+};
+
+/**
+ * Return the size of the tasks plain text of split_size bytes is split into.
+ */
+static size_t taskSize( size_t split_size, unsigned threads ) {
+  // a few tasks per thread, so that threads that finish early can steal work
+  return max( static_cast<size_t>( MIN_TASK_SIZE ), split_size / ( static_cast<size_t>( threads ) * TASKS_PER_THREAD ) );
+}
+
+/**
+ * Return the number of threads to use for -j threads, at least 1 and at most THREADS_PER_CORE per
+ * hardware thread.
+ */
+static unsigned usableThreads( unsigned threads ) {
+  const unsigned cores = max( thread::hardware_concurrency(), 1u );
+  return max( min( threads, cores * THREADS_PER_CORE ), 1u );
+}
+
+/**
+ * Run tasks on a TaskPool, each into a private Aggregate, and merge the results into agg in order.
+ */
+static void runTasks( Aggregate &agg, const vector<ReadTask> &tasks, unsigned threads ) {
+  // the first task aggregates directly into agg
+  vector<Aggregate> partials( tasks.size() > 1 ? tasks.size() : 0 );
+  TaskPool pool( threads );
+  pool.run( tasks.size(), [&]( size_t i ) {
+    AggregateSink sink( i ? partials[i] : agg, tasks[i].range );
+    if ( tasks[i].archive )
+      readArchive( sink, tasks[i].data );
+    else if ( tasks[i].compression == Compression::None ) {
+      ParseState state = tasks[i].state;
+      read( sink, tasks[i].data, state );
+    } else
+      readStream( sink, tasks[i].state.input, tasks[i].compression, tasks[i].data );
+  } );
+  for ( size_t i = 1; i < partials.size(); i++ ) agg.merge( partials[i] );
+}
+
+void readText( Aggregate &agg, string_view data, const ParseState &state, unsigned threads,
+               const TrailRange &range ) {
+  threads = usableThreads( threads );
+  vector<ReadTask> tasks;
+  size_t parts = threads > 1 ? data.size() / taskSize( data.size(), threads ) + 1 : 1;
+  for ( auto part : splitLines( data, parts ) ) tasks.push_back( { false, Compression::None, part, state, range } );
+  runTasks( agg, tasks, threads );
+}
+
+void readFiles( Aggregate &agg, const vector<string> &paths, unsigned threads ) {
+  threads = usableThreads( threads );
+  vector<shared_ptr<MappedFile>> files;
+  vector<unique_ptr<TimeIndex>> indexes( paths.size() );
+  vector<string_view> selected( paths.size() );
+  vector<ParseState> states( paths.size() );
+  vector<TrailRange> ranges( paths.size() );
+  size_t split_size = 0;
+  for ( size_t i = 0; i < paths.size(); i++ ) {
+    files.push_back( make_shared<MappedFile>( paths[i] ) );
+    selected[i] = files[i]->view();
+    if ( detectCompression( files[i]->view() ) == Compression::None ) {
+      if ( !isArchive( files[i]->view() ) ) {
+        states[i] = leadingParseState( files[i]->view(), paths[i] );
+        selected[i] = selectTimeRange( *files[i], states[i].plan, indexes[i] );
+        // the trails refer into plain text files, which therefore stay mapped
+        ranges[i] = { addTrailSource( files[i], states[i].plan ), files[i]->view() };
+      }
+      split_size += selected[i].size();
+    }
+  }
+  size_t task_size = taskSize( split_size, threads );
+  vector<ReadTask> tasks;
+  for ( size_t i = 0; i < files.size(); i++ ) {
+    Compression compression = detectCompression( files[i]->view() );
+    if ( isArchive( files[i]->view() ) ) {
+      string_view blocks = archiveBlocks( files[i]->view() );
+      // archives are more compact than text, so split them in proportionally smaller tasks
+      for ( auto range : splitArchive( blocks, threads > 1 ? task_size / ARCHIVE_TASK_RATIO : blocks.size() ) )
+        tasks.push_back( { true, compression, range, ParseState() } );
+    } else if ( compression != Compression::None ) {
+      ParseState state;
+      state.input = paths[i];
+      tasks.push_back( { false, compression, files[i]->view(), state } );
+    } else if ( threads > 1 ) {
+      size_t parts = selected[i].size() / task_size + 1;
+      for ( auto range : indexes[i] ? indexes[i]->split( selected[i], parts ) : splitLines( selected[i], parts ) )
+        tasks.push_back( { false, compression, range, states[i], ranges[i] } );
+    } else if ( selected[i].size() ) {
+      tasks.push_back( { false, compression, selected[i], states[i], ranges[i] } );
+    }
+  }
+  runTasks( agg, tasks, threads );
+}
+
+/**
+ * Read a whole file loaded into memory, as readFiles does a mapped file. As the loaded data is released
+ * once parsed, the probes of the trails are copied rather than located in the file, which is not mapped,
+ * so that the trails hold what was loaded (also with --direct) even if the file changes after.
+ */
+static void readLoaded( Aggregate &agg, const string &path, string_view data ) {
+  Compression compression = detectCompression( data );
+  if ( isArchive( data ) ) {
+    AggregateSink sink( agg );
+    readArchive( sink, archiveBlocks( data ) );
+  } else if ( compression != Compression::None ) {
+    AggregateSink sink( agg );
+    readStream( sink, path, compression, data );
+  } else {
+    ParseState state = leadingParseState( data, path );
+    AggregateSink sink( agg );
+    string_view selected = data;
+    if ( state.plan.datetimeColumn() == 0 && options.hasTimeRange() )
+      selected = sliceTimeRange( data, options.from_time, options.to_time );
+    if ( options.reject_file.length() ) state.line_number = count( data.data(), selected.data(), '\n' );
+    read( sink, selected, state );
+  }
+}
+
+void readLoadedFiles( Aggregate &agg, const vector<string> &paths, unsigned threads ) {
+  threads = usableThreads( threads );
+  FileLoader loader( paths, options.input_engine == Options::InputEngine::Uring, options.direct_io );
+  // the first file aggregates directly into agg
+  vector<unique_ptr<Aggregate>> partials( paths.size() );
+  vector<bool> done( paths.size() );
+  size_t merged = 0;
+  atomic<size_t> next( 0 );
+  mutex lock;
+  exception_ptr error;
+  auto work = [&]() {
+    for ( size_t i = next++; i < paths.size(); i = next++ ) {
+      try {
+        string_view data;
+        if ( !loader.take( i, data ) ) return;
+        if ( i ) partials[i] = make_unique<Aggregate>();
+        readLoaded( i ? *partials[i] : agg, paths[i], data );
+        loader.release( i );
+        lock_guard<mutex> guard( lock );
+        done[i] = true;
+        for ( ; merged < paths.size() && done[merged]; merged++ ) {
+          if ( merged ) agg.merge( *partials[merged] );
+          partials[merged].reset();
+        }
+      }
+      catch ( ... ) {
+        lock_guard<mutex> guard( lock );
+        if ( !error ) error = current_exception();
+        loader.abort();
+        return;
+      }
+    }
+  };
+  vector<thread> pool;
+  for ( unsigned t = 1; t < min( static_cast<size_t>( threads ), paths.size() ); t++ ) pool.push_back( thread( work ) );
+  work();
+  for ( auto &t : pool ) t.join();
+  if ( error ) rethrow_exception( error );
+}
+
+/**
+ * An input of mergeFiles, read on its own thread into a bounded queue of ProbeBatches.
+ */
+class MergeInput {
+  public:
+    /**
+     * Start reading a file.
+     * @param path The path of the file.
+     */
+    MergeInput( const string &path ) : path_(path), batches_(PROBE_BATCHES), unordered_(false) {
+      reader_ = thread( [this]() {
+        try {
+          BatchWriter writer( batches_ );
+          readFiles( writer, { path_ } );
+          writer.flush();
+          batches_.close();
+        }
+        catch ( const StageAborted& ) {
+          batches_.close();
+        }
+        catch ( ... ) {
+          batches_.close( current_exception() );
+        }
+      } );
+    }
+
+    ~MergeInput() {
+      batches_.abort();
+      // drain, so that a reader waiting for a free batch sees the abort
+      ProbeBatch batch;
+      try {
+        while ( batches_.getFull( batch ) ) batches_.putFree( move( batch ) );
+      }
+      catch ( ... ) {
+      }
+      reader_.join();
+    }
+
+    /**
+     * Take the next probe into head(), passing the comment and error lines preceding it to a sink.
+     * @param sink The ProbeSink.
+     * @return False at the end of the input.
+     */
+    bool advance( ProbeSink &sink ) {
+      DateTime previous = head_.datetime;
+      bool had_head = started_;
+      for (;;) {
+        if ( started_ && batch_.next( sink, head_ ) ) break;
+        if ( started_ ) batches_.putFree( move( batch_ ) );
+        if ( !batches_.getFull( batch_ ) ) return false;
+        started_ = true;
+      }
+      if ( had_head && head_.datetime < previous && !unordered_ ) {
+        cerr << "'" << path_ << "' is not in time order at " << head_.datetime.asString() << ", merge may be out of order" << endl;
+        unordered_ = true;
+      }
+      return true;
+    }
+
+    /** The current probe. */
+    const CURLProbe& head() const { return head_; }
+
+  private:
+    /** The path of the file. */
+    string path_;
+
+    /** The batches read. */
+    StageQueue<ProbeBatch> batches_;
+
+    /** The batch being merged. */
+    ProbeBatch batch_;
+
+    /** True once batch_ holds a batch. */
+    bool started_ = false;
+
+    /** The current probe. */
+    CURLProbe head_;
+
+    /** True once the input was found out of time order. */
+    bool unordered_;
+
+    /** The reading thread. */
+    thread reader_;
+};
+
+/**
+ * Return a key ordering DateTimes as DateTime::operator< does, cheaper to compare.
+ */
+static inline uint64_t mergeKey( const DateTime &dt ) {
+  return ( ( ( ( static_cast<uint64_t>( dt.year ) * 16 + dt.month ) * 32 + dt.day ) * 32 + dt.hour ) * 64 + dt.minute ) * 64 + dt.second;
+}
+
+/**
+ * Hashes a CURLProbe over all its fields.
+ */
+struct ProbeHash {
+  size_t operator()( const CURLProbe &c ) const {
+    uint64_t fields[] = { mergeKey( c.datetime ), c.curl_error, c.http_code, c.http_connect, c.ssl_verify_result,
+                          c.size_upload, c.size_download, 0, 0, 0, 0, 0, 0, 0 };
+    double timings[] = { c.total_time, c.time_namelookup, c.time_connect, c.time_appconnect, c.time_pretransfer,
+                         c.time_redirect, c.time_starttransfer };
+    memcpy( fields + 7, timings, sizeof(timings) );
+    return hashFNV1a( string_view( reinterpret_cast<const char*>( fields ), sizeof(fields) ) );
+  }
+};
+
+/**
+ * Compares CURLProbes over all their fields.
+ */
+struct ProbeEqual {
+  bool operator()( const CURLProbe &a, const CURLProbe &b ) const {
+    return a.datetime == b.datetime && a.curl_error == b.curl_error && a.http_code == b.http_code &&
+           a.http_connect == b.http_connect && a.ssl_verify_result == b.ssl_verify_result &&
+           a.size_upload == b.size_upload && a.size_download == b.size_download &&
+           a.total_time == b.total_time && a.time_namelookup == b.time_namelookup &&
+           a.time_connect == b.time_connect && a.time_appconnect == b.time_appconnect &&
+           a.time_pretransfer == b.time_pretransfer && a.time_redirect == b.time_redirect &&
+           a.time_starttransfer == b.time_starttransfer;
+  }
+};
+
+size_t mergeFiles( ProbeSink &sink, const vector<string> &paths ) {
+  vector<unique_ptr<MergeInput>> inputs;
+  for ( const auto &path : paths ) inputs.push_back( make_unique<MergeInput>( path ) );
+  // a min-heap of ( mergeKey, input ), ties are taken in the order of the inputs
+  typedef pair<uint64_t,size_t> HeapEntry;
+  vector<HeapEntry> heap;
+  auto later = []( const HeapEntry &a, const HeapEntry &b ) { return a > b; };
+  for ( size_t i = 0; i < inputs.size(); i++ ) {
+    if ( inputs[i]->advance( sink ) ) heap.push_back( { mergeKey( inputs[i]->head().datetime ), i } );
+  }
+  make_heap( heap.begin(), heap.end(), later );
+  // duplicates have the same timestamp, so only the probes of the current timestamp are kept
+  unordered_set<CURLProbe,ProbeHash,ProbeEqual> window;
+  uint64_t window_key = 0;
+  size_t duplicates = 0;
+  while ( heap.size() ) {
+    pop_heap( heap.begin(), heap.end(), later );
+    auto [key, i] = heap.back();
+    heap.pop_back();
+    if ( key != window_key ) {
+      window.clear();
+      window_key = key;
+    }
+    if ( window.insert( inputs[i]->head() ).second ) sink.probe( inputs[i]->head() ); else duplicates++;
+    if ( inputs[i]->advance( sink ) ) {
+      heap.push_back( { mergeKey( inputs[i]->head().datetime ), i } );
+      push_heap( heap.begin(), heap.end(), later );
+    }
+  }
+  return duplicates;
+}
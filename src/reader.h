@@ -0,0 +1,198 @@
+#ifndef reader_h
+#define reader_h
+
+#include "decompress.h"
+#include "parseplan.h"
+#include "probesink.h"
+#include "trail.h"
+#include "variables.h"
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Aggregate a parsed probe.
+ * @param agg The Aggregate to add to.
+ * @param curl The probe to add.
+ * @param location The trail location of its line (see TrailRange), TRAIL_NO_LOCATION to copy the probe
+ * into the trails.
+ */
+void addProbe( Aggregate &agg, const CURLProbe &curl, uint64_t location = TRAIL_NO_LOCATION );
+
+/**
+ * A ProbeSink aggregating probes and comments into an Aggregate.
+ */
+class AggregateSink : public ProbeSink {
+  public:
+    /**
+     * Construct an AggregateSink.
+     * @param agg The Aggregate to add to.
+     * @param range The input the lines are read from, if a TrailSource the trails keep their locations.
+     */
+    AggregateSink( Aggregate &agg, const TrailRange &range = TrailRange() ) : agg_(agg), range_(range) {}
+
+    void probe( const CURLProbe &curl ) override { addProbe( agg_, curl ); }
+
+    void probeLine( const CURLProbe &curl, string_view line ) override { addProbe( agg_, curl, range_.locate( line ) ); }
+
+    void comment( string_view line ) override { agg_.comments.addComment( string( line ) ); }
+
+    void error( string_view line, ParseResult kind, string_view input, uint64_t number ) override {
+      agg_.rejects.add( line, kind, input, number, range_.locate( line ) );
+    }
+
+  private:
+    /** The Aggregate to add to. */
+    Aggregate &agg_;
+
+    /** The input the lines are read from. */
+    TrailRange range_;
+};
+
+/**
+ * Parse a single input line.
+ * @param sink The ProbeSink to read into.
+ * @param line The input line, without newline.
+ * @param state The ParseState of the input.
+ */
+void processLine( ProbeSink &sink, string_view line, ParseState &state );
+
+/**
+ * Parses data arriving in arbitrary blocks, such as blocks read from a stream or produced by a decompressor.
+ * Complete lines in a block are parsed in place, a line spanning blocks is carried over to the next block.
+ */
+class BlockReader {
+  public:
+    /**
+     * Construct a BlockReader.
+     * @param sink The ProbeSink to read into.
+     * @param input The name of the input.
+     */
+    BlockReader( ProbeSink &sink, string_view input ) : sink_(sink), input_(input) { state_.input = input; }
+
+    /**
+     * Parse the lines completed by a block.
+     * @param block The next block of data.
+     */
+    void feed( string_view block );
+
+    /**
+     * Parse a last line without terminating newline, if any. Further blocks are parsed as a new input,
+     * which may start with its own header.
+     */
+    void finish();
+
+  private:
+    /** The ProbeSink to read into. */
+    ProbeSink &sink_;
+
+    /** The name of the input. */
+    string_view input_;
+
+    /** An incomplete line carried over from the previous block. */
+    string carry_;
+
+    /** The ParseState of the input. */
+    ParseState state_;
+};
+
+/**
+ * Read and parse data from a file descriptor, typically standard input, which cannot be memory mapped.
+ * gzip and zstd compressed data and archives are detected by their magic bytes.
+ * @param sink The ProbeSink to read into.
+ * @param fd The file descriptor to read from.
+ */
+void readDescriptor( ProbeSink &sink, int fd );
+
+/**
+ * Read and parse data in a pipeline of three stages on separate threads. The first stage reads (and
+ * decompresses) the data into blocks, the second stage splits the blocks into lines and parses them into
+ * batches of probes, and the calling thread hands the batches to the sink. The stages are connected by
+ * lock-free StageQueues, so that reading, parsing and aggregating overlap. Compressed archives are
+ * decompressed whole and read by readArchive.
+ * @param sink The ProbeSink to read into.
+ * @param input The name of the input.
+ * @param compression The Compression of the data.
+ * @param head The first bytes of the data, or all of it.
+ * @param rest Reads the remainder of the data, or empty.
+ */
+void readStream( ProbeSink &sink, string_view input, Compression compression, string_view head,
+                 const InputReader &rest = InputReader() );
+
+/**
+ * Read and parse data from a memory buffer, typically a MappedFile. The buffer is split into lines
+ * and fields by a LineScanner. A last line without a terminating newline is parsed as well.
+ * @param sink The ProbeSink to read into.
+ * @param data The data to parse.
+ * @param state The ParseState, leadingParseState of the whole input if data is a part of it.
+ */
+void read( ProbeSink &sink, string_view data, ParseState &state );
+
+/**
+ * Split data into line aligned ranges of about equal size.
+ * @param data The data to split.
+ * @param parts The number of ranges wanted.
+ * @return At most parts ranges covering data.
+ */
+vector<string_view> splitLines( string_view data, size_t parts );
+
+/**
+ * Read and parse plain text on a work-stealing TaskPool, split into line aligned tasks.
+ * @param agg The Aggregate to add to.
+ * @param data The data to parse.
+ * @param state The ParseState of data, leadingParseState of the whole input if data is a part of it.
+ * @param threads The number of threads to use.
+ * @param range The TrailRange data is in, if any.
+ */
+void readText( Aggregate &agg, string_view data, const ParseState &state, unsigned threads,
+               const TrailRange &range = TrailRange() );
+
+/**
+ * Read files one after the other on the calling thread. Archives are read by readArchive, gzip and zstd
+ * compressed files by readStream, and plain files are memory mapped.
+ * @param sink The ProbeSink to read into.
+ * @param paths The paths of the files.
+ */
+void readFiles( ProbeSink &sink, const vector<string> &paths );
+
+/**
+ * Read and parse files on a work-stealing TaskPool. Plain files and archives are memory mapped and
+ * split into tasks of whole lines or blocks, so that large files are parsed by multiple threads.
+ * gzip and zstd compressed files are a single task each, parsed by readStream. Each task aggregates
+ * into a private Aggregate, the results are merged into agg in the order of the files and of the data
+ * within a file.
+ * @param agg The Aggregate to add to.
+ * @param paths The paths of the files.
+ * @param threads The number of threads to use.
+ */
+void readFiles( Aggregate &agg, const vector<string> &paths, unsigned threads );
+
+/**
+ * Read and parse files loaded by a FileLoader (see --io), which reads ahead with many reads in flight
+ * across files. Threads take the files in order and parse each whole as soon as it is loaded, into a
+ * private Aggregate that is merged into agg once the files before it are, so that a file's memory is
+ * released as soon as it is parsed. The time range of plain files is found by binary search, --index
+ * is not used.
+ * @param agg The Aggregate to add to.
+ * @param paths The paths of the files.
+ * @param threads The number of threads to use.
+ */
+void readLoadedFiles( Aggregate &agg, const vector<string> &paths, unsigned threads );
+
+/**
+ * Merge files that are each in time order into a single stream in time order, dropping duplicate probes,
+ * such as those in overlapping logs. Each file is read on its own thread into a bounded queue, a heap
+ * picks the earliest probe among the files, and a probe equal in all fields to a probe already taken
+ * with the same timestamp is dropped, so memory use does not depend on the size of the files. Comment
+ * and error lines are passed on as they are met.
+ * @param sink The ProbeSink to read into.
+ * @param paths The paths of the files.
+ * @return The number of duplicate probes dropped.
+ */
+size_t mergeFiles( ProbeSink &sink, const vector<string> &paths );
+
+#endif
@@ -0,0 +1,75 @@
+#include "reject.h"
+#include "options.h"
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+RejectLog::RejectLog() : counts_{} {
+}
+
+void RejectLog::add( string_view line, ParseResult kind, string_view input, uint64_t number, uint64_t location ) {
+  counts_[kind - PARSE_ERROR_FIRST]++;
+  if ( options.reject_file.length() ) {
+    if ( location != TRAIL_NO_LOCATION ) number = 0;
+    lines_.push_back( { string( input ), number, location, kind, string( line ) } );
+  }
+}
+
+uint64_t RejectLog::total() const {
+  return accumulate( counts_, counts_ + PARSE_ERROR_KINDS, static_cast<uint64_t>( 0 ) );
+}
+
+string RejectLog::asString() const {
+  stringstream ss;
+  ss << total() << " (";
+  const char* separator = "";
+  for ( int k = PARSE_ERROR_FIRST; k < PARSE_ERROR_FIRST + PARSE_ERROR_KINDS; k++ ) {
+    if ( !counts_[k - PARSE_ERROR_FIRST] ) continue;
+    ss << separator << counts_[k - PARSE_ERROR_FIRST] << " " << parseErrorName( static_cast<ParseResult>( k ) );
+    separator = ", ";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+void RejectLog::merge( const RejectLog &other ) {
+  for ( size_t k = 0; k < PARSE_ERROR_KINDS; k++ ) counts_[k] += other.counts_[k];
+  lines_.insert( lines_.end(), other.lines_.begin(), other.lines_.end() );
+}
+
+void RejectLog::write( const string &path ) const {
+  vector<uint64_t> numbers( lines_.size() );
+  // number the located lines in one pass over each source, in the order of their locations
+  vector<size_t> located;
+  for ( size_t i = 0; i < lines_.size(); i++ ) {
+    if ( lines_[i].location == TRAIL_NO_LOCATION ) numbers[i] = lines_[i].number; else located.push_back( i );
+  }
+  sort( located.begin(), located.end(), [this]( size_t a, size_t b ) { return lines_[a].location < lines_[b].location; } );
+  uint32_t source = TRAIL_NO_SOURCE;
+  string_view data;
+  size_t offset = 0;
+  uint64_t number = 1;
+  for ( auto i : located ) {
+    uint32_t s = static_cast<uint32_t>( lines_[i].location >> TRAIL_OFFSET_BITS );
+    if ( s != source ) {
+      source = s;
+      data = trailSourceFile( source ).view();
+      offset = 0;
+      number = 1;
+    }
+    size_t next = static_cast<size_t>( lines_[i].location & ( ( 1ull << TRAIL_OFFSET_BITS ) - 1 ) );
+    number += std::count( data.data() + offset, data.data() + next, '\n' );
+    offset = next;
+    numbers[i] = number;
+  }
+  ofstream out( path );
+  if ( !out ) throw std::runtime_error( "cannot create '" + path + "'" );
+  for ( size_t i = 0; i < lines_.size(); i++ ) {
+    out << lines_[i].input << ":" << numbers[i] << ": " << parseErrorName( lines_[i].kind ) << ": " << lines_[i].text << "\n";
+  }
+  out.close();
+  if ( !out ) throw std::runtime_error( "error writing '" + path + "'" );
+}
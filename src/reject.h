@@ -0,0 +1,98 @@
+#ifndef reject_h
+#define reject_h
+
+#include "parseplan.h"
+#include "trail.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/**
+ * The malformed lines of the input, counted by kind (see isParseError) and, if --reject was given, kept in
+ * input order to be written to the reject file. Lines read from a TrailSource are numbered when written,
+ * by counting the lines before them in the source, so that parts of a file parsed by different threads need
+ * not know where they start.
+ */
+class RejectLog {
+  public:
+    /**
+     * Construct an empty RejectLog.
+     */
+    RejectLog();
+
+    /**
+     * Add a malformed line.
+     * @param line The line.
+     * @param kind The kind of malformation.
+     * @param input The name of the input.
+     * @param number The line number counted by the reader, ignored if location is known.
+     * @param location The trail location of the line (see TrailRange), TRAIL_NO_LOCATION if unknown.
+     */
+    void add( string_view line, ParseResult kind, string_view input, uint64_t number,
+              uint64_t location = TRAIL_NO_LOCATION );
+
+    /**
+     * Return the number of malformed lines of a kind.
+     * @param kind The kind.
+     * @return The number of lines.
+     */
+    uint64_t count( ParseResult kind ) const { return counts_[kind - PARSE_ERROR_FIRST]; }
+
+    /**
+     * Set the number of malformed lines of a kind, as restored from a state file.
+     * @param kind The kind.
+     * @param count The number of lines.
+     */
+    void setCount( ParseResult kind, uint64_t count ) { counts_[kind - PARSE_ERROR_FIRST] = count; }
+
+    /**
+     * Return the number of malformed lines.
+     * @return The number of lines of all kinds.
+     */
+    uint64_t total() const;
+
+    /**
+     * Return the number of malformed lines and the kinds, such as "3 (2 too few columns, 1 bad timing)".
+     * @return The description.
+     */
+    string asString() const;
+
+    /**
+     * Append the lines of another RejectLog, which follow ours in the input.
+     * @param other The RejectLog to merge.
+     */
+    void merge( const RejectLog &other );
+
+    /**
+     * Write the kept lines as 'input:line number: kind: line', throws a std::runtime_error on failure.
+     * @param path The path of the reject file.
+     */
+    void write( const string &path ) const;
+
+  private:
+    /** A kept line. */
+    struct Line {
+      /** The name of the input. */
+      string input;
+      /** The line number, 0 if to be found from location. */
+      uint64_t number;
+      /** The trail location, TRAIL_NO_LOCATION if number is known. */
+      uint64_t location;
+      /** The kind of malformation. */
+      ParseResult kind;
+      /** The line. */
+      string text;
+    };
+
+    /** The counts by kind. */
+    uint64_t counts_[PARSE_ERROR_KINDS];
+
+    /** The kept lines. */
+    vector<Line> lines_;
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include "scanner.h"
+#include "util.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCANNER_X86
+#endif
+
+/**
+ * A kernel writes the offsets of all '\n' and ';' bytes in data to out and returns their number.
+ * out must have room for size entries.
+ */
+typedef size_t (*IndexKernel)( const char* data, size_t size, uint32_t* out );
+
+/**
+ * A kernel returns the mask of '"' bytes among the 64 bytes at data.
+ */
+typedef uint64_t (*QuoteKernel)( const char* data );
+
+/**
+ * Append the positions of the set bits in mask, offset by base, to out.
+ */
+static inline size_t flushMask( uint64_t mask, uint32_t base, uint32_t* out, size_t n ) {
+  while ( mask ) {
+    out[n++] = base + static_cast<uint32_t>( __builtin_ctzll( mask ) );
+    mask &= mask - 1;
+  }
+  return n;
+}
+
+/**
+ * Index the bytes [from,size) one at a time.
+ */
+static inline size_t indexScalarTail( const char* data, size_t from, size_t size, uint32_t* out, size_t n ) {
+  for ( size_t i = from; i < size; i++ ) {
+    if ( data[i] == '\n' || data[i] == ';' ) out[n++] = static_cast<uint32_t>( i );
+  }
+  return n;
+}
+
+static size_t indexScalar( const char* data, size_t size, uint32_t* out ) {
+  return indexScalarTail( data, 0, size, out, 0 );
+}
+
+static uint64_t quotesScalar( const char* data ) {
+  uint64_t mask = 0;
+  for ( unsigned i = 0; i < 64; i++ ) mask |= static_cast<uint64_t>( data[i] == '"' ) << i;
+  return mask;
+}
+
+#ifdef SCANNER_X86
+
+static size_t indexSSE2( const char* data, size_t size, uint32_t* out ) {
+  const __m128i nl = _mm_set1_epi8( '\n' );
+  const __m128i sc = _mm_set1_epi8( ';' );
+  size_t n = 0;
+  size_t i = 0;
+  for ( ; i + 16 <= size; i += 16 ) {
+    __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + i ) );
+    uint32_t mask = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( v, nl ), _mm_cmpeq_epi8( v, sc ) ) );
+    n = flushMask( mask, static_cast<uint32_t>( i ), out, n );
+  }
+  return indexScalarTail( data, i, size, out, n );
+}
+
+static uint64_t quotesSSE2( const char* data ) {
+  const __m128i q = _mm_set1_epi8( '"' );
+  uint64_t mask = 0;
+  for ( unsigned i = 0; i < 64; i += 16 ) {
+    __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + i ) );
+    mask |= static_cast<uint64_t>( static_cast<uint32_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( v, q ) ) ) ) << i;
+  }
+  return mask;
+}
+
+__attribute__((target("avx2")))
+static size_t indexAVX2( const char* data, size_t size, uint32_t* out ) {
+  const __m256i nl = _mm256_set1_epi8( '\n' );
+  const __m256i sc = _mm256_set1_epi8( ';' );
+  size_t n = 0;
+  size_t i = 0;
+  for ( ; i + 64 <= size; i += 64 ) {
+    __m256i lo = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + i ) );
+    __m256i hi = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + i + 32 ) );
+    uint64_t mlo = static_cast<uint32_t>( _mm256_movemask_epi8(
+      _mm256_or_si256( _mm256_cmpeq_epi8( lo, nl ), _mm256_cmpeq_epi8( lo, sc ) ) ) );
+    uint64_t mhi = static_cast<uint32_t>( _mm256_movemask_epi8(
+      _mm256_or_si256( _mm256_cmpeq_epi8( hi, nl ), _mm256_cmpeq_epi8( hi, sc ) ) ) );
+    n = flushMask( mlo | ( mhi << 32 ), static_cast<uint32_t>( i ), out, n );
+  }
+  return indexScalarTail( data, i, size, out, n );
+}
+
+__attribute__((target("avx2")))
+static uint64_t quotesAVX2( const char* data ) {
+  const __m256i q = _mm256_set1_epi8( '"' );
+  __m256i lo = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data ) );
+  __m256i hi = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + 32 ) );
+  uint64_t mlo = static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( lo, q ) ) );
+  uint64_t mhi = static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( hi, q ) ) );
+  return mlo | ( mhi << 32 );
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t indexAVX512( const char* data, size_t size, uint32_t* out ) {
+  const __m512i nl = _mm512_set1_epi8( '\n' );
+  const __m512i sc = _mm512_set1_epi8( ';' );
+  size_t n = 0;
+  size_t i = 0;
+  for ( ; i + 64 <= size; i += 64 ) {
+    __m512i v = _mm512_loadu_si512( data + i );
+    uint64_t mask = _mm512_cmpeq_epi8_mask( v, nl ) | _mm512_cmpeq_epi8_mask( v, sc );
+    n = flushMask( mask, static_cast<uint32_t>( i ), out, n );
+  }
+  return indexScalarTail( data, i, size, out, n );
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static uint64_t quotesAVX512( const char* data ) {
+  return _mm512_cmpeq_epi8_mask( _mm512_loadu_si512( data ), _mm512_set1_epi8( '"' ) );
+}
+
+#endif
+
+/**
+ * Select the best kernel for the CPU we run on.
+ */
+static IndexKernel selectKernel( const char** name, QuoteKernel *quotes ) {
+#ifdef SCANNER_X86
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx512bw" ) ) {
+    *name = "avx512";
+    *quotes = quotesAVX512;
+    return indexAVX512;
+  }
+  if ( __builtin_cpu_supports( "avx2" ) ) {
+    *name = "avx2";
+    *quotes = quotesAVX2;
+    return indexAVX2;
+  }
+  if ( __builtin_cpu_supports( "sse2" ) ) {
+    *name = "sse2";
+    *quotes = quotesSSE2;
+    return indexSSE2;
+  }
+#endif
+  *name = "scalar";
+  *quotes = quotesScalar;
+  return indexScalar;
+}
+
+/** The name of the selected kernel. */
+static const char* kernel_name = "";
+
+/** The selected quote kernel. */
+static QuoteKernel quote_kernel = quotesScalar;
+
+/** The selected kernel. */
+static const IndexKernel kernel = selectKernel( &kernel_name, &quote_kernel );
+
+uint64_t quoteMask( const char* data ) {
+  return quote_kernel( data );
+}
+
+const char* LineScanner::kernelName() {
+  return kernel_name;
+}
+
+LineScanner::LineScanner( string_view data ) :
+  data_(data),
+  pos_(0),
+  block_start_(0),
+  block_end_(0),
+  index_( SCANNER_BLOCK_SIZE ),
+  index_size_(0),
+  index_pos_(0) {
+}
+
+void LineScanner::fill() {
+  block_start_ = block_end_;
+  block_end_ = min( data_.size(), block_start_ + SCANNER_BLOCK_SIZE );
+  index_size_ = kernel( data_.data() + block_start_, block_end_ - block_start_, index_.data() );
+  index_pos_ = 0;
+}
+
+bool LineScanner::next( ScannedLine &line ) {
+  if ( pos_ >= data_.size() ) return false;
+  const size_t line_start = pos_;
+  size_t field_start = pos_;
+  line.count = 0;
+  line.comment = data_[line_start] == '#' || data_[line_start] == '\n';
+  for (;;) {
+    if ( index_pos_ == index_size_ ) {
+      if ( block_end_ == data_.size() ) break;
+      fill();
+      continue;
+    }
+    size_t offset = block_start_ + index_[index_pos_++];
+    if ( data_[offset] == '\n' ) {
+      // the '\r' of a CRLF terminator is not part of the last field
+      line.line = stripCR( data_.substr( line_start, offset - line_start ) );
+      const size_t line_end = line_start + line.line.size();
+      if ( !line.comment && field_start < line_end ) {
+        if ( line.count < SCANNER_MAX_FIELDS ) line.fields[line.count] = data_.substr( field_start, line_end - field_start );
+        line.count++;
+      }
+      pos_ = offset + 1;
+      return true;
+    } else if ( !line.comment ) {
+      if ( line.count < SCANNER_MAX_FIELDS ) line.fields[line.count] = data_.substr( field_start, offset - field_start );
+      line.count++;
+      field_start = offset + 1;
+    }
+  }
+  // last line without terminating newline
+  line.line = stripCR( data_.substr( line_start ) );
+  const size_t line_end = line_start + line.line.size();
+  if ( !line.comment && field_start < line_end ) {
+    if ( line.count < SCANNER_MAX_FIELDS ) line.fields[line.count] = data_.substr( field_start, line_end - field_start );
+    line.count++;
+  }
+  pos_ = data_.size();
+  return true;
+}
@@ -0,0 +1,103 @@
+#ifndef scanner_h
+#define scanner_h
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/** The maximum number of fields kept per ScannedLine, further fields are counted but not kept. */
+#define SCANNER_MAX_FIELDS 32
+
+/** The number of bytes indexed per block. */
+#define SCANNER_BLOCK_SIZE 65536
+
+/**
+ * Return the mask of '"' bytes among 64 bytes, using the vector extension selected for the LineScanner.
+ * @param data The bytes, 64 must be readable.
+ * @return The mask, bit i set if data[i] is '"'.
+ */
+uint64_t quoteMask( const char* data );
+
+/**
+ * A line found by the LineScanner.
+ */
+struct ScannedLine {
+  /** The line, without line terminator (LF or CRLF). */
+  string_view line;
+
+  /** True if the line is a comment (or empty), fields are not filled for comments. */
+  bool comment;
+
+  /** The number of ';' separated fields, which may be larger than SCANNER_MAX_FIELDS. */
+  size_t count;
+
+  /** The first SCANNER_MAX_FIELDS fields. */
+  string_view fields[SCANNER_MAX_FIELDS];
+};
+
+/**
+ * Splits a buffer into lines and ';' separated fields. The buffer is indexed in blocks by a vectorized
+ * kernel (AVX-512, AVX2, SSE2 or scalar, selected at runtime) that records the offsets of all '\n' and ';'
+ * bytes, lines and fields are then assembled from that index without scanning the bytes again. Fields are
+ * split the same way as split() does.
+ * @code
+ * LineScanner scanner( data );
+ * ScannedLine line;
+ * while ( scanner.next( line ) ) {
+ *   ...
+ * }
+ * @endcode
+ */
+class LineScanner {
+  public:
+
+    /**
+     * Construct a LineScanner on a buffer, which must outlive the scanner.
+     * @param data The data to scan.
+     */
+    LineScanner( string_view data );
+
+    /**
+     * Get the next line. A last line without terminating newline is returned as well.
+     * @param line Receives the line.
+     * @return False if there are no more lines.
+     */
+    bool next( ScannedLine &line );
+
+    /**
+     * Return the name of the kernel selected for this CPU.
+     * @return The kernel name.
+     */
+    static const char* kernelName();
+
+  private:
+    /**
+     * Index the next block.
+     */
+    void fill();
+
+    /** The data to scan. */
+    string_view data_;
+
+    /** The offset of the first unconsumed byte. */
+    size_t pos_;
+
+    /** The offset of the indexed block. */
+    size_t block_start_;
+
+    /** The offset just past the indexed block. */
+    size_t block_end_;
+
+    /** Offsets relative to block_start_ of '\n' and ';' in the block. */
+    vector<uint32_t> index_;
+
+    /** The number of valid entries in index_. */
+    size_t index_size_;
+
+    /** The next entry in index_ to consume. */
+    size_t index_pos_;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef slotmap_h
+#define slotmap_h
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A map over a small, fixed key space, such as the weekdays or the HTTP codes, kept as a contiguous
+ * array of values indexed by a slot computed from the key by Slots, such as
+ * @code
+ * struct WeekdaySlots {
+ *   static size_t slot( int wday ) { return wday; }
+ *   static int key( size_t slot ) { return slot; }
+ * };
+ * @endcode
+ * The array grows to the highest slot used. Iterating visits the slots in use in slot order, which must
+ * be the key order, yielding entries with a first (the key) and a second (the value) as a map does.
+ */
+template <typename K, typename V, typename Slots> class SlotMap {
+  public:
+    typedef K key_type;
+    typedef V mapped_type;
+
+    /**
+     * A slot in use as yielded by iterating.
+     */
+    struct Entry {
+      /** The key. */
+      K first;
+      /** The value. */
+      const V &second;
+    };
+
+    /**
+     * Iterates the slots in use.
+     */
+    class const_iterator {
+      public:
+        typedef forward_iterator_tag iterator_category;
+        typedef Entry value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const Entry* pointer;
+        typedef Entry reference;
+
+        const_iterator( const SlotMap* map, size_t slot ) : map_(map), slot_(slot) { skip(); }
+        Entry operator*() const { return Entry{ Slots::key( slot_ ), map_->values_[slot_] }; }
+        const_iterator& operator++() { slot_++; skip(); return *this; }
+        bool operator==( const const_iterator &other ) const { return slot_ == other.slot_; }
+        bool operator!=( const const_iterator &other ) const { return slot_ != other.slot_; }
+
+      private:
+        /** Advance to the next slot in use. */
+        void skip() { while ( slot_ < map_->used_.size() && !map_->used_[slot_] ) slot_++; }
+        /** The map. */
+        const SlotMap* map_;
+        /** The slot. */
+        size_t slot_;
+    };
+
+    /**
+     * Return the value of a key, which is default constructed if the key is not in use.
+     * @param key The key.
+     * @return The value.
+     */
+    V& operator[]( const K &key ) { return atSlot( Slots::slot( key ) ); }
+
+    /**
+     * Return the value of a slot, which is default constructed if the slot is not in use, for callers
+     * that compute the slot of a key once for several lookups.
+     * @param slot The slot.
+     * @return The value.
+     */
+    V& atSlot( size_t slot ) {
+      if ( slot >= values_.size() ) {
+        values_.resize( slot + 1 );
+        used_.resize( slot + 1, 0 );
+      }
+      if ( !used_[slot] ) {
+        used_[slot] = 1;
+        size_++;
+      }
+      return values_[slot];
+    }
+
+    /**
+     * Return the value of a key without putting the key in use.
+     * @param key The key.
+     * @return The value, nullptr if the key is not in use.
+     */
+    const V* get( const K &key ) const {
+      size_t slot = Slots::slot( key );
+      return slot < used_.size() && used_[slot] ? &values_[slot] : nullptr;
+    }
+
+    /**
+     * Return the number of keys in use.
+     * @return The number of keys.
+     */
+    size_t size() const { return size_; }
+
+    /**
+     * Return true if no key is in use.
+     * @return True if empty.
+     */
+    bool empty() const { return size_ == 0; }
+
+    const_iterator begin() const { return const_iterator( this, 0 ); }
+    const_iterator end() const { return const_iterator( this, used_.size() ); }
+
+  private:
+    /** The values by slot. */
+    vector<V> values_;
+
+    /** Non zero for the slots in use. */
+    vector<uint8_t> used_;
+
+    /** The number of slots in use. */
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef spscring_h
+#define spscring_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/** The size of a cache line, to keep the producer and consumer sides of a ring apart. */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * A bounded lock-free queue between exactly one producer thread and one consumer thread. The head
+ * and tail indexes live on separate cache lines, and each side caches the other side's index so that
+ * it only reads the shared index when the ring looks full (or empty).
+ * @code
+ * SPSCRing<string> ring( 4 );
+ * // producer                         // consumer
+ * ring.tryPush( move( s ) );          if ( ring.tryPop( s ) ) ...
+ * @endcode
+ */
+template <typename T> class SPSCRing {
+  public:
+    /**
+     * Construct an SPSCRing.
+     * @param capacity The minimum number of elements the ring holds, rounded up to a power of 2.
+     */
+    SPSCRing( size_t capacity ) : head_(0), tail_cache_(0), tail_(0), head_cache_(0) {
+      size_t size = 1;
+      while ( size < capacity ) size <<= 1;
+      slots_.resize( size );
+      mask_ = size - 1;
+    }
+
+    /**
+     * Producer: append a value.
+     * @param value The value, moved from if appended.
+     * @return False if the ring is full.
+     */
+    bool tryPush( T &&value ) {
+      size_t tail = tail_.load( memory_order_relaxed );
+      if ( tail - head_cache_ == slots_.size() ) {
+        head_cache_ = head_.load( memory_order_acquire );
+        if ( tail - head_cache_ == slots_.size() ) return false;
+      }
+      slots_[tail & mask_] = move( value );
+      tail_.store( tail + 1, memory_order_release );
+      return true;
+    }
+
+    /**
+     * Consumer: take the oldest value.
+     * @param value Receives the value.
+     * @return False if the ring is empty.
+     */
+    bool tryPop( T &value ) {
+      size_t head = head_.load( memory_order_relaxed );
+      if ( head == tail_cache_ ) {
+        tail_cache_ = tail_.load( memory_order_acquire );
+        if ( head == tail_cache_ ) return false;
+      }
+      value = move( slots_[head & mask_] );
+      head_.store( head + 1, memory_order_release );
+      return true;
+    }
+
+  private:
+    /** The slots. */
+    vector<T> slots_;
+
+    /** The number of slots - 1. */
+    size_t mask_;
+
+    /** The index of the next slot to pop, written by the consumer. */
+    alignas(CACHE_LINE_SIZE) atomic<size_t> head_;
+
+    /** The consumer's copy of tail_. */
+    size_t tail_cache_;
+
+    /** The index of the next slot to push, written by the producer. */
+    alignas(CACHE_LINE_SIZE) atomic<size_t> tail_;
+
+    /** The producer's copy of head_. */
+    size_t head_cache_;
+};
+
+/**
+ * Waits for the other side of a lock-free queue, first by yielding the CPU and then by sleeping for
+ * increasing intervals, so that an idle pipeline (such as one waiting on a slow pipe) does not spin.
+ */
+class Backoff {
+  public:
+    Backoff() : rounds_(0) {}
+
+    /**
+     * Wait a little.
+     */
+    void wait() {
+      if ( rounds_ < 64 ) this_thread::yield();
+      else this_thread::sleep_for( chrono::microseconds( 10 << min( rounds_ - 64, 6u ) ) );
+      rounds_++;
+    }
+
+  private:
+    /** The number of waits so far. */
+    unsigned rounds_;
+};
+
+/**
+ * Circulates a fixed number of buffers between a producer stage and a consumer stage over two
+ * SPSCRings, one returning free buffers to the producer and one passing filled buffers to the consumer.
+ * As the number of buffers is fixed, neither ring can overflow. The producer closes the queue when done,
+ * passing an error if it failed; the consumer aborts the queue to stop the producer.
+ * @code
+ * // producer                         // consumer
+ * T buffer;                           T buffer;
+ * while ( queue.getFree( buffer ) ) { while ( queue.getFull( buffer ) ) {
+ *   ... fill buffer                     ... use buffer
+ *   queue.putFull( move( buffer ) );    queue.putFree( move( buffer ) );
+ * }                                   }
+ * queue.close();
+ * @endcode
+ */
+template <typename T> class StageQueue {
+  public:
+    /**
+     * Construct a StageQueue.
+     * @param buffers The number of buffers circulating.
+     */
+    StageQueue( size_t buffers ) : free_(buffers), full_(buffers), closed_(false), aborted_(false), error_(nullptr) {
+      for ( size_t i = 0; i < buffers; i++ ) free_.tryPush( T() );
+    }
+
+    /**
+     * Producer: wait for a free buffer.
+     * @param buffer Receives the free buffer.
+     * @return False if the consumer aborted, the producer should stop.
+     */
+    bool getFree( T &buffer ) {
+      Backoff backoff;
+      for (;;) {
+        if ( aborted_.load( memory_order_acquire ) ) return false;
+        if ( free_.tryPop( buffer ) ) return true;
+        backoff.wait();
+      }
+    }
+
+    /**
+     * Producer: hand over a filled buffer.
+     * @param buffer The filled buffer.
+     */
+    void putFull( T &&buffer ) { full_.tryPush( move( buffer ) ); }
+
+    /**
+     * Producer: signal the end of the data, or an error.
+     * @param error If set, rethrown to the consumer from getFull.
+     */
+    void close( exception_ptr error = nullptr ) {
+      error_ = error;
+      closed_.store( true, memory_order_release );
+    }
+
+    /**
+     * Consumer: wait for the next filled buffer.
+     * @param buffer Receives the buffer.
+     * @return False if the producer closed the queue and all buffers were consumed.
+     */
+    bool getFull( T &buffer ) {
+      Backoff backoff;
+      for (;;) {
+        if ( full_.tryPop( buffer ) ) return true;
+        if ( closed_.load( memory_order_acquire ) ) {
+          // the producer may have handed over a last buffer before closing
+          if ( full_.tryPop( buffer ) ) return true;
+          if ( error_ ) rethrow_exception( error_ );
+          return false;
+        }
+        backoff.wait();
+      }
+    }
+
+    /**
+     * Consumer: return a buffer for reuse.
+     * @param buffer The buffer to return.
+     */
+    void putFree( T &&buffer ) { free_.tryPush( move( buffer ) ); }
+
+    /**
+     * Consumer: stop the producer.
+     */
+    void abort() { aborted_.store( true, memory_order_release ); }
+
+  private:
+    /** Buffers available to the producer. */
+    SPSCRing<T> free_;
+
+    /** Buffers available to the consumer. */
+    SPSCRing<T> full_;
+
+    /** True if the producer is done, publishes error_. */
+    atomic<bool> closed_;
+
+    /** True if the consumer aborted. */
+    atomic<bool> aborted_;
+
+    /** The error raised by the producer. */
+    exception_ptr error_;
+};
+
+#endif
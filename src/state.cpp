@@ -0,0 +1,634 @@
+#include "state.h"
+#include "archive.h"
+#include "mappedfile.h"
+#include "options.h"
+#include "reader.h"
+#include "util.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <type_traits>
+
+/** Written to the header to detect a state file from a host with different byte order. */
+#define STATE_BYTE_ORDER 0x01020304
+
+/**
+ * The sections of a state file.
+ */
+enum StateSectionId : uint32_t {
+  ssFingerprint = 1,  /**< The InputFingerprint. */
+  ssOptions,          /**< The StateOptions. */
+  ssGlobal,           /**< The StateGlobal. */
+  ssQtyStats,         /**< All QtyStats as StateQtyStats. */
+  ssBuckets,          /**< All QtyStats histogram buckets as StateBucket. */
+  ssSlowMap,          /**< slow_map as StateEntry. */
+  ssSlowDowMap,       /**< slow_dow_map as StateEntry. */
+  ssTotalDowMap,      /**< total_dow_map as StateEntry. */
+  ssSlowDayMap,       /**< slow_day_map as StateEntry. */
+  ssTotalDayMap,      /**< total_day_map as StateEntry. */
+  ssTotalDateMap,     /**< total_date_map as StateEntry. */
+  ssSlowDateMap,      /**< slow_date_map as StateEntry. */
+  ssCurlErrorMap,     /**< curl_error_map as StateEntry. */
+  ssHTTPCodeMap,      /**< http_code_map as StateEntry. */
+  ssWaitClassMap,     /**< wait_class_map as StateEntry. */
+  ssWeekmapQtyStats,  /**< weekmap_qtystats as StateEntry. */
+  ssQoSByDate,        /**< qos_by_date as StateEntry. */
+  ssWeekmapQoS,       /**< weekmap_probestats as StateEntry. */
+  ssCurlErrorList,    /**< curl_error_list as StateProbe. */
+  ssHTTPErrorList,    /**< http_error_list as StateProbe. */
+  ssSlowList,         /**< slow_repsonse_list as StateProbe. */
+  ssRecentProbes,     /**< recent_probes as StateProbe. */
+  ssParseErrors,      /**< The RejectLog counts as StateEntry. */
+  ssComments,         /**< Comments as StateString, see saveState. */
+  ssStrings           /**< The characters of all StateString. */
+};
+
+/**
+ * The state file header, followed by the section table.
+ */
+struct StateHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t sections;
+  uint32_t reserved;
+};
+
+/**
+ * An entry in the section table.
+ */
+struct StateSection {
+  uint32_t id;
+  uint32_t record_size;
+  uint64_t offset;
+  uint64_t count;
+};
+
+/**
+ * The options that affect aggregation.
+ */
+struct StateOptions {
+  double   slow_threshold;
+  int32_t  day_bucket;
+  int32_t  weekmap_bucket;
+  uint64_t output_mode;
+  uint64_t where_hash;
+};
+
+/**
+ * A DateTime.
+ */
+struct StateDateTime {
+  int32_t year, month, day, hour, minute, second, wday, reserved;
+};
+
+/**
+ * GlobalStats, referring to its QtyStats by index.
+ */
+struct StateGlobal {
+  uint64_t timed_probes;
+  uint64_t total_probes;
+  uint64_t items_slow;
+  uint64_t size_upload;
+  uint64_t size_download;
+  double   total_time;
+  double   total_slow_time;
+  uint64_t response_stats;
+  uint64_t wait_class_stats;
+  StateDateTime first_time;
+  StateDateTime last_time;
+};
+
+/**
+ * QtyStats, referring to its histogram buckets by index.
+ */
+struct StateQtyStats {
+  double   min, max, total, M, C;
+  uint64_t items;
+  uint64_t bucket_first;
+  uint64_t bucket_count;
+};
+
+/**
+ * A QtyStats histogram bucket.
+ */
+struct StateBucket {
+  int64_t  index;
+  uint64_t count;
+};
+
+/**
+ * A map entry. The meaning of key and value depends on the section, a QtyStats value is its record
+ * index, a ProbeStats value the index of the first of its seven QtyStats.
+ */
+struct StateEntry {
+  int32_t  key[4];
+  uint64_t value[4];
+};
+
+/**
+ * A CURLProbe.
+ */
+struct StateProbe {
+  StateDateTime datetime;
+  double   timings[7];
+  uint64_t size_upload;
+  uint64_t size_download;
+  uint32_t curl_error;
+  uint32_t http_code;
+  uint32_t http_connect;
+  uint32_t ssl_verify_result;
+};
+
+/**
+ * A string in the ssStrings section.
+ */
+struct StateString {
+  uint64_t offset;
+  uint64_t length;
+};
+
+/**
+ * Builds the sections of a state file.
+ */
+class StateBuilder {
+  public:
+    /**
+     * Append a record to a section.
+     */
+    template <typename T> void add( StateSectionId id, const T &record ) {
+      static_assert( is_trivially_copyable<T>::value, "state records must be trivially copyable" );
+      auto &section = sections_[id];
+      section.first = sizeof(T);
+      section.second.append( reinterpret_cast<const char*>( &record ), sizeof(T) );
+    }
+
+    /**
+     * Return the number of records in a section.
+     */
+    size_t count( StateSectionId id ) const {
+      auto section = sections_.find( id );
+      return section == sections_.end() ? 0 : section->second.second.size() / section->second.first;
+    }
+
+    /**
+     * Add a QtyStats, or a lane of a ProbeStats, and its buckets, return its index.
+     */
+    uint64_t addQtyStats( const QtyView &q ) {
+      StateQtyStats r = { q.min, q.max, q.total, q._M, q._C, q.items, count( ssBuckets ), 0 };
+      q.histogram.forEachBucket( [&]( int64_t index, uint64_t n ) {
+        add( ssBuckets, StateBucket{ index, n } );
+        r.bucket_count++;
+      } );
+      uint64_t index = count( ssQtyStats );
+      add( ssQtyStats, r );
+      return index;
+    }
+
+    /**
+     * Add the seven QtyStats of a ProbeStats, return the index of the first.
+     */
+    uint64_t addProbeStats( const ProbeStats &p ) {
+      uint64_t index = addQtyStats( p.get( wcDNS ) );
+      for ( unsigned lane = wcDNS + 1; lane <= PROBE_LANE; lane++ ) addQtyStats( p.get( lane ) );
+      return index;
+    }
+
+    /**
+     * Add a string to ssComments.
+     */
+    void addString( const string &s ) {
+      auto &strings = sections_[ssStrings];
+      strings.first = 1;
+      add( ssComments, StateString{ strings.second.size(), s.size() } );
+      strings.second.append( s );
+    }
+
+    /**
+     * Write the state file.
+     */
+    void write( ostream &out ) {
+      StateHeader header = {};
+      memcpy( header.magic, STATE_MAGIC, sizeof(STATE_MAGIC) );
+      header.version = STATE_VERSION;
+      header.byte_order = STATE_BYTE_ORDER;
+      header.sections = static_cast<uint32_t>( sections_.size() );
+      uint64_t offset = sizeof(StateHeader) + sections_.size() * sizeof(StateSection);
+      out.write( reinterpret_cast<const char*>( &header ), sizeof(header) );
+      for ( const auto &s : sections_ ) {
+        StateSection entry = { s.first, s.second.first, offset, s.second.first ? s.second.second.size() / s.second.first : 0 };
+        out.write( reinterpret_cast<const char*>( &entry ), sizeof(entry) );
+        offset += align( s.second.second.size() );
+      }
+      for ( const auto &s : sections_ ) {
+        out.write( s.second.second.data(), s.second.second.size() );
+        out.write( "\0\0\0\0\0\0\0", align( s.second.second.size() ) - s.second.second.size() );
+      }
+    }
+
+  private:
+    /** Round up to a multiple of 8. */
+    static uint64_t align( uint64_t size ) { return ( size + 7 ) & ~static_cast<uint64_t>( 7 ); }
+
+    /** The sections by id, as record size and records. */
+    map<uint32_t,pair<uint32_t,string>> sections_;
+};
+
+/**
+ * Gives access to the sections of a mapped state file.
+ */
+class StateView {
+  public:
+    /**
+     * Check the header and section table, throws a std::runtime_error if they are invalid.
+     */
+    StateView( string_view data ) : data_(data) {
+      if ( data.size() < sizeof(StateHeader) ) throw std::runtime_error( "state file is truncated" );
+      const StateHeader* header = reinterpret_cast<const StateHeader*>( data.data() );
+      if ( memcmp( header->magic, STATE_MAGIC, sizeof(STATE_MAGIC) ) != 0 ) throw std::runtime_error( "not a curlstats state file" );
+      if ( header->byte_order != STATE_BYTE_ORDER ) throw std::runtime_error( "state file has a different byte order" );
+      version_ = header->version;
+      if ( data.size() < sizeof(StateHeader) + header->sections * sizeof(StateSection) ) throw std::runtime_error( "state file is truncated" );
+      const StateSection* table = reinterpret_cast<const StateSection*>( data.data() + sizeof(StateHeader) );
+      for ( uint32_t i = 0; i < header->sections; i++ ) {
+        if ( table[i].offset % 8 || table[i].offset > data.size() ||
+             table[i].count * table[i].record_size > data.size() - table[i].offset )
+          throw std::runtime_error( "state file is corrupt" );
+        sections_[table[i].id] = &table[i];
+      }
+    }
+
+    /**
+     * Return the STATE_VERSION the state was saved with.
+     */
+    uint32_t version() const { return version_; }
+
+    /**
+     * Return the records of a section, in place, and their number. An absent section is empty.
+     */
+    template <typename T> const T* section( StateSectionId id, size_t &count ) const {
+      auto s = sections_.find( id );
+      count = 0;
+      if ( s == sections_.end() ) return nullptr;
+      if ( s->second->record_size != sizeof(T) ) throw std::runtime_error( "state file section has unexpected record size" );
+      count = s->second->count;
+      return reinterpret_cast<const T*>( data_.data() + s->second->offset );
+    }
+
+    /**
+     * Return the single record of a section, throws if absent.
+     */
+    template <typename T> const T& record( StateSectionId id ) const {
+      size_t count;
+      const T* r = section<T>( id, count );
+      if ( count != 1 ) throw std::runtime_error( "state file is missing a section" );
+      return *r;
+    }
+
+  private:
+    /** The state file. */
+    string_view data_;
+
+    /** The STATE_VERSION of the state file. */
+    uint32_t version_;
+
+    /** The section table entries by id. */
+    map<uint32_t,const StateSection*> sections_;
+};
+
+/**
+ * Restores the structures referring to QtyStats records.
+ */
+class StateLoader {
+  public:
+    StateLoader( const StateView &view ) {
+      qty_ = view.section<StateQtyStats>( ssQtyStats, qty_count_ );
+      buckets_ = view.section<StateBucket>( ssBuckets, bucket_count_ );
+    }
+
+    /** Restore QtyStats index into q. */
+    void getQtyStats( uint64_t index, QtyStats &q ) const {
+      if ( index >= qty_count_ ) throw std::runtime_error( "state file is corrupt" );
+      const StateQtyStats &r = qty_[index];
+      if ( r.bucket_first + r.bucket_count > bucket_count_ ) throw std::runtime_error( "state file is corrupt" );
+      q.min = r.min;
+      q.max = r.max;
+      q.total = r.total;
+      q._M = r.M;
+      q._C = r.C;
+      q.items = r.items;
+      q.histogram = Histogram();
+      for ( uint64_t i = r.bucket_first; i < r.bucket_first + r.bucket_count; i++ )
+        q.histogram.addBucket( buckets_[i].index, buckets_[i].count );
+    }
+
+    /** Restore the ProbeStats starting at QtyStats index into p. */
+    void getProbeStats( uint64_t index, ProbeStats &p ) const {
+      QtyStats q;
+      for ( unsigned lane = wcDNS; lane <= PROBE_LANE; lane++ ) {
+        getQtyStats( index + lane, q );
+        p.set( lane, q );
+        if ( lane == wcDNS ) p.items = q.items;
+      }
+    }
+
+  private:
+    const StateQtyStats* qty_;
+    size_t qty_count_;
+    const StateBucket* buckets_;
+    size_t bucket_count_;
+};
+
+static StateDateTime toState( const DateTime &dt ) {
+  return { dt.year, dt.month, dt.day, dt.hour, dt.minute, dt.second, dt.wday, 0 };
+}
+
+static DateTime fromState( const StateDateTime &s ) {
+  DateTime dt;
+  dt.year = s.year;
+  dt.month = s.month;
+  dt.day = s.day;
+  dt.hour = s.hour;
+  dt.minute = s.minute;
+  dt.second = s.second;
+  dt.wday = s.wday;
+  return dt;
+}
+
+static StateProbe toState( const CURLProbe &c ) {
+  return { toState( c.datetime ),
+           { c.total_time, c.time_namelookup, c.time_connect, c.time_appconnect, c.time_pretransfer, c.time_starttransfer,
+             c.time_redirect },
+           c.size_upload, c.size_download, c.curl_error, c.http_code, c.http_connect, c.ssl_verify_result };
+}
+
+static CURLProbe fromState( const StateProbe &s ) {
+  CURLProbe c;
+  c.datetime = fromState( s.datetime );
+  c.total_time = s.timings[0];
+  c.time_namelookup = s.timings[1];
+  c.time_connect = s.timings[2];
+  c.time_appconnect = s.timings[3];
+  c.time_pretransfer = s.timings[4];
+  c.time_starttransfer = s.timings[5];
+  c.time_redirect = s.timings[6];
+  c.size_upload = s.size_upload;
+  c.size_download = s.size_download;
+  c.curl_error = static_cast<uint16_t>( s.curl_error );
+  c.http_code = static_cast<uint16_t>( s.http_code );
+  c.http_connect = static_cast<uint16_t>( s.http_connect );
+  c.ssl_verify_result = s.ssl_verify_result;
+  c.decompose();
+  return c;
+}
+
+/**
+ * Return a day-of-week key, the keys of the SlotMaps must be in range.
+ */
+static int weekdayKey( int32_t wday ) {
+  if ( wday < 0 || wday > 6 ) throw std::runtime_error( "state file is corrupt" );
+  return wday;
+}
+
+/**
+ * Return a time-of-day key, the keys of the SlotMaps must be in range.
+ */
+static TimeKey timeKey( int32_t hour, int32_t minute ) {
+  if ( hour < 0 || hour > 23 || minute < 0 || minute > 59 ) throw std::runtime_error( "state file is corrupt" );
+  return TimeKey( hour, minute );
+}
+
+/**
+ * Return a date key, the dates index the DayTables so must be in range.
+ */
+static DateKey dateKey( int32_t year, int32_t month, int32_t day ) {
+  if ( year < 0 || year > 9999 || month < 1 || month > 12 || day < 1 || day > 31 ) throw std::runtime_error( "state file is corrupt" );
+  return DateKey( year, month, day );
+}
+
+static StateOptions currentOptions() {
+  return { options.slow_threshold, options.day_bucket, options.weekmap_bucket, static_cast<uint64_t>( options.output_mode ),
+           hashFNV1a( options.where ) };
+}
+
+/**
+ * Save a list of probes or a ProbeTrail, a trail's probes are materialized.
+ */
+template <typename Probes> static void saveProbes( StateBuilder &builder, StateSectionId id, const Probes &probes ) {
+  for ( const auto &p : probes ) builder.add( id, toState( p ) );
+}
+
+static void loadProbes( const StateView &view, StateSectionId id, list<CURLProbe> &probes ) {
+  size_t count;
+  const StateProbe* r = view.section<StateProbe>( id, count );
+  for ( size_t i = 0; i < count; i++ ) probes.push_back( fromState( r[i] ) );
+}
+
+static void loadProbes( const StateView &view, StateSectionId id, ProbeTrail &probes ) {
+  size_t count;
+  const StateProbe* r = view.section<StateProbe>( id, count );
+  for ( size_t i = 0; i < count; i++ ) probes.add( fromState( r[i] ) );
+}
+
+void saveState( const string &path, const Aggregate &agg, const InputFingerprint &fingerprint ) {
+  StateBuilder builder;
+  builder.add( ssFingerprint, fingerprint );
+  builder.add( ssOptions, currentOptions() );
+
+  StateGlobal global = {};
+  global.timed_probes = agg.globalstats.timed_probes;
+  global.total_probes = agg.globalstats.total_probes;
+  global.items_slow = agg.globalstats.items_slow;
+  global.size_upload = agg.globalstats.size_upload;
+  global.size_download = agg.globalstats.size_download;
+  global.total_time = agg.globalstats.total_time;
+  global.total_slow_time = agg.globalstats.total_slow_time;
+  global.response_stats = builder.addQtyStats( agg.globalstats.response_stats );
+  global.wait_class_stats = builder.addProbeStats( agg.globalstats.wait_class_stats );
+  global.first_time = toState( agg.globalstats.first_time );
+  global.last_time = toState( agg.globalstats.last_time );
+  builder.add( ssGlobal, global );
+
+  for ( const auto &e : agg.slow_map ) builder.add( ssSlowMap, StateEntry{ { e.first }, { builder.addQtyStats( e.second ) } } );
+  for ( const auto &e : agg.slow_dow_map ) builder.add( ssSlowDowMap, StateEntry{ { e.first }, { builder.addProbeStats( e.second ) } } );
+  for ( const auto &e : agg.total_dow_map ) builder.add( ssTotalDowMap, StateEntry{ { e.first }, { builder.addProbeStats( e.second ) } } );
+  for ( const auto &e : agg.slow_day_map )
+    builder.add( ssSlowDayMap, StateEntry{ { e.first.hour, e.first.minute }, { builder.addProbeStats( e.second ) } } );
+  for ( const auto &e : agg.total_day_map )
+    builder.add( ssTotalDayMap, StateEntry{ { e.first.hour, e.first.minute }, { builder.addProbeStats( e.second ) } } );
+  for ( const auto &e : agg.total_date_map )
+    builder.add( ssTotalDateMap, StateEntry{ { e.first.year, e.first.month, e.first.day }, { builder.addProbeStats( e.second ) } } );
+  for ( const auto &e : agg.slow_date_map )
+    builder.add( ssSlowDateMap, StateEntry{ { e.first.year, e.first.month, e.first.day }, { builder.addProbeStats( e.second ) } } );
+  for ( const auto &e : agg.curl_error_map ) builder.add( ssCurlErrorMap, StateEntry{ { e.first }, { e.second } } );
+  for ( const auto &e : agg.http_code_map ) builder.add( ssHTTPCodeMap, StateEntry{ { e.first }, { e.second } } );
+  for ( const auto &e : agg.wait_class_map ) builder.add( ssWaitClassMap, StateEntry{ { e.first }, { e.second } } );
+  for ( const auto &wd : agg.weekmap_qtystats ) {
+    for ( const auto &e : wd.second )
+      builder.add( ssWeekmapQtyStats, StateEntry{ { wd.first, e.first.hour, e.first.minute }, { builder.addQtyStats( e.second ) } } );
+  }
+  for ( const auto &e : agg.qos_by_date ) {
+    builder.add( ssQoSByDate, StateEntry{ { e.first.year, e.first.month, e.first.day },
+                                          { e.second.total, e.second.slow, e.second.curl_errors, e.second.http_errors } } );
+  }
+  for ( const auto &wd : agg.weekmap_probestats ) {
+    for ( const auto &e : wd.second )
+      builder.add( ssWeekmapQoS, StateEntry{ { wd.first, e.first.hour, e.first.minute },
+                                             { e.second.total, e.second.slow, e.second.curl_errors, e.second.http_errors } } );
+  }
+  saveProbes( builder, ssCurlErrorList, agg.curl_error_list );
+  saveProbes( builder, ssHTTPErrorList, agg.http_error_list );
+  saveProbes( builder, ssSlowList, agg.slow_repsonse_list );
+  saveProbes( builder, ssRecentProbes, agg.recent_probes );
+  // the malformed lines themselves are only written to the --reject file of the run that read them
+  for ( int k = PARSE_ERROR_FIRST; k < PARSE_ERROR_FIRST + PARSE_ERROR_KINDS; k++ ) {
+    uint64_t n = agg.rejects.count( static_cast<ParseResult>( k ) );
+    if ( n ) builder.add( ssParseErrors, StateEntry{ { k }, { n } } );
+  }
+  // the four Comments fields, followed by key,value pairs
+  builder.addString( agg.comments.client_fqdn );
+  builder.addString( agg.comments.client_ip );
+  builder.addString( agg.comments.request );
+  builder.addString( agg.comments.url );
+  for ( const auto &c : agg.comments.comments ) {
+    builder.addString( c.first );
+    builder.addString( c.second );
+  }
+
+  string temp = path + ".tmp";
+  ofstream out( temp, ios::binary | ios::trunc );
+  if ( !out ) throw std::runtime_error( "cannot create '" + temp + "'" );
+  builder.write( out );
+  out.close();
+  if ( !out ) throw std::runtime_error( "error writing '" + temp + "'" );
+  if ( rename( temp.c_str(), path.c_str() ) != 0 )
+    throw std::runtime_error( "cannot rename '" + temp + "' to '" + path + "': " + strerror( errno ) );
+}
+
+bool loadState( const string &path, Aggregate &agg, const function<bool(const InputFingerprint&)> &accept,
+                InputFingerprint &fingerprint ) {
+  struct stat st;
+  if ( stat( path.c_str(), &st ) != 0 ) return false;
+  MappedFile file( path );
+  StateView view( file.view() );
+  if ( view.version() != STATE_VERSION ) {
+    cerr << "state '" << path << "' was saved by another curlstats version, reading from the start" << endl;
+    return false;
+  }
+  const StateOptions &saved = view.record<StateOptions>( ssOptions );
+  StateOptions current = currentOptions();
+  if ( saved.slow_threshold != current.slow_threshold || saved.day_bucket != current.day_bucket ||
+       saved.weekmap_bucket != current.weekmap_bucket || saved.output_mode != current.output_mode ||
+       saved.where_hash != current.where_hash ) {
+    cerr << "state '" << path << "' was saved with different options, reading from the start" << endl;
+    return false;
+  }
+  fingerprint = view.record<InputFingerprint>( ssFingerprint );
+  if ( !accept( fingerprint ) ) return false;
+  StateLoader loader( view );
+
+  const StateGlobal &global = view.record<StateGlobal>( ssGlobal );
+  agg.globalstats.timed_probes = global.timed_probes;
+  agg.globalstats.total_probes = global.total_probes;
+  agg.globalstats.items_slow = global.items_slow;
+  agg.globalstats.size_upload = global.size_upload;
+  agg.globalstats.size_download = global.size_download;
+  agg.globalstats.total_time = global.total_time;
+  agg.globalstats.total_slow_time = global.total_slow_time;
+  loader.getQtyStats( global.response_stats, agg.globalstats.response_stats );
+  loader.getProbeStats( global.wait_class_stats, agg.globalstats.wait_class_stats );
+  agg.globalstats.first_time = fromState( global.first_time );
+  agg.globalstats.last_time = fromState( global.last_time );
+
+  size_t count;
+  const StateEntry* e = view.section<StateEntry>( ssSlowMap, count );
+  for ( size_t i = 0; i < count; i++ ) loader.getQtyStats( e[i].value[0], agg.slow_map[static_cast<WaitClass>( e[i].key[0] )] );
+  e = view.section<StateEntry>( ssSlowDowMap, count );
+  for ( size_t i = 0; i < count; i++ ) loader.getProbeStats( e[i].value[0], agg.slow_dow_map[weekdayKey( e[i].key[0] )] );
+  e = view.section<StateEntry>( ssTotalDowMap, count );
+  for ( size_t i = 0; i < count; i++ ) loader.getProbeStats( e[i].value[0], agg.total_dow_map[weekdayKey( e[i].key[0] )] );
+  e = view.section<StateEntry>( ssSlowDayMap, count );
+  for ( size_t i = 0; i < count; i++ ) loader.getProbeStats( e[i].value[0], agg.slow_day_map[timeKey( e[i].key[0], e[i].key[1] )] );
+  e = view.section<StateEntry>( ssTotalDayMap, count );
+  for ( size_t i = 0; i < count; i++ ) loader.getProbeStats( e[i].value[0], agg.total_day_map[timeKey( e[i].key[0], e[i].key[1] )] );
+  e = view.section<StateEntry>( ssTotalDateMap, count );
+  for ( size_t i = 0; i < count; i++ )
+    loader.getProbeStats( e[i].value[0], agg.total_date_map[dateKey( e[i].key[0], e[i].key[1], e[i].key[2] )] );
+  e = view.section<StateEntry>( ssSlowDateMap, count );
+  for ( size_t i = 0; i < count; i++ )
+    loader.getProbeStats( e[i].value[0], agg.slow_date_map[dateKey( e[i].key[0], e[i].key[1], e[i].key[2] )] );
+  e = view.section<StateEntry>( ssCurlErrorMap, count );
+  for ( size_t i = 0; i < count; i++ ) agg.curl_error_map[static_cast<uint16_t>( e[i].key[0] )] = e[i].value[0];
+  e = view.section<StateEntry>( ssHTTPCodeMap, count );
+  for ( size_t i = 0; i < count; i++ ) agg.http_code_map[static_cast<uint16_t>( e[i].key[0] )] = e[i].value[0];
+  e = view.section<StateEntry>( ssWaitClassMap, count );
+  for ( size_t i = 0; i < count; i++ ) agg.wait_class_map[static_cast<WaitClass>( e[i].key[0] )] = e[i].value[0];
+  e = view.section<StateEntry>( ssWeekmapQtyStats, count );
+  for ( size_t i = 0; i < count; i++ )
+    loader.getQtyStats( e[i].value[0], agg.weekmap_qtystats[weekdayKey( e[i].key[0] )][timeKey( e[i].key[1], e[i].key[2] )] );
+  e = view.section<StateEntry>( ssQoSByDate, count );
+  for ( size_t i = 0; i < count; i++ )
+    agg.qos_by_date[dateKey( e[i].key[0], e[i].key[1], e[i].key[2] )] = { e[i].value[0], e[i].value[1], e[i].value[2], e[i].value[3] };
+  e = view.section<StateEntry>( ssWeekmapQoS, count );
+  for ( size_t i = 0; i < count; i++ )
+    agg.weekmap_probestats[weekdayKey( e[i].key[0] )][timeKey( e[i].key[1], e[i].key[2] )] = { e[i].value[0], e[i].value[1], e[i].value[2], e[i].value[3] };
+  loadProbes( view, ssCurlErrorList, agg.curl_error_list );
+  loadProbes( view, ssHTTPErrorList, agg.http_error_list );
+  loadProbes( view, ssSlowList, agg.slow_repsonse_list );
+  loadProbes( view, ssRecentProbes, agg.recent_probes );
+  e = view.section<StateEntry>( ssParseErrors, count );
+  for ( size_t i = 0; i < count; i++ ) {
+    if ( isParseError( static_cast<ParseResult>( e[i].key[0] ) ) && e[i].key[0] < PARSE_ERROR_FIRST + PARSE_ERROR_KINDS )
+      agg.rejects.setCount( static_cast<ParseResult>( e[i].key[0] ), e[i].value[0] );
+  }
+
+  size_t string_count, chars;
+  const StateString* strings = view.section<StateString>( ssComments, string_count );
+  const char* text = view.section<char>( ssStrings, chars );
+  auto getString = [&]( size_t i ) {
+    if ( strings[i].offset + strings[i].length > chars ) throw std::runtime_error( "state file is corrupt" );
+    return string( text + strings[i].offset, strings[i].length );
+  };
+  if ( string_count < 4 || string_count % 2 ) throw std::runtime_error( "state file is corrupt" );
+  agg.comments.client_fqdn = getString( 0 );
+  agg.comments.client_ip = getString( 1 );
+  agg.comments.request = getString( 2 );
+  agg.comments.url = getString( 3 );
+  for ( size_t i = 4; i < string_count; i += 2 ) agg.comments.comments.insert( { getString( i ), getString( i + 1 ) } );
+  return true;
+}
+
+void readWithState( Aggregate &agg, const string &path, const string &state_path, unsigned threads ) {
+  auto mapped = make_shared<MappedFile>( path );
+  const MappedFile &file = *mapped;
+  if ( detectCompression( file.view() ) != Compression::None || isArchive( file.view() ) )
+    throw std::runtime_error( "--state requires a plain text input file" );
+  InputFingerprint saved;
+  size_t offset = 0;
+  auto matches = [&]( const InputFingerprint &f ) {
+    if ( f.device == file.device() && f.inode == file.inode() && f.offset <= file.size() &&
+         f.head_hash == hashFNV1a( file.view().substr( 0, min( f.offset, static_cast<uint64_t>( STATE_HEAD_BYTES ) ) ) ) ) return true;
+    cerr << "state '" << state_path << "' does not match '" << path << "', reading from the start" << endl;
+    return false;
+  };
+  if ( loadState( state_path, agg, matches, saved ) ) offset = saved.offset;
+  // leave an incomplete last line for the next run
+  string_view data = file.view().substr( offset );
+  size_t last = data.rfind( '\n' );
+  data = data.substr( 0, last == string_view::npos ? 0 : last + 1 );
+  ParseState state = leadingParseState( file.view(), path );
+  // the probes of previous runs are in the state, those read now in the file
+  readText( agg, data, state, threads, { addTrailSource( mapped, state.plan ), file.view() } );
+  InputFingerprint fingerprint;
+  fingerprint.device = file.device();
+  fingerprint.inode = file.inode();
+  fingerprint.offset = offset + data.size();
+  fingerprint.head_hash = hashFNV1a( file.view().substr( 0, min( fingerprint.offset, static_cast<uint64_t>( STATE_HEAD_BYTES ) ) ) );
+  saveState( state_path, agg, fingerprint );
+}
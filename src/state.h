@@ -0,0 +1,77 @@
+#ifndef state_h
+#define state_h
+
+#include "variables.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+using namespace std;
+
+/** The magic bytes a state file starts with. */
+#define STATE_MAGIC "CSSTATE"
+
+/** The state file format version. */
+#define STATE_VERSION 5
+
+/** The number of leading input bytes hashed into an InputFingerprint. */
+#define STATE_HEAD_BYTES 4096
+
+/**
+ * Identifies the input file a state was saved for and how far it was read.
+ */
+struct InputFingerprint {
+  /** The device of the input file. */
+  uint64_t device = 0;
+
+  /** The inode of the input file. */
+  uint64_t inode = 0;
+
+  /** The number of input bytes aggregated, always at the start of a line. */
+  uint64_t offset = 0;
+
+  /** A hash of the first STATE_HEAD_BYTES (or offset if smaller) input bytes. */
+  uint64_t head_hash = 0;
+};
+
+/**
+ * Save an Aggregate and its InputFingerprint, together with the options that affect aggregation.
+ *
+ * The state file is a header and a table of sections, followed by the sections. Each section is an
+ * 8 byte aligned array of fixed size records in host byte order, so that a mapped state file is used
+ * in place. Nested structures refer to each other by record index, for example a map of QtyStats is a
+ * section of keys with the index of their QtyStats record, which in turn refers to its histogram
+ * buckets by index. The file is written to a temporary file that is renamed over path, so that an
+ * interrupted save leaves the previous state intact.
+ * @param path The path of the state file.
+ * @param agg The Aggregate to save.
+ * @param fingerprint The InputFingerprint of the input aggregated.
+ */
+void saveState( const string &path, const Aggregate &agg, const InputFingerprint &fingerprint );
+
+/**
+ * Load a state saved by saveState. The state is not loaded if it was saved with options that affect
+ * aggregation differently, or if its InputFingerprint is not accepted.
+ * @param path The path of the state file.
+ * @param agg The (empty) Aggregate to load into.
+ * @param accept Returns true if the state's InputFingerprint matches the input.
+ * @param fingerprint Receives the InputFingerprint.
+ * @return False if the state was not loaded, throws a std::runtime_error if the state file is corrupt.
+ */
+bool loadState( const string &path, Aggregate &agg, const function<bool(const InputFingerprint&)> &accept,
+                InputFingerprint &fingerprint );
+
+/**
+ * Read the data appended to an input file since the last run. The state is loaded, and if it matches
+ * the input file, only the input following the saved offset is parsed. Otherwise, as on the first run,
+ * the whole file is parsed. Only complete lines are parsed, so that a line being written is read by the
+ * next run. The state is then saved.
+ * @param agg The Aggregate to add to.
+ * @param path The input file.
+ * @param state_path The state file.
+ * @param threads The number of threads to use.
+ */
+void readWithState( Aggregate &agg, const string &path, const string &state_path, unsigned threads );
+
+#endif
@@ -0,0 +1,68 @@
+#include "taskpool.h"
+
+#include <thread>
+#include <vector>
+
+TaskPool::TaskPool( unsigned threads ) : threads_( threads ? threads : 1 ), error_(nullptr) {
+}
+
+void TaskPool::run( size_t count, const function<void(size_t)> &task ) {
+  unsigned workers = static_cast<unsigned>( min( static_cast<size_t>( threads_ ), count ) );
+  if ( workers < 2 ) {
+    for ( size_t i = 0; i < count; i++ ) task( i );
+    return;
+  }
+  queues_.clear();
+  queues_.resize( workers );
+  error_ = nullptr;
+  for ( unsigned w = 0; w < workers; w++ ) {
+    for ( size_t i = count * w / workers; i < count * ( w + 1 ) / workers; i++ ) queues_[w].tasks.push_back( i );
+  }
+  vector<thread> pool;
+  for ( unsigned w = 1; w < workers; w++ ) {
+    pool.push_back( thread( [this, w, &task]() { work( w, task ); } ) );
+  }
+  work( 0, task );
+  for ( auto &t : pool ) t.join();
+  if ( error_ ) rethrow_exception( error_ );
+}
+
+bool TaskPool::take( unsigned worker, size_t &index ) {
+  {
+    WorkQueue &own = queues_[worker];
+    lock_guard<mutex> lock( own.lock );
+    if ( own.tasks.size() ) {
+      index = own.tasks.front();
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+  for ( unsigned i = 1; i < queues_.size(); i++ ) {
+    WorkQueue &victim = queues_[( worker + i ) % queues_.size()];
+    lock_guard<mutex> lock( victim.lock );
+    if ( victim.tasks.size() ) {
+      index = victim.tasks.back();
+      victim.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskPool::work( unsigned worker, const function<void(size_t)> &task ) {
+  size_t index;
+  while ( take( worker, index ) ) {
+    try {
+      task( index );
+    }
+    catch ( ... ) {
+      lock_guard<mutex> lock( error_lock_ );
+      if ( !error_ ) error_ = current_exception();
+      // drop the remaining tasks
+      for ( auto &q : queues_ ) {
+        lock_guard<mutex> qlock( q.lock );
+        q.tasks.clear();
+      }
+    }
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef taskpool_h
+#define taskpool_h
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+
+using namespace std;
+
+/**
+ * Runs a number of independent tasks, identified by their index, on a work-stealing thread pool.
+ * Each worker owns a deque, initially holding a contiguous range of task indexes. A worker takes tasks
+ * from the front of its own deque, and once that is empty steals from the back of the deque of another
+ * worker, so that workers that drew short tasks help out those that drew long ones.
+ * @code
+ * vector<Aggregate> partials( tasks.size() );
+ * TaskPool pool( threads );
+ * pool.run( tasks.size(), [&]( size_t i ) { read( partials[i], tasks[i] ); } );
+ * @endcode
+ */
+class TaskPool {
+  public:
+
+    /**
+     * Construct a TaskPool.
+     * @param threads The number of workers, including the calling thread.
+     */
+    TaskPool( unsigned threads );
+
+    /**
+     * Run tasks 0 to count-1 and wait for them to complete. The calling thread works as one of the
+     * workers. If a task throws, remaining tasks are not started and the first exception is rethrown.
+     * @param count The number of tasks.
+     * @param task The function running a task, called with the task index.
+     */
+    void run( size_t count, const function<void(size_t)> &task );
+
+  private:
+
+    /**
+     * A worker's deque of task indexes.
+     */
+    struct WorkQueue {
+      /** Protects tasks. */
+      mutex lock;
+      /** The task indexes. */
+      deque<size_t> tasks;
+    };
+
+    /**
+     * Take the next task for a worker, its own or a stolen one.
+     * @param worker The worker index.
+     * @param index Receives the task index.
+     * @return False if there are no tasks left.
+     */
+    bool take( unsigned worker, size_t &index );
+
+    /**
+     * The worker loop.
+     * @param worker The worker index.
+     * @param task The function running a task.
+     */
+    void work( unsigned worker, const function<void(size_t)> &task );
+
+    /** The number of workers. */
+    unsigned threads_;
+
+    /** The deques of the workers. */
+    deque<WorkQueue> queues_;
+
+    /** Protects error_. */
+    mutex error_lock_;
+
+    /** The first error raised by a task. */
+    exception_ptr error_;
+};
+
+#endif
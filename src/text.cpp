@@ -18,6 +18,7 @@ void summary_options() {
   cout << "histogram max buckets          : " << FIXED3W7 << options.histo_max_buckets << " buckets" << endl;
   cout << "repeating 24h histogram bucket : " << FIXED3W7 << options.day_bucket << " minutes" << endl;
   cout << "histogram minimum display pct  : " << FIXED3W7 << options.histo_min_pct << " %" << endl;
+  if ( options.where.length() ) cout << "probe filter                   : " << options.where << endl;
 }
 
 void summary_slowtrail() {
@@ -27,10 +28,12 @@ void summary_slowtrail() {
   }
 }
 
-void show_histogram( const QtyStats& ref ) {
+void show_histogram( const QtyView& ref, const string &title ) {
+  HistogramView view = ref.getHistogram();
+  cout << endl << title << ", bucket size " << setprecision(6) << view.bucket << "s" << endl;
   cout << setw(11) << "bucket" << " " << setw(9) << "count" << setw(7) << "%probe" << setw(7) << "pctile" << setw(8) << "sigma" << endl;
   double percentile = 0.0;
-  for ( const auto &b : ref.buckets ) {
+  for ( const auto &b : view.buckets ) {
     double pct = b.second/(double)globalstats.timed_probes*100.0;
     percentile += pct;
     double sigma = (b.first - ref.getMean())/ref.getSigma();
@@ -49,26 +52,19 @@ void summary_histo() {
   cout << FIXED3 << 100.0 - (double)globalstats.items_slow / (double)globalstats.timed_probes * 100.0 << "% ";
   cout << "of probes return within " << FIXED3 << options.slow_threshold << "s" << endl;
 
-  cout << endl << "probe count to total response time distribution, bucket size " << setprecision(6) << globalstats.response_stats.current_bucket << "s" << endl;
-  show_histogram( globalstats.response_stats );
+  show_histogram( globalstats.response_stats, "probe count to total response time distribution" );
 
-  cout << endl << "probe count to DNS wait time distribution, bucket size " << setprecision(6) << globalstats.wait_class_stats.namelookup.current_bucket << "s" << endl;
-  show_histogram( globalstats.wait_class_stats.namelookup );
+  show_histogram( globalstats.wait_class_stats.namelookup(), "probe count to DNS wait time distribution" );
 
-  cout << endl << "probe count to TCP wait time distribution, bucket size " << setprecision(6) << globalstats.wait_class_stats.connect.current_bucket << "s" << endl;
-  show_histogram( globalstats.wait_class_stats.connect );
+  show_histogram( globalstats.wait_class_stats.connect(), "probe count to TCP wait time distribution" );
 
-  cout << endl << "probe count to TLS wait time distribution, bucket size " << setprecision(6) << globalstats.wait_class_stats.appconnect.current_bucket << "s" << endl;
-  show_histogram( globalstats.wait_class_stats.appconnect );
+  show_histogram( globalstats.wait_class_stats.appconnect(), "probe count to TLS wait time distribution" );
 
-  cout << endl << "probe count to REQ wait time distribution, bucket size " << setprecision(6) << globalstats.wait_class_stats.pretransfer.current_bucket << "s" << endl;
-  show_histogram( globalstats.wait_class_stats.pretransfer );
+  show_histogram( globalstats.wait_class_stats.pretransfer(), "probe count to REQ wait time distribution" );
 
-  cout << endl << "probe count to RSP wait time distribution, bucket size " << setprecision(6) << globalstats.wait_class_stats.starttransfer.current_bucket << "s" << endl;
-  show_histogram( globalstats.wait_class_stats.starttransfer );
+  show_histogram( globalstats.wait_class_stats.starttransfer(), "probe count to RSP wait time distribution" );
 
-  cout << endl << "probe count to DAT wait time distribution, bucket size " << setprecision(6) << globalstats.wait_class_stats.endtransfer.current_bucket << "s" << endl;
-  show_histogram( globalstats.wait_class_stats.endtransfer );
+  show_histogram( globalstats.wait_class_stats.endtransfer(), "probe count to DAT wait time distribution" );
 }
 
 void summary_wait_class() {
@@ -80,11 +76,16 @@ void summary_wait_class() {
   cout << setw(8) << "max";
   cout << setw(8) << "avg";
   cout << setw(8) << "stdev";
+  cout << setw(8) << "p50";
+  cout << setw(8) << "p90";
+  cout << setw(8) << "p99";
+  cout << setw(8) << "p99.9";
   cout << endl;
   for ( const auto &w : wait_class_map ) {
     cout << "  " << waitClass2String( w.first ) << " " << FIXEDINT << w.second << " ";
     cout << FIXEDPCT << slow_map[w.first].total / globalstats.total_slow_time * 100.0 << "% ";
     cout << slow_map[w.first].asString(true);
+    cout << slow_map[w.first].percentileString();
     cout << endl;
   }
 }
@@ -105,14 +106,14 @@ void summary_slow_probes_to_dow() {
   for ( auto d : slow_dow_map ) {
     cout << setw(9) << dowStr(d.first) << " ";
     cout << FIXEDPCT << (double)d.second.getNumItems() / (double)total_dow_map[d.first].getNumItems() * 100.0 << " ";
-    cout << FIXED3W7 << slow_dow_map[d.first].probe.getMean() << " ";
+    cout << FIXED3W7 << slow_dow_map[d.first].probe().getMean() << " ";
     cout << setw(5) << waitClass2String( slow_dow_map[d.first].most() ) << " ";
-    cout << slow_dow_map[d.first].namelookup.asString();
-    cout << slow_dow_map[d.first].connect.asString();
-    cout << slow_dow_map[d.first].appconnect.asString();
-    cout << slow_dow_map[d.first].pretransfer.asString();
-    cout << slow_dow_map[d.first].starttransfer.asString();
-    cout << slow_dow_map[d.first].endtransfer.asString();
+    cout << slow_dow_map[d.first].namelookup().asString();
+    cout << slow_dow_map[d.first].connect().asString();
+    cout << slow_dow_map[d.first].appconnect().asString();
+    cout << slow_dow_map[d.first].pretransfer().asString();
+    cout << slow_dow_map[d.first].starttransfer().asString();
+    cout << slow_dow_map[d.first].endtransfer().asString();
     cout << endl;
   }
 }
@@ -132,15 +133,15 @@ void summary_all_probes_to_dow() {
   cout << endl;
   for ( auto d : total_dow_map ) {
     cout << setw(9) << dowStr(d.first) << " ";
-    cout << FIXEDPCT << (double)slow_dow_map[d.first].getNumItems() / (double)d.second.getNumItems() * 100.0 << " ";
-    cout << FIXED3W7 << total_dow_map[d.first].probe.getMean() << " ";
+    cout << FIXEDPCT << (double)lookup( slow_dow_map, d.first ).getNumItems() / (double)d.second.getNumItems() * 100.0 << " ";
+    cout << FIXED3W7 << total_dow_map[d.first].probe().getMean() << " ";
     cout << setw(5) << waitClass2String( total_dow_map[d.first].most() ) << " ";
-    cout << total_dow_map[d.first].namelookup.asString();
-    cout << total_dow_map[d.first].connect.asString();
-    cout << total_dow_map[d.first].appconnect.asString();
-    cout << total_dow_map[d.first].pretransfer.asString();
-    cout << total_dow_map[d.first].starttransfer.asString();
-    cout << total_dow_map[d.first].endtransfer.asString();
+    cout << total_dow_map[d.first].namelookup().asString();
+    cout << total_dow_map[d.first].connect().asString();
+    cout << total_dow_map[d.first].appconnect().asString();
+    cout << total_dow_map[d.first].pretransfer().asString();
+    cout << total_dow_map[d.first].starttransfer().asString();
+    cout << total_dow_map[d.first].endtransfer().asString();
     cout << endl;
   }
 }
@@ -163,14 +164,14 @@ void summary_slow_probes_to_daily() {
     cout << fixed << setw(2) << setfill('0') << d.first.hour << ":"
          << fixed << setw(2) << setfill('0') << d.first.minute << " ";
     cout << FIXEDPCT << (double)d.second.getNumItems() / (double)total_day_map[d.first].getNumItems() * 100.0 << " ";
-    cout << FIXED3W7 << slow_day_map[d.first].probe.getMean() << " ";
+    cout << FIXED3W7 << slow_day_map[d.first].probe().getMean() << " ";
     cout << setw(5) << waitClass2String( slow_day_map[d.first].most() ) << " ";
-    cout << slow_day_map[d.first].namelookup.asString();
-    cout << slow_day_map[d.first].connect.asString();
-    cout << slow_day_map[d.first].appconnect.asString();
-    cout << slow_day_map[d.first].pretransfer.asString();
-    cout << slow_day_map[d.first].starttransfer.asString();
-    cout << slow_day_map[d.first].endtransfer.asString();
+    cout << slow_day_map[d.first].namelookup().asString();
+    cout << slow_day_map[d.first].connect().asString();
+    cout << slow_day_map[d.first].appconnect().asString();
+    cout << slow_day_map[d.first].pretransfer().asString();
+    cout << slow_day_map[d.first].starttransfer().asString();
+    cout << slow_day_map[d.first].endtransfer().asString();
     cout << endl;
   }
 }
@@ -192,15 +193,15 @@ void summary_all_probes_to_daily() {
   for ( auto d : total_day_map ) {
     cout << fixed << setw(2) << setfill('0') << d.first.hour << ":"
          << fixed << setw(2) << setfill('0') << d.first.minute << " ";
-    cout << FIXEDPCT << (double)slow_day_map[d.first].getNumItems() / (double)d.second.getNumItems() * 100.0 << " ";
-    cout << FIXED3W7 << total_day_map[d.first].probe.getMean() << " ";
+    cout << FIXEDPCT << (double)lookup( slow_day_map, d.first ).getNumItems() / (double)d.second.getNumItems() * 100.0 << " ";
+    cout << FIXED3W7 << total_day_map[d.first].probe().getMean() << " ";
     cout << setw(5) << waitClass2String( total_day_map[d.first].most() ) << " ";
-    cout << total_day_map[d.first].namelookup.asString();
-    cout << total_day_map[d.first].connect.asString();
-    cout << total_day_map[d.first].appconnect.asString();
-    cout << total_day_map[d.first].pretransfer.asString();
-    cout << total_day_map[d.first].starttransfer.asString();
-    cout << total_day_map[d.first].endtransfer.asString();
+    cout << total_day_map[d.first].namelookup().asString();
+    cout << total_day_map[d.first].connect().asString();
+    cout << total_day_map[d.first].appconnect().asString();
+    cout << total_day_map[d.first].pretransfer().asString();
+    cout << total_day_map[d.first].starttransfer().asString();
+    cout << total_day_map[d.first].endtransfer().asString();
     cout << endl;
   }
 }
@@ -238,6 +239,7 @@ void summary_daily_history() {
   cout << setw(10) << "date";
   cout << setw(8) << "%slow";
   cout << setw(8) << "avg";
+  cout << setw(8) << "p99";
   cout << setw(6) << "most";
   cout << " ----------DNS----------";
   cout << " ----------TCP----------";
@@ -251,18 +253,20 @@ void summary_daily_history() {
     cout << '-' << setw(2) << setfill('0') << d.first.month;
     cout << '-' << setw(2) << setfill('0') << d.first.day;
     cout << " ";
-    cout << FIXED3W7 << (double)slow_date_map[d.first].getNumItems() / (double)d.second.getNumItems() * 100.0;
+    cout << FIXED3W7 << (double)lookup( slow_date_map, d.first ).getNumItems() / (double)d.second.getNumItems() * 100.0;
     cout << " ";
-    cout << FIXED3W7 << d.second.probe.getMean();
+    cout << FIXED3W7 << d.second.probe().getMean();
+    cout << " ";
+    cout << FIXED3W7 << d.second.probe().getPercentile( 99.0 );
     cout << " ";
     cout << setw(5) << waitClass2String( d.second.most() );
     cout << " ";
-    cout << d.second.namelookup.asString();
-    cout << d.second.connect.asString();
-    cout << d.second.appconnect.asString();
-    cout << d.second.pretransfer.asString();
-    cout << d.second.starttransfer.asString();
-    cout << d.second.endtransfer.asString();
+    cout << d.second.namelookup().asString();
+    cout << d.second.connect().asString();
+    cout << d.second.appconnect().asString();
+    cout << d.second.pretransfer().asString();
+    cout << d.second.starttransfer().asString();
+    cout << d.second.endtransfer().asString();
     cout << endl;
   }
 }
@@ -276,6 +280,7 @@ void summary_global_stats() {
   cout << "#slow probes         : " << globalstats.items_slow << endl;
   size_t total_outside_qos = globalstats.items_slow + curl_error_list.size() + http_error_list.size();
   cout << "#errors curl/http    : " << curl_error_list.size() << "/" << http_error_list.size()  << endl;
+  if ( rejects.total() ) cout << "#malformed lines     : " << rejects.asString() << endl;
   cout << "QoS                  : " << FIXED3 << (1.0-(double)total_outside_qos/(double)globalstats.total_probes)*100.0 << "%" << endl;
 
   cout << "up/down bytes/req    : " << FIXED3 << (double)globalstats.size_upload/(double)globalstats.timed_probes/1024.0 << "KiB / "
@@ -290,6 +295,10 @@ void summary_global_stats() {
   cout << "min/max/sdev response: " << FIXED3 << globalstats.response_stats.min;
   cout << "/" << globalstats.response_stats.max;
   cout << "/" << globalstats.response_stats.getSigma() << "s" << endl;
+  cout << "p50/p90/p99/p99.9    : " << FIXED3 << globalstats.response_stats.getPercentile( 50.0 );
+  cout << "/" << globalstats.response_stats.getPercentile( 90.0 );
+  cout << "/" << globalstats.response_stats.getPercentile( 99.0 );
+  cout << "/" << globalstats.response_stats.getPercentile( 99.9 ) << "s" << endl;
   cout << "estimate network RTT : " << FIXED3 << globalstats.wait_class_stats.getNetworkRoundtrip()*1000.0 << "ms" << endl;
 
   cout << setw(4) << "class";
@@ -298,77 +307,88 @@ void summary_global_stats() {
   cout << setw(8) << "max";
   cout << setw(8) << "avg";
   cout << setw(8) << "stddev";
+  cout << setw(8) << "p50";
+  cout << setw(8) << "p90";
+  cout << setw(8) << "p99";
+  cout << setw(8) << "p99.9";
   cout << setw(8) << "%rtrip";
   const unsigned int consistency_width = 20;
   const std::string inconstr = "";
   cout << setw(consistency_width) << "consistency";
   cout << endl;
   cout << setw(5) << waitClass2String( wcDNS ) << " "
-       << FIXED3W7 << (double)slow_map[wcDNS].items / (double)globalstats.timed_probes * 100.0 << " "
-       << globalstats.wait_class_stats.namelookup.asString(true) << " "
-       << FIXEDPCT << globalstats.wait_class_stats.namelookup.total / globalstats.total_time * 100.0;
-  if ( globalstats.wait_class_stats.namelookup.total / globalstats.total_time * 100.0 > 1.0 )
-	cout << setw(consistency_width) << globalstats.wait_class_stats.namelookup.consistency();
+       << FIXED3W7 << (double)lookup( slow_map, wcDNS ).items / (double)globalstats.timed_probes * 100.0 << " "
+       << globalstats.wait_class_stats.namelookup().asString(true)
+       << globalstats.wait_class_stats.namelookup().percentileString() << " "
+       << FIXEDPCT << globalstats.wait_class_stats.namelookup().total / globalstats.total_time * 100.0;
+  if ( globalstats.wait_class_stats.namelookup().total / globalstats.total_time * 100.0 > 1.0 )
+	cout << setw(consistency_width) << globalstats.wait_class_stats.namelookup().consistency();
   else
 	cout << setw(consistency_width) << inconstr;
   cout <<  endl;
 
   cout << setw(5) <<  waitClass2String( wcTCPHandshake ) << " "
-       << FIXED3W7 << (double)slow_map[wcTCPHandshake].items / (double)globalstats.timed_probes * 100.0 << " "
-       << globalstats.wait_class_stats.connect.asString(true) << " "
-       << FIXEDPCT << globalstats.wait_class_stats.connect.total / globalstats.total_time * 100.0;
-  if ( globalstats.wait_class_stats.connect.total / globalstats.total_time * 100.0 > 1.0 )
-	cout << setw(consistency_width) << globalstats.wait_class_stats.connect.consistency();
+       << FIXED3W7 << (double)lookup( slow_map, wcTCPHandshake ).items / (double)globalstats.timed_probes * 100.0 << " "
+       << globalstats.wait_class_stats.connect().asString(true)
+       << globalstats.wait_class_stats.connect().percentileString() << " "
+       << FIXEDPCT << globalstats.wait_class_stats.connect().total / globalstats.total_time * 100.0;
+  if ( globalstats.wait_class_stats.connect().total / globalstats.total_time * 100.0 > 1.0 )
+	cout << setw(consistency_width) << globalstats.wait_class_stats.connect().consistency();
   else
 	cout << setw(consistency_width) << inconstr;
   cout <<  endl;
 
   cout << setw(5) <<  waitClass2String( wcSSLHandshake ) << " "
-       << FIXED3W7 << (double)slow_map[wcSSLHandshake].items / (double)globalstats.timed_probes * 100.0 << " "
-       << globalstats.wait_class_stats.appconnect.asString(true) << " "
-       << FIXEDPCT << globalstats.wait_class_stats.appconnect.total / globalstats.total_time * 100.0;
-  if ( globalstats.wait_class_stats.appconnect.total / globalstats.total_time * 100.0 > 1.0 )
-	cout << setw(consistency_width) << globalstats.wait_class_stats.appconnect.consistency();
+       << FIXED3W7 << (double)lookup( slow_map, wcSSLHandshake ).items / (double)globalstats.timed_probes * 100.0 << " "
+       << globalstats.wait_class_stats.appconnect().asString(true)
+       << globalstats.wait_class_stats.appconnect().percentileString() << " "
+       << FIXEDPCT << globalstats.wait_class_stats.appconnect().total / globalstats.total_time * 100.0;
+  if ( globalstats.wait_class_stats.appconnect().total / globalstats.total_time * 100.0 > 1.0 )
+	cout << setw(consistency_width) << globalstats.wait_class_stats.appconnect().consistency();
   else
 	cout << setw(consistency_width) << inconstr;
   cout <<  endl;
 
   cout << setw(5) <<  waitClass2String( wcSendStart ) << " "
-       << FIXED3W7 << (double)slow_map[wcSendStart].items / (double)globalstats.timed_probes * 100.0 << " "
-       << globalstats.wait_class_stats.pretransfer.asString(true) << " "
-       << FIXEDPCT<< globalstats.wait_class_stats.pretransfer.total / globalstats.total_time * 100.0;
-  if ( globalstats.wait_class_stats.pretransfer.total / globalstats.total_time * 100.0 > 1.0 )
-	cout << setw(consistency_width) << globalstats.wait_class_stats.pretransfer.consistency();
+       << FIXED3W7 << (double)lookup( slow_map, wcSendStart ).items / (double)globalstats.timed_probes * 100.0 << " "
+       << globalstats.wait_class_stats.pretransfer().asString(true)
+       << globalstats.wait_class_stats.pretransfer().percentileString() << " "
+       << FIXEDPCT<< globalstats.wait_class_stats.pretransfer().total / globalstats.total_time * 100.0;
+  if ( globalstats.wait_class_stats.pretransfer().total / globalstats.total_time * 100.0 > 1.0 )
+	cout << setw(consistency_width) << globalstats.wait_class_stats.pretransfer().consistency();
   else
 	cout << setw(consistency_width) << inconstr;
   cout <<  endl;
 
   cout << setw(5) <<  waitClass2String( wcWaitEnd ) << " "
-       << FIXED3W7 << (double)slow_map[wcWaitEnd].items / (double)globalstats.timed_probes * 100.0 << " "
-       << globalstats.wait_class_stats.starttransfer.asString(true) << " "
-       << FIXEDPCT << globalstats.wait_class_stats.starttransfer.total / globalstats.total_time * 100.0;
-  if ( globalstats.wait_class_stats.starttransfer.total / globalstats.total_time * 100.0 > 1.0 )
-	cout << setw(consistency_width) << globalstats.wait_class_stats.starttransfer.consistency();
+       << FIXED3W7 << (double)lookup( slow_map, wcWaitEnd ).items / (double)globalstats.timed_probes * 100.0 << " "
+       << globalstats.wait_class_stats.starttransfer().asString(true)
+       << globalstats.wait_class_stats.starttransfer().percentileString() << " "
+       << FIXEDPCT << globalstats.wait_class_stats.starttransfer().total / globalstats.total_time * 100.0;
+  if ( globalstats.wait_class_stats.starttransfer().total / globalstats.total_time * 100.0 > 1.0 )
+	cout << setw(consistency_width) << globalstats.wait_class_stats.starttransfer().consistency();
   else
 	cout << setw(consistency_width) << inconstr;
   cout <<  endl;
 
   cout << setw(5) <<  waitClass2String( wcReceiveEnd ) << " "
-       << FIXED3W7 << (double)slow_map[wcReceiveEnd].items / (double)globalstats.timed_probes * 100.0 << " "
-       << globalstats.wait_class_stats.endtransfer.asString(true) << " "
-       << FIXEDPCT << globalstats.wait_class_stats.endtransfer.total / globalstats.total_time * 100.0;
-  if ( globalstats.wait_class_stats.endtransfer.total / globalstats.total_time * 100.0 > 1.0 )
-	cout << setw(consistency_width) << globalstats.wait_class_stats.endtransfer.consistency();
+       << FIXED3W7 << (double)lookup( slow_map, wcReceiveEnd ).items / (double)globalstats.timed_probes * 100.0 << " "
+       << globalstats.wait_class_stats.endtransfer().asString(true)
+       << globalstats.wait_class_stats.endtransfer().percentileString() << " "
+       << FIXEDPCT << globalstats.wait_class_stats.endtransfer().total / globalstats.total_time * 100.0;
+  if ( globalstats.wait_class_stats.endtransfer().total / globalstats.total_time * 100.0 > 1.0 )
+	cout << setw(consistency_width) << globalstats.wait_class_stats.endtransfer().consistency();
   else
 	cout << setw(consistency_width) << inconstr;
   cout <<  endl;
 }
 
 void summary_abnormal() {
-  if ( globalstats.wait_class_stats.namelookup.getMean() > 2.0 * globalstats.wait_class_stats.connect.getMean() ) {
+  globalstats.findings.clear();
+  if ( globalstats.wait_class_stats.namelookup().getMean() > 2.0 * globalstats.wait_class_stats.connect().getMean() ) {
     globalstats.findings.push_back( "DNS is slow compared to TCP handshakes" );
   }
-  if ( globalstats.wait_class_stats.appconnect.getMean() > 6.0 * globalstats.wait_class_stats.connect.getMean() ) {
+  if ( globalstats.wait_class_stats.appconnect().getMean() > 6.0 * globalstats.wait_class_stats.connect().getMean() ) {
     globalstats.findings.push_back( "TLS is expensive compared to TCP" );
   }
   if ( globalstats.findings.size() > 0 ) {
@@ -0,0 +1,203 @@
+#include "timeindex.h"
+#include "datetime.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+/** Below this number of bytes, lowerBound scans lines instead of bisecting. */
+#define LINEAR_SEARCH_BYTES 4096
+
+/**
+ * The header of a time index file, followed by count TimeIndexEntry records, in host byte order.
+ */
+struct TimeIndexHeader {
+  /** TIME_INDEX_MAGIC, zero padded. */
+  char magic[8];
+  /** TIME_INDEX_VERSION. */
+  uint32_t version;
+  /** TIME_INDEX_STRIDE. */
+  uint32_t stride;
+  /** The device of the input file. */
+  uint64_t device;
+  /** The inode of the input file. */
+  uint64_t inode;
+  /** The number of input bytes indexed. */
+  uint64_t indexed;
+  /** The hash of the first TIME_INDEX_HEAD_BYTES (or indexed if smaller) input bytes. */
+  uint64_t head_hash;
+  /** The number of lines indexed since the last entry. */
+  uint64_t lines_since_entry;
+  /** The number of entries. */
+  uint64_t count;
+};
+
+static_assert( is_trivially_copyable<TimeIndexEntry>::value, "time index entries must be trivially copyable" );
+
+bool lineTime( string_view line, int64_t &epoch ) {
+  if ( isCommment( line ) ) return false;
+  DateTime dt;
+  if ( !dt.parse( line.substr( 0, line.find( ';' ) ) ) ) return false;
+  epoch = dt.toEpoch();
+  return true;
+}
+
+/**
+ * Return the end of the line starting at pos, excluding the '\n'.
+ */
+static inline size_t lineEnd( string_view data, size_t pos ) {
+  size_t nl = data.find( '\n', pos );
+  return nl == string_view::npos ? data.size() : nl;
+}
+
+/**
+ * Return the start of the first line starting at or after pos.
+ */
+static inline size_t lineStart( string_view data, size_t pos ) {
+  if ( pos == 0 || data[pos - 1] == '\n' ) return pos;
+  return min( lineEnd( data, pos ) + 1, data.size() );
+}
+
+size_t lowerBound( string_view data, int64_t epoch, size_t lo, size_t hi ) {
+  while ( hi - lo > LINEAR_SEARCH_BYTES ) {
+    size_t mid = lineStart( data, lo + ( hi - lo ) / 2 );
+    if ( mid >= hi ) break;
+    // the first probe line in [mid,hi)
+    size_t pos = mid;
+    int64_t t = 0;
+    bool found = false;
+    while ( pos < hi && !found ) {
+      size_t end = lineEnd( data, pos );
+      found = lineTime( data.substr( pos, end - pos ), t );
+      if ( !found ) pos = end + 1;
+    }
+    if ( !found ) hi = mid;
+    else if ( t < epoch ) lo = lineEnd( data, pos ) + 1;
+    else hi = pos;
+  }
+  for ( size_t pos = lo; pos < hi; ) {
+    size_t end = lineEnd( data, pos );
+    int64_t t;
+    if ( lineTime( data.substr( pos, end - pos ), t ) && t >= epoch ) return pos;
+    pos = end + 1;
+  }
+  return hi;
+}
+
+string_view sliceTimeRange( string_view data, int64_t from, int64_t to ) {
+  size_t start = from == INT64_MIN ? 0 : lowerBound( data, from, 0, data.size() );
+  size_t end = to == INT64_MAX ? data.size() : lowerBound( data, to, start, data.size() );
+  return data.substr( start, end - start );
+}
+
+TimeIndex::TimeIndex( const MappedFile &file ) : file_(file), path_(file.path() + TIME_INDEX_SUFFIX),
+                                                 indexed_(0), lines_since_entry_(0) {
+  if ( !load() ) {
+    entries_.clear();
+    indexed_ = 0;
+    lines_since_entry_ = 0;
+  }
+  uint64_t indexed = indexed_;
+  extend();
+  if ( indexed_ != indexed || !indexed ) save();
+}
+
+bool TimeIndex::load() {
+  ifstream in( path_, ios::binary );
+  if ( !in ) return false;
+  TimeIndexHeader header;
+  if ( !in.read( reinterpret_cast<char*>( &header ), sizeof(header) ) ) return false;
+  if ( strncmp( header.magic, TIME_INDEX_MAGIC, sizeof(header.magic) ) != 0 || header.version != TIME_INDEX_VERSION ||
+       header.stride != TIME_INDEX_STRIDE ) return false;
+  if ( header.device != file_.device() || header.inode != file_.inode() || header.indexed > file_.size() ||
+       header.head_hash != hashFNV1a( file_.view().substr( 0, min( header.indexed, static_cast<uint64_t>( TIME_INDEX_HEAD_BYTES ) ) ) ) ) {
+    cerr << "time index '" << path_ << "' does not match '" << file_.path() << "', rebuilding" << endl;
+    return false;
+  }
+  entries_.resize( header.count );
+  if ( !in.read( reinterpret_cast<char*>( entries_.data() ), header.count * sizeof(TimeIndexEntry) ) ) return false;
+  indexed_ = header.indexed;
+  lines_since_entry_ = header.lines_since_entry;
+  return true;
+}
+
+void TimeIndex::extend() {
+  string_view data = file_.view();
+  // leave an incomplete last line for the next update
+  size_t last = data.rfind( '\n' );
+  if ( last == string_view::npos || last + 1 <= indexed_ ) return;
+  for ( size_t pos = indexed_; pos <= last; ) {
+    size_t end = lineEnd( data, pos );
+    int64_t epoch;
+    if ( ( entries_.empty() || lines_since_entry_ >= TIME_INDEX_STRIDE ) &&
+         lineTime( data.substr( pos, end - pos ), epoch ) ) {
+      entries_.push_back( { epoch, pos } );
+      lines_since_entry_ = 0;
+    }
+    lines_since_entry_++;
+    pos = end + 1;
+  }
+  indexed_ = last + 1;
+}
+
+void TimeIndex::save() const {
+  TimeIndexHeader header;
+  memset( &header, 0, sizeof(header) );
+  strncpy( header.magic, TIME_INDEX_MAGIC, sizeof(header.magic) );
+  header.version = TIME_INDEX_VERSION;
+  header.stride = TIME_INDEX_STRIDE;
+  header.device = file_.device();
+  header.inode = file_.inode();
+  header.indexed = indexed_;
+  header.head_hash = hashFNV1a( file_.view().substr( 0, min( indexed_, static_cast<uint64_t>( TIME_INDEX_HEAD_BYTES ) ) ) );
+  header.lines_since_entry = lines_since_entry_;
+  header.count = entries_.size();
+  string temp = path_ + ".tmp";
+  ofstream out( temp, ios::binary | ios::trunc );
+  out.write( reinterpret_cast<const char*>( &header ), sizeof(header) );
+  out.write( reinterpret_cast<const char*>( entries_.data() ), entries_.size() * sizeof(TimeIndexEntry) );
+  out.close();
+  if ( !out || rename( temp.c_str(), path_.c_str() ) != 0 ) {
+    cerr << "cannot save time index '" << path_ << "': " << strerror( errno ) << endl;
+    remove( temp.c_str() );
+  }
+}
+
+size_t TimeIndex::bound( int64_t epoch ) const {
+  // the entries bracketing epoch narrow the search to at most TIME_INDEX_STRIDE lines
+  auto i = lower_bound( entries_.begin(), entries_.end(), epoch,
+                        []( const TimeIndexEntry &e, int64_t value ) { return e.epoch < value; } );
+  size_t lo = i == entries_.begin() ? 0 : prev( i )->offset;
+  size_t hi = i == entries_.end() ? file_.size() : i->offset;
+  return lowerBound( file_.view(), epoch, lo, hi );
+}
+
+string_view TimeIndex::slice( int64_t from, int64_t to ) const {
+  size_t start = from == INT64_MIN ? 0 : bound( from );
+  size_t end = to == INT64_MAX ? file_.size() : max( start, bound( to ) );
+  return file_.view().substr( start, end - start );
+}
+
+vector<string_view> TimeIndex::split( string_view range, size_t parts ) const {
+  vector<string_view> ranges;
+  size_t start = range.data() - file_.data();
+  size_t end = start + range.size();
+  for ( size_t i = 1; i <= parts && start < end; i++ ) {
+    size_t cut = end;
+    if ( i < parts ) {
+      size_t target = range.data() - file_.data() + range.size() / parts * i;
+      auto e = lower_bound( entries_.begin(), entries_.end(), target,
+                            []( const TimeIndexEntry &e, size_t value ) { return e.offset < value; } );
+      if ( e != entries_.end() ) cut = min( end, static_cast<size_t>( e->offset ) );
+    }
+    if ( cut <= start ) continue;
+    ranges.push_back( file_.view().substr( start, cut - start ) );
+    start = cut;
+  }
+  return ranges;
+}
@@ -0,0 +1,148 @@
+#ifndef timeindex_h
+#define timeindex_h
+
+#include "mappedfile.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/** The magic bytes a time index file starts with. */
+#define TIME_INDEX_MAGIC "CSTIDX"
+
+/** The time index file format version. */
+#define TIME_INDEX_VERSION 1
+
+/** The suffix appended to the input file path to form the time index path. */
+#define TIME_INDEX_SUFFIX ".csidx"
+
+/** A time index entry is recorded every this many lines. */
+#define TIME_INDEX_STRIDE 1024
+
+/** The number of leading input bytes hashed to detect a replaced input file. */
+#define TIME_INDEX_HEAD_BYTES 4096
+
+/**
+ * A time index entry, the timestamp of a probe line and its offset in the input file.
+ */
+struct TimeIndexEntry {
+  /** The timestamp in seconds since the epoch, see DateTime::toEpoch. */
+  int64_t epoch;
+
+  /** The offset of the start of the line. */
+  uint64_t offset;
+};
+
+/**
+ * Return the timestamp of a probe line.
+ * @param line The line.
+ * @param epoch Receives the timestamp in seconds since the epoch.
+ * @return False if the line is a comment or does not start with a valid timestamp.
+ */
+bool lineTime( string_view line, int64_t &epoch );
+
+/**
+ * Find the first probe line with a timestamp >= epoch by binary search of time ordered data. Comment lines
+ * are skipped.
+ * @param data The data.
+ * @param epoch The timestamp in seconds since the epoch.
+ * @param lo The start of a line in data where the search starts.
+ * @param hi The end of the search, a line start or data.size().
+ * @return The offset of the line, hi if there is no such line in [lo,hi).
+ */
+size_t lowerBound( string_view data, int64_t epoch, size_t lo, size_t hi );
+
+/**
+ * Return the lines of time ordered data with timestamps in [from,to), by binary search.
+ * @param data The data.
+ * @param from The first timestamp included.
+ * @param to The first timestamp excluded.
+ * @return The lines in the time range.
+ */
+string_view sliceTimeRange( string_view data, int64_t from, int64_t to );
+
+/**
+ * A sparse index of the timestamps of a plain text input file, kept in a sidecar file with
+ * TIME_INDEX_SUFFIX appended to the input path. Every TIME_INDEX_STRIDE lines, the timestamp and offset of
+ * the next probe line are recorded, so that a time range is found in the index and only a few lines at its
+ * boundaries are searched. The index is built on first use and reused afterwards. If the input file has grown,
+ * only the appended lines are indexed; if it was replaced or truncated, the index is rebuilt.
+ * @code
+ * MappedFile file( "probes.dat" );
+ * TimeIndex index( file );
+ * string_view day = index.slice( from, to );
+ * @endcode
+ */
+class TimeIndex {
+  public:
+    /**
+     * Load the index of a file, building or updating it as needed. Failure to save the index is reported
+     * on cerr, the index is then used from memory.
+     * @param file The input file, which must outlive the TimeIndex.
+     */
+    TimeIndex( const MappedFile &file );
+
+    /**
+     * Return the lines with timestamps in [from,to).
+     * @param from The first timestamp included.
+     * @param to The first timestamp excluded.
+     * @return The lines in the time range.
+     */
+    string_view slice( int64_t from, int64_t to ) const;
+
+    /**
+     * Split a range of the file into line aligned ranges of about equal size, at index entries.
+     * @param range A range of lines of the file.
+     * @param parts The number of ranges wanted.
+     * @return At most parts ranges covering range.
+     */
+    vector<string_view> split( string_view range, size_t parts ) const;
+
+    /**
+     * Return the index entries.
+     * @return The entries in file order.
+     */
+    const vector<TimeIndexEntry>& entries() const { return entries_; }
+
+  private:
+    /**
+     * Load the index file.
+     * @return False if the index file does not exist or does not match the input file.
+     */
+    bool load();
+
+    /**
+     * Index the complete lines from indexed_ on.
+     */
+    void extend();
+
+    /**
+     * Save the index file.
+     */
+    void save() const;
+
+    /**
+     * Return the offset of the first probe line with a timestamp >= epoch.
+     */
+    size_t bound( int64_t epoch ) const;
+
+    /** The input file. */
+    const MappedFile &file_;
+
+    /** The index file path. */
+    string path_;
+
+    /** The index entries. */
+    vector<TimeIndexEntry> entries_;
+
+    /** The number of input bytes indexed, always at the start of a line. */
+    uint64_t indexed_;
+
+    /** The number of lines indexed since the last entry. */
+    uint64_t lines_since_entry_;
+};
+
+#endif
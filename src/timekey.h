@@ -2,6 +2,7 @@
 #define timekey_h
 
 #include <cassert>
+#include <cstddef>
 
 /**
  * Time with minute precision as an ordered key.
@@ -65,5 +66,21 @@ inline TimeKey bucket( const TimeKey &k, int bucket ) {
   return TimeKey( k.hour, k.minute / bucket * bucket );
 }
 
+/**
+ * Return the slot of the bucket of a TimeKey, numbering the buckets of the day from 0 in time order.
+ * The bucket parameter must be > 0 and <= 60.
+ */
+inline size_t timeSlot( const TimeKey &k, int bucket ) {
+  return static_cast<size_t>( k.hour * ( ( bucket + 59 ) / bucket ) + k.minute / bucket );
+}
+
+/**
+ * Return the bucketed TimeKey of a timeSlot. The bucket parameter must be > 0 and <= 60.
+ */
+inline TimeKey slotTime( size_t slot, int bucket ) {
+  const int per_hour = ( bucket + 59 ) / bucket;
+  return TimeKey( static_cast<int>( slot ) / per_hour, static_cast<int>( slot ) % per_hour * bucket );
+}
+
 
 #endif
\ No newline at end of file
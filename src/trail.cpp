@@ -0,0 +1,72 @@
+#include "trail.h"
+#include "options.h"
+#include "util.h"
+
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+
+/**
+ * An input file trails refer into.
+ */
+struct TrailSource {
+  /** The mapped file. */
+  shared_ptr<const MappedFile> file;
+  /** The ParsePlan of the file. */
+  ParsePlan plan;
+};
+
+/** The sources, a deque so that sources do not move as sources are added. */
+static deque<TrailSource> trail_sources;
+
+/** Protects trail_sources. */
+static mutex trail_sources_lock;
+
+uint32_t addTrailSource( shared_ptr<const MappedFile> file, const ParsePlan &plan ) {
+  lock_guard<mutex> lock( trail_sources_lock );
+  if ( trail_sources.size() >= TRAIL_MAX_SOURCES ) return TRAIL_NO_SOURCE;
+  trail_sources.push_back( { move( file ), plan } );
+  return static_cast<uint32_t>( trail_sources.size() - 1 );
+}
+
+const MappedFile& trailSourceFile( uint32_t source ) {
+  lock_guard<mutex> lock( trail_sources_lock );
+  return *trail_sources[source].file;
+}
+
+void ProbeTrail::add( const CURLProbe &curl, uint64_t location ) {
+  if ( location == TRAIL_NO_LOCATION ) {
+    entries_.push_back( TRAIL_COPY | copies_.size() );
+    copies_.push_back( curl );
+  } else entries_.push_back( location );
+}
+
+void ProbeTrail::append( const ProbeTrail &other ) {
+  entries_.reserve( entries_.size() + other.entries_.size() );
+  for ( auto e : other.entries_ ) entries_.push_back( e & TRAIL_COPY ? e + copies_.size() : e );
+  copies_.insert( copies_.end(), other.copies_.begin(), other.copies_.end() );
+}
+
+CURLProbe ProbeTrail::get( size_t index ) const {
+  uint64_t entry = entries_[index];
+  if ( entry & TRAIL_COPY ) return copies_[entry & ~TRAIL_COPY];
+  const TrailSource* source;
+  {
+    lock_guard<mutex> lock( trail_sources_lock );
+    source = &trail_sources[entry >> TRAIL_OFFSET_BITS];
+  }
+  string_view data = source->file->view();
+  size_t offset = static_cast<size_t>( entry & ( ( 1ull << TRAIL_OFFSET_BITS ) - 1 ) );
+  const char* nl = static_cast<const char*>( memchr( data.data() + offset, '\n', data.size() - offset ) );
+  string_view line = stripCR( data.substr( offset, nl ? nl - data.data() - offset : string_view::npos ) );
+  // parsed as the reader parsed it, so that the probe is identical to the one aggregated
+  string_view tokens[PARSE_PLAN_MAX_COLUMNS];
+  size_t count = split( line, tokens, PARSE_PLAN_MAX_COLUMNS, ';' );
+  CURLProbe curl;
+  size_t json = jsonToken( tokens, count );
+  ParseResult result = json ? parseJSON( curl, tokens, json, line, options.probe_fields )
+                            : source->plan.parse( curl, tokens, count, options.probe_fields );
+  if ( result != prProbe ) throw std::runtime_error( "input file '" + source->file->path() + "' changed while reading" );
+  return curl;
+}
@@ -0,0 +1,148 @@
+#ifndef trail_h
+#define trail_h
+
+#include "curlprobe.h"
+#include "mappedfile.h"
+#include "parseplan.h"
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/** The number of bits of a trail location holding the input offset, the bits above hold the source. */
+#define TRAIL_OFFSET_BITS 48
+
+/** The maximum number of TrailSources, further inputs are copied into the trails. */
+#define TRAIL_MAX_SOURCES 32767
+
+/** A source id that is not a TrailSource. */
+#define TRAIL_NO_SOURCE UINT32_MAX
+
+/** A trail location that refers to no input, the probe is copied into the trail. */
+#define TRAIL_NO_LOCATION UINT64_MAX
+
+/** The bit flagging a trail entry as the index of a copied probe rather than a location. */
+#define TRAIL_COPY ( 1ull << 63 )
+
+/**
+ * Register a memory mapped plain text input file that trails refer into, the file stays mapped for the
+ * lifetime of the program. Thread safe.
+ * @param file The mapped file.
+ * @param plan The ParsePlan of the file.
+ * @return The source id, TRAIL_NO_SOURCE if there are TRAIL_MAX_SOURCES sources already.
+ */
+uint32_t addTrailSource( shared_ptr<const MappedFile> file, const ParsePlan &plan );
+
+/**
+ * Return the file of a TrailSource. Thread safe.
+ * @param source The source id.
+ * @return The mapped file.
+ */
+const MappedFile& trailSourceFile( uint32_t source );
+
+/**
+ * A buffer holding the contents of a TrailSource, or of another input if source is TRAIL_NO_SOURCE, used
+ * to locate the probe lines parsed from it.
+ */
+struct TrailRange {
+  /** The source. */
+  uint32_t source = TRAIL_NO_SOURCE;
+
+  /** The buffer, data[i] is at offset i of the source. */
+  string_view data;
+
+  /**
+   * Return the trail location of a line.
+   * @param line A line.
+   * @return The location, TRAIL_NO_LOCATION if the line is not in data or there is no source.
+   */
+  uint64_t locate( string_view line ) const {
+    if ( source == TRAIL_NO_SOURCE || line.data() < data.data() || line.data() >= data.data() + data.size() )
+      return TRAIL_NO_LOCATION;
+    return static_cast<uint64_t>( source ) << TRAIL_OFFSET_BITS | static_cast<uint64_t>( line.data() - data.data() );
+  }
+};
+
+/**
+ * A trail of probes in input order, such as the curl errors. A probe read from a TrailSource is kept as
+ * its 8 byte location in the source, and parsed again when the trail is iterated, other probes are
+ * copied. Iterating yields CURLProbe values.
+ * @code
+ * for ( const auto &p : trail ) cout << p.asString() << endl;
+ * @endcode
+ */
+class ProbeTrail {
+  public:
+
+    /**
+     * Iterates a ProbeTrail, materializing each probe as it is dereferenced.
+     */
+    class const_iterator {
+      public:
+        typedef input_iterator_tag iterator_category;
+        typedef CURLProbe value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const CURLProbe* pointer;
+        typedef CURLProbe reference;
+
+        const_iterator( const ProbeTrail* trail, size_t index ) : trail_(trail), index_(index) {}
+        CURLProbe operator*() const { return trail_->get( index_ ); }
+        const_iterator& operator++() { index_++; return *this; }
+        bool operator==( const const_iterator &other ) const { return index_ == other.index_; }
+        bool operator!=( const const_iterator &other ) const { return index_ != other.index_; }
+
+      private:
+        /** The trail. */
+        const ProbeTrail* trail_;
+        /** The entry. */
+        size_t index_;
+    };
+
+    /**
+     * Add a probe.
+     * @param curl The probe.
+     * @param location The location of its line, see TrailRange::locate, TRAIL_NO_LOCATION to copy it.
+     */
+    void add( const CURLProbe &curl, uint64_t location = TRAIL_NO_LOCATION );
+
+    /**
+     * Append the probes of another trail.
+     * @param other The trail to append.
+     */
+    void append( const ProbeTrail &other );
+
+    /**
+     * Return a probe.
+     * @param index The index of the probe.
+     * @return The probe.
+     */
+    CURLProbe get( size_t index ) const;
+
+    /**
+     * Return the number of probes.
+     * @return The number of probes.
+     */
+    size_t size() const { return entries_.size(); }
+
+    /**
+     * Return true if the trail is empty.
+     * @return True if there are no probes.
+     */
+    bool empty() const { return entries_.empty(); }
+
+    const_iterator begin() const { return const_iterator( this, 0 ); }
+    const_iterator end() const { return const_iterator( this, entries_.size() ); }
+
+  private:
+    /** The entries, a location or TRAIL_COPY with the index in copies_. */
+    vector<uint64_t> entries_;
+
+    /** The copied probes. */
+    vector<CURLProbe> copies_;
+};
+
+#endif
@@ -12,10 +12,23 @@ vector<string> split( const string& src, char delimiter ) {
   return result;
 }
 
+size_t split( string_view src, string_view* tokens, size_t max_tokens, char delimiter ) {
+  size_t count = 0;
+  size_t start = 0;
+  while ( start < src.size() ) {
+    size_t end = src.find( delimiter, start );
+    if ( end == string_view::npos ) end = src.size();
+    if ( count < max_tokens ) tokens[count] = src.substr( start, end - start );
+    count++;
+    start = end + 1;
+  }
+  return count;
+}
+
 double bucket( double v, double bucket ) {
   return ceil( v / bucket ) * bucket;
 }
 
-bool isCommment( const string& s ) {
+bool isCommment( string_view s ) {
   return s.length() == 0 || s[0] == '#';
 }
\ No newline at end of file
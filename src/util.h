@@ -1,9 +1,13 @@
 #ifndef util_h
 #define util_h
 
+#include <charconv>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 using namespace std;
@@ -13,6 +17,40 @@ using namespace std;
  */
 vector<string> split( const string& src, char delimiter = ';' );
 
+/**
+ * Split a string_view into at most max_tokens string_views without allocating. The tokens point
+ * into src.
+ * @param src The string_view to split.
+ * @param tokens The array receiving the tokens.
+ * @param max_tokens The capacity of tokens.
+ * @param delimiter The delimiter.
+ * @return The number of tokens in src, which may be larger than max_tokens.
+ */
+size_t split( string_view src, string_view* tokens, size_t max_tokens, char delimiter = ';' );
+
+/**
+ * Parse a non-negative integer value without allocating or throwing.
+ * @param src The string_view to parse.
+ * @param value Receives the value.
+ * @return True if all of src is a valid non-negative integer.
+ */
+template <typename T> bool parseInt( string_view src, T& value ) {
+  const auto result = std::from_chars( src.data(), src.data() + src.size(), value );
+  if ( result.ec != std::errc() || result.ptr != src.data() + src.size() ) return false;
+  if constexpr ( is_signed_v<T> ) return value >= 0; else return true;
+}
+
+/**
+ * Parse a finite non-negative real value without allocating or throwing.
+ * @param src The string_view to parse.
+ * @param value Receives the value.
+ * @return True if all of src is a valid finite non-negative real.
+ */
+inline bool parseReal( string_view src, double& value ) {
+  const auto result = std::from_chars( src.data(), src.data() + src.size(), value );
+  return result.ec == std::errc() && result.ptr == src.data() + src.size() && std::isfinite( value ) && value >= 0;
+}
+
 /**
  * Bucket a real value to its ceil (largest integer above).
  */
@@ -21,7 +59,70 @@ double bucket( double v, double bucket );
 /**
  * return true if the line is a comment.
  */
-bool isCommment( const string& s );
+bool isCommment( string_view s );
+
+/**
+ * Return a line without the '\r' of a CRLF terminator, if any.
+ */
+inline string_view stripCR( string_view line ) {
+  return line.size() && line.back() == '\r' ? line.substr( 0, line.size() - 1 ) : line;
+}
+
+/**
+ * Append an unsigned LEB128 varint, 7 bits per byte, to out.
+ * @param out The string to append to.
+ * @param value The value.
+ */
+inline void putVarint( string &out, uint64_t value ) {
+  while ( value >= 0x80 ) {
+    out.push_back( static_cast<char>( value | 0x80 ) );
+    value >>= 7;
+  }
+  out.push_back( static_cast<char>( value ) );
+}
+
+/**
+ * Read an unsigned LEB128 varint from the front of in, advancing in past it.
+ * @param in The data to read from.
+ * @param value Receives the value.
+ * @return False if in does not start with a complete varint.
+ */
+inline bool getVarint( string_view &in, uint64_t &value ) {
+  value = 0;
+  for ( unsigned shift = 0; shift < 64 && in.size(); shift += 7 ) {
+    uint8_t b = static_cast<uint8_t>( in[0] );
+    in.remove_prefix( 1 );
+    value |= static_cast<uint64_t>( b & 0x7f ) << shift;
+    if ( !( b & 0x80 ) ) return true;
+  }
+  return false;
+}
+
+/**
+ * Map a signed value to an unsigned one so that values close to zero are small (zigzag encoding).
+ */
+inline uint64_t zigzag( int64_t value ) {
+  return ( static_cast<uint64_t>( value ) << 1 ) ^ static_cast<uint64_t>( value >> 63 );
+}
+
+/**
+ * The inverse of zigzag.
+ */
+inline int64_t unzigzag( uint64_t value ) {
+  return static_cast<int64_t>( value >> 1 ) ^ -static_cast<int64_t>( value & 1 );
+}
+
+/**
+ * Return the FNV-1a hash of data.
+ */
+inline uint64_t hashFNV1a( string_view data ) {
+  uint64_t h = 14695981039346656037ULL;
+  for ( char c : data ) {
+    h ^= static_cast<uint8_t>( c );
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
 
 inline std::string& ltrim(std::string& s, const char* t = " \t\n\r\f\v")
 {
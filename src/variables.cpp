@@ -1,39 +1,91 @@
 #include "variables.h"
+#include "options.h"
 
-GlobalStats globalstats;
+Aggregate aggregate;
 
-map<WaitClass,QtyStats> slow_map;
+GlobalStats &globalstats = aggregate.globalstats;
 
-map<int,ProbeStats> slow_dow_map;
+map<WaitClass,QtyStats> &slow_map = aggregate.slow_map;
 
-map<int,ProbeStats> total_dow_map;
+WeekdayMap<ProbeStats> &slow_dow_map = aggregate.slow_dow_map;
 
-map<TimeKey,ProbeStats> slow_day_map;
+WeekdayMap<ProbeStats> &total_dow_map = aggregate.total_dow_map;
 
-map<TimeKey,ProbeStats> total_day_map;
+DayMap<ProbeStats> &slow_day_map = aggregate.slow_day_map;
 
-map<DateKey,ProbeStats> total_date_map;
+DayMap<ProbeStats> &total_day_map = aggregate.total_day_map;
 
-map<DateKey,ProbeStats> slow_date_map;
+DayTable<ProbeStats> &total_date_map = aggregate.total_date_map;
 
-map<uint16_t,size_t> curl_error_map;
+DayTable<ProbeStats> &slow_date_map = aggregate.slow_date_map;
 
-map<uint16_t,size_t> http_code_map;
+CodeMap<size_t> &curl_error_map = aggregate.curl_error_map;
 
-map<DateKey,QoS> qos_by_date;
+CodeMap<size_t> &http_code_map = aggregate.http_code_map;
 
-map<WaitClass,size_t> wait_class_map;
+DayTable<QoS> &qos_by_date = aggregate.qos_by_date;
 
-list<CURLProbe> curl_error_list;
+map<WaitClass,size_t> &wait_class_map = aggregate.wait_class_map;
 
-list<CURLProbe> http_error_list;
+ProbeTrail &curl_error_list = aggregate.curl_error_list;
 
-list<CURLProbe> slow_repsonse_list;
+ProbeTrail &http_error_list = aggregate.http_error_list;
 
-Comments comments;
+ProbeTrail &slow_repsonse_list = aggregate.slow_repsonse_list;
 
-list<CURLProbe> recent_probes;
+Comments &comments = aggregate.comments;
 
-map<int,map<TimeKey,QtyStats>> weekmap_qtystats;
+list<CURLProbe> &recent_probes = aggregate.recent_probes;
 
-map<int,map<TimeKey,QoS>> weekmap_probestats;
\ No newline at end of file
+RejectLog &rejects = aggregate.rejects;
+
+WeekdayMap<WeekmapDayMap<QtyStats>> &weekmap_qtystats = aggregate.weekmap_qtystats;
+
+WeekdayMap<WeekmapDayMap<QoS>> &weekmap_probestats = aggregate.weekmap_probestats;
+
+size_t DaySlots::slot( const TimeKey &k ) {
+  return timeSlot( k, options.day_bucket );
+}
+
+TimeKey DaySlots::key( size_t slot ) {
+  return slotTime( slot, options.day_bucket );
+}
+
+size_t WeekmapSlots::slot( const TimeKey &k ) {
+  return timeSlot( k, options.weekmap_bucket );
+}
+
+TimeKey WeekmapSlots::key( size_t slot ) {
+  return slotTime( slot, options.weekmap_bucket );
+}
+
+void Aggregate::merge( const Aggregate& other ) {
+  globalstats.merge( other.globalstats );
+  for ( const auto &s : other.slow_map ) slow_map[s.first].merge( s.second );
+  for ( const auto &s : other.slow_dow_map ) slow_dow_map[s.first].merge( s.second );
+  for ( const auto &s : other.total_dow_map ) total_dow_map[s.first].merge( s.second );
+  for ( const auto &s : other.slow_day_map ) slow_day_map[s.first].merge( s.second );
+  for ( const auto &s : other.total_day_map ) total_day_map[s.first].merge( s.second );
+  for ( const auto &s : other.total_date_map ) total_date_map[s.first].merge( s.second );
+  for ( const auto &s : other.slow_date_map ) slow_date_map[s.first].merge( s.second );
+  for ( const auto &c : other.curl_error_map ) curl_error_map[c.first] += c.second;
+  for ( const auto &c : other.http_code_map ) http_code_map[c.first] += c.second;
+  for ( const auto &w : other.wait_class_map ) wait_class_map[w.first] += w.second;
+  for ( const auto &q : other.qos_by_date ) qos_by_date[q.first].merge( q.second );
+  for ( const auto &wd : other.weekmap_qtystats ) {
+    auto &ref = weekmap_qtystats[wd.first];
+    for ( const auto &t : wd.second ) ref[t.first].merge( t.second );
+  }
+  for ( const auto &wd : other.weekmap_probestats ) {
+    auto &ref = weekmap_probestats[wd.first];
+    for ( const auto &t : wd.second ) ref[t.first].merge( t.second );
+  }
+  curl_error_list.append( other.curl_error_list );
+  http_error_list.append( other.http_error_list );
+  slow_repsonse_list.append( other.slow_repsonse_list );
+  comments.merge( other.comments );
+  rejects.merge( other.rejects );
+  // the other recent probes are more recent than ours
+  recent_probes.insert( recent_probes.begin(), other.recent_probes.begin(), other.recent_probes.end() );
+  while ( recent_probes.size() > RECENT_PROBES ) recent_probes.pop_back();
+}
@@ -6,117 +6,297 @@
 #include "comments.h"
 #include "curlprobe.h"
 #include "datekey.h"
+#include "daytable.h"
+#include "reject.h"
+#include "slotmap.h"
 #include "timekey.h"
+#include "trail.h"
 
 #include <list>
 
+/**
+ * To track Qos for weekmaps.
+ */
+struct QoS {
+  size_t total = 0;
+  size_t slow = 0;
+  size_t curl_errors = 0;
+  size_t http_errors = 0;
+  double getQoS() const { return (1.0 - ( (double)slow + (double)curl_errors + (double)http_errors ) / (double)total) * 100.0; }
+  double getSlowPct() const { return (double)slow / (double)total * 100.0; }
+  double getHTTPErrorPct() const { return (double)http_errors / (double)total * 100.0; }
+  double getProbeErrorPct() const { return (double)curl_errors / (double)total * 100.0; }
+
+  /**
+   * Add the counts of another QoS.
+   * @param other The QoS to add.
+   */
+  void merge( const QoS& other ) {
+    total += other.total;
+    slow += other.slow;
+    curl_errors += other.curl_errors;
+    http_errors += other.http_errors;
+  }
+};
+
+/**
+ * SlotMap slots of the day of the week (0..6).
+ */
+struct WeekdaySlots {
+  static size_t slot( int wday ) { return static_cast<size_t>( wday ); }
+  static int key( size_t slot ) { return static_cast<int>( slot ); }
+};
+
+/**
+ * SlotMap slots of the curl and HTTP codes.
+ */
+struct CodeSlots {
+  static size_t slot( uint16_t code ) { return code; }
+  static uint16_t key( size_t slot ) { return static_cast<uint16_t>( slot ); }
+};
+
+/**
+ * SlotMap slots of the time of day in options.day_bucket buckets, see timeSlot.
+ */
+struct DaySlots {
+  static size_t slot( const TimeKey &k );
+  static TimeKey key( size_t slot );
+};
+
+/**
+ * SlotMap slots of the time of day in options.weekmap_bucket buckets, see timeSlot.
+ */
+struct WeekmapSlots {
+  static size_t slot( const TimeKey &k );
+  static TimeKey key( size_t slot );
+};
+
+/** Maps day-of-week to a value. */
+template <typename V> using WeekdayMap = SlotMap<int,V,WeekdaySlots>;
+
+/** Maps a curl or HTTP code to a value. */
+template <typename V> using CodeMap = SlotMap<uint16_t,V,CodeSlots>;
+
+/** Maps the time-of-day in options.day_bucket buckets to a value. */
+template <typename V> using DayMap = SlotMap<TimeKey,V,DaySlots>;
+
+/** Maps the time-of-day in options.weekmap_bucket buckets to a value. */
+template <typename V> using WeekmapDayMap = SlotMap<TimeKey,V,WeekmapSlots>;
+
+/**
+ * All statistics aggregated from the input. Input can be aggregated into separate Aggregate
+ * instances (for example one per thread) and merged afterwards, the global variables
+ * below refer to the members of the Aggregate used for output.
+ */
+struct Aggregate {
+  /** Global (all probes) statistics. */
+  GlobalStats globalstats;
+
+  /** Map slow probe statistics to a WaitClass. */
+  map<WaitClass,QtyStats> slow_map;
+
+  /** Map slow probe statistics to day-of-week. */
+  WeekdayMap<ProbeStats> slow_dow_map;
+
+  /** Map total probe statistics to day-of-week. */
+  WeekdayMap<ProbeStats> total_dow_map;
+
+  /** Map slow probe statistics to time-of-day. */
+  DayMap<ProbeStats> slow_day_map;
+
+  /** Map total probe statistics to time-of-day. */
+  DayMap<ProbeStats> total_day_map;
+
+  /** Map probe stats to date (year,month,day). */
+  DayTable<ProbeStats> total_date_map;
+
+  /** Map slow probe stats to date (year,month,day). */
+  DayTable<ProbeStats> slow_date_map;
+
+  /** Map probe count to curl error code. */
+  CodeMap<size_t> curl_error_map;
+
+  /** Map probe count to http error code. */
+  CodeMap<size_t> http_code_map;
+
+  /** Maps day of week to a map of time of day the QtyStats. */
+  WeekdayMap<WeekmapDayMap<QtyStats>> weekmap_qtystats;
+
+  /** Map http code count to date. */
+  DayTable<QoS> qos_by_date;
+
+  /** Track Qos for weekmap entries. */
+  WeekdayMap<WeekmapDayMap<QoS>> weekmap_probestats;
+
+  /** Map slow probe count to WaitClass. */
+  map<WaitClass,size_t> wait_class_map;
+
+  /** All probes with curl errors, kept as input locations where possible. */
+  ProbeTrail curl_error_list;
+
+  /** All probes with http errors, kept as input locations where possible. */
+  ProbeTrail http_error_list;
+
+  /** All slow probes, kept as input locations where possible. */
+  ProbeTrail slow_repsonse_list;
+
+  /** Comments. */
+  Comments comments;
+
+  /** Recent trail, most recent probe first. */
+  list<CURLProbe> recent_probes;
+
+  /** The malformed input lines. */
+  RejectLog rejects;
+
+  /**
+   * Merge another Aggregate into this one. The other Aggregate must cover input that follows
+   * the input aggregated into this one, so that trails remain in input order.
+   * @param other The Aggregate to merge.
+   */
+  void merge( const Aggregate& other );
+};
+
+/**
+ * Return the value of a key in a map, or a default value if the key is absent. Unlike operator[] this
+ * does not insert the key, so that generating output leaves the statistics unaltered.
+ * @param m The map.
+ * @param key The key.
+ * @return The value or a default value.
+ */
+template <typename M> const typename M::mapped_type& lookup( const M &m, const typename M::key_type &key ) {
+  static const typename M::mapped_type absent{};
+  auto i = m.find( key );
+  return i == m.end() ? absent : i->second;
+}
+
+/**
+ * Return the value of a key in a SlotMap, or a default value if the key is not in use.
+ * @param m The map.
+ * @param key The key.
+ * @return The value or a default value.
+ */
+template <typename K, typename V, typename S> const V& lookup( const SlotMap<K,V,S> &m, const K &key ) {
+  static const V absent{};
+  const V* value = m.get( key );
+  return value ? *value : absent;
+}
+
+/**
+ * Return the value of a date in a DayTable, or a default value if the date is not in use.
+ * @param m The table.
+ * @param key The date.
+ * @return The value or a default value.
+ */
+template <typename V> const V& lookup( const DayTable<V> &m, const DateKey &key ) {
+  static const V absent{};
+  const V* value = m.get( key );
+  return value ? *value : absent;
+}
+
+/**
+ * The Aggregate used for output.
+ */
+extern Aggregate aggregate;
+
 /**
  * Global (all probes) statistics.
  */
-extern GlobalStats globalstats;
+extern GlobalStats &globalstats;
 
 /**
  * Map slow probe statistics to a WaitClass.
  */
-extern map<WaitClass,QtyStats> slow_map;
+extern map<WaitClass,QtyStats> &slow_map;
 
 /**
  * Map slow probe statistics to day-of-week.
  */
-extern map<int,ProbeStats> slow_dow_map;
+extern WeekdayMap<ProbeStats> &slow_dow_map;
 
 /**
  * Map total probe statistics to day-of-week.
  */
-extern map<int,ProbeStats> total_dow_map;
+extern WeekdayMap<ProbeStats> &total_dow_map;
 
 /**
  * Map slow probe statistics to time-of-day.
  */
-extern map<TimeKey,ProbeStats> slow_day_map;
+extern DayMap<ProbeStats> &slow_day_map;
 
 /**
  * Map total probe statistics to time-of-day.
  */
-extern map<TimeKey,ProbeStats> total_day_map;
+extern DayMap<ProbeStats> &total_day_map;
 
 /**
  * Map probe stats to date (year,month,day)
  */
-extern map<DateKey,ProbeStats> total_date_map;
+extern DayTable<ProbeStats> &total_date_map;
 
 /**
  * Map slow probe stats to date (year,month,day)
  */
-extern map<DateKey,ProbeStats> slow_date_map;
+extern DayTable<ProbeStats> &slow_date_map;
 
 /**
  * Map probe count to curl error code
  */
-extern map<uint16_t,size_t> curl_error_map;
+extern CodeMap<size_t> &curl_error_map;
 
 /**
  * Map probe count to http error code
  */
-extern map<uint16_t,size_t> http_code_map;
+extern CodeMap<size_t> &http_code_map;
 
 /**
  * Maps day of week to a map of time of day the QtyStats.
  */
-extern map<int,map<TimeKey,QtyStats>> weekmap_qtystats;
-
-/**
- * To track Qos for weekmaps.
- */
-struct QoS {
-  size_t total = 0;
-  size_t slow = 0;
-  size_t curl_errors = 0;
-  size_t http_errors = 0;
-  double getQoS() const { return (1.0 - ( (double)slow + (double)curl_errors + (double)http_errors ) / (double)total) * 100.0; }
-  double getSlowPct() const { return (double)slow / (double)total * 100.0; }
-  double getHTTPErrorPct() const { return (double)http_errors / (double)total * 100.0; }
-  double getProbeErrorPct() const { return (double)curl_errors / (double)total * 100.0; }
-};
+extern WeekdayMap<WeekmapDayMap<QtyStats>> &weekmap_qtystats;
 
 /**
  * Map http code count to date
  */
-extern map<DateKey,QoS> qos_by_date;
+extern DayTable<QoS> &qos_by_date;
 
 /**
  * Track Qos for weekmap entries;
  */
-extern map<int,map<TimeKey,QoS>> weekmap_probestats;
+extern WeekdayMap<WeekmapDayMap<QoS>> &weekmap_probestats;
 
 /**
  * Map slow probe count to WaitClass
  */
-extern map<WaitClass,size_t> wait_class_map;
+extern map<WaitClass,size_t> &wait_class_map;
 
 /**
  * All probes with curl errors
  */
-extern list<CURLProbe> curl_error_list;
+extern ProbeTrail &curl_error_list;
 
 /**
  * All probes with http errors
  */
-extern list<CURLProbe> http_error_list;
+extern ProbeTrail &http_error_list;
 
 /**
  * All slow probes
  */
-extern list<CURLProbe> slow_repsonse_list;
+extern ProbeTrail &slow_repsonse_list;
 
 /**
  * Comments
  */
-extern Comments comments;
+extern Comments &comments;
 
 /**
  * Recent trail
  */
-extern list<CURLProbe> recent_probes;
+extern list<CURLProbe> &recent_probes;
+
+/**
+ * Malformed input lines
+ */
+extern RejectLog &rejects;
 
 #endif
\ No newline at end of file
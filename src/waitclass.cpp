@@ -1,37 +1,154 @@
 #include "waitclass.h"
 
-bool operator<( const WaitClassOrder& o1, const WaitClassOrder& o2 ) {
-  return o1.value < o2.value;
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WAITCLASS_X86
+#endif
+
+/**
+ * A kernel adds the PROBE_STATS_LANES values v to the min, max, total and average and stddev trackers
+ * of the lanes of p, which already had values added, n is the number of items including v.
+ */
+typedef void (*LaneKernel)( ProbeStats &p, const double* v, double n );
+
+/**
+ * The Welford update of QtyStats::addValue, lane by lane.
+ */
+static void lanesScalar( ProbeStats &p, const double* v, double n ) {
+  for ( unsigned i = 0; i < PROBE_STATS_LANES; i++ ) {
+    if ( v[i] < p.min[i] ) p.min[i] = v[i];
+    if ( v[i] > p.max[i] ) p.max[i] = v[i];
+    double delta = v[i] - p.M[i];
+    p.M[i] += delta / n;
+    p.C[i] += delta * ( v[i] - p.M[i] );
+    p.total[i] += v[i];
+  }
 }
 
-void ProbeStats::addValues( double vnamelookup, 
-                            double vconnect,
-                            double vappconnect,
-                            double vpretransfer,
-                            double vstarttransfer,
-                            double vendtransfer ) {
-  namelookup.addValue( vnamelookup );                              
-  connect.addValue( vconnect );                              
-  appconnect.addValue( vappconnect );                              
-  pretransfer.addValue( vpretransfer );                              
-  starttransfer.addValue( vstarttransfer );                              
-  endtransfer.addValue( vendtransfer );     
-  probe.addValue( vnamelookup + vconnect + vappconnect + vpretransfer + vstarttransfer + vendtransfer );
+#ifdef WAITCLASS_X86
+
+__attribute__((target("avx2")))
+static void lanesAVX2( ProbeStats &p, const double* v, double n ) {
+  const __m256d vn = _mm256_set1_pd( n );
+  for ( unsigned i = 0; i < PROBE_STATS_LANES; i += 4 ) {
+    __m256d x = _mm256_loadu_pd( v + i );
+    __m256d m = _mm256_loadu_pd( p.M + i );
+    __m256d delta = _mm256_sub_pd( x, m );
+    m = _mm256_add_pd( m, _mm256_div_pd( delta, vn ) );
+    _mm256_storeu_pd( p.M + i, m );
+    _mm256_storeu_pd( p.C + i, _mm256_add_pd( _mm256_loadu_pd( p.C + i ), _mm256_mul_pd( delta, _mm256_sub_pd( x, m ) ) ) );
+    _mm256_storeu_pd( p.min + i, _mm256_min_pd( x, _mm256_loadu_pd( p.min + i ) ) );
+    _mm256_storeu_pd( p.max + i, _mm256_max_pd( x, _mm256_loadu_pd( p.max + i ) ) );
+    _mm256_storeu_pd( p.total + i, _mm256_add_pd( _mm256_loadu_pd( p.total + i ), x ) );
+  }
+}
+
+/**
+ * avx512f implies fma, keep the multiply and add of the stddev tracker apart so that the results do not
+ * depend on the kernel selected.
+ */
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static void lanesAVX512( ProbeStats &p, const double* v, double n ) {
+  const __m512d x = _mm512_loadu_pd( v );
+  __m512d m = _mm512_loadu_pd( p.M );
+  __m512d delta = _mm512_sub_pd( x, m );
+  m = _mm512_add_pd( m, _mm512_div_pd( delta, _mm512_set1_pd( n ) ) );
+  _mm512_storeu_pd( p.M, m );
+  _mm512_storeu_pd( p.C, _mm512_add_pd( _mm512_loadu_pd( p.C ), _mm512_mul_pd( delta, _mm512_sub_pd( x, m ) ) ) );
+  const __m512d mn = _mm512_loadu_pd( p.min );
+  const __m512d mx = _mm512_loadu_pd( p.max );
+  _mm512_storeu_pd( p.min, _mm512_mask_blend_pd( _mm512_cmp_pd_mask( x, mn, _CMP_LT_OQ ), mn, x ) );
+  _mm512_storeu_pd( p.max, _mm512_mask_blend_pd( _mm512_cmp_pd_mask( x, mx, _CMP_GT_OQ ), mx, x ) );
+  _mm512_storeu_pd( p.total, _mm512_add_pd( _mm512_loadu_pd( p.total ), x ) );
+}
+
+#endif
+
+/**
+ * Select the best kernel for the CPU we run on.
+ */
+static LaneKernel selectLaneKernel() {
+#ifdef WAITCLASS_X86
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx512f" ) ) return lanesAVX512;
+  if ( __builtin_cpu_supports( "avx2" ) ) return lanesAVX2;
+#endif
+  return lanesScalar;
+}
+
+/** The selected kernel. */
+static const LaneKernel lane_kernel = selectLaneKernel();
+
+ProbeStats::ProbeStats() : items(0) {
+  for ( unsigned i = 0; i < PROBE_STATS_LANES; i++ ) {
+    min[i] = std::numeric_limits<double>::max();
+    max[i] = std::numeric_limits<double>::min();
+    total[i] = 0.0;
+    M[i] = 0.0;
+    C[i] = 0.0;
+  }
+}
+
+void ProbeStats::addValues( const WaitClassDurations &durations ) {
+  alignas(64) const double v[PROBE_STATS_LANES] = {
+    durations[wcDNS], durations[wcTCPHandshake], durations[wcSSLHandshake], durations[wcSendStart],
+    durations[wcWaitEnd], durations[wcReceiveEnd],
+    durations[wcDNS] + durations[wcTCPHandshake] + durations[wcSSLHandshake] + durations[wcSendStart] +
+    durations[wcWaitEnd] + durations[wcReceiveEnd],
+    0.0 };
+  if ( items == 0 ) {
+    for ( unsigned i = 0; i < PROBE_STATS_LANES; i++ ) {
+      min[i] = v[i];
+      max[i] = v[i];
+      M[i] = v[i];
+      C[i] = 0.0;
+      total[i] += v[i];
+    }
+    items++;
+  } else {
+    items++;
+    lane_kernel( *this, v, static_cast<double>( items ) );
+  }
+  for ( unsigned i = 0; i <= PROBE_LANE; i++ ) histograms[i].add( v[i] );
+}
+
+void ProbeStats::merge( const ProbeStats& other ) {
+  if ( other.items == 0 ) return;
+  // combine mean and variance trackers (Chan et al.) as QtyStats::merge does
+  double n = (double)items + (double)other.items;
+  for ( unsigned i = 0; i < PROBE_STATS_LANES; i++ ) {
+    if ( items == 0 || other.min[i] < min[i] ) min[i] = other.min[i];
+    if ( items == 0 || other.max[i] > max[i] ) max[i] = other.max[i];
+    double delta = other.M[i] - M[i];
+    M[i] += delta * (double)other.items / n;
+    C[i] += other.C[i] + delta * delta * (double)items * (double)other.items / n;
+    total[i] += other.total[i];
+  }
+  items += other.items;
+  for ( unsigned i = 0; i <= PROBE_LANE; i++ ) histograms[i].merge( other.histograms[i] );
+}
+
+void ProbeStats::set( unsigned lane, const QtyStats &stats ) {
+  min[lane] = stats.min;
+  max[lane] = stats.max;
+  total[lane] = stats.total;
+  M[lane] = stats._M;
+  C[lane] = stats._C;
+  histograms[lane] = stats.histogram;
 }
 
 WaitClass ProbeStats::most() const {
-  set<WaitClassOrder> ordered;
-  ordered.insert( WaitClassOrder( wcDNS , namelookup.total ) );
-  ordered.insert( { wcTCPHandshake , connect.total } );
-  ordered.insert( { wcSSLHandshake , appconnect.total } );
-  ordered.insert( { wcSendStart , pretransfer.total } );
-  ordered.insert( { wcWaitEnd , starttransfer.total } );
-  ordered.insert( { wcReceiveEnd , endtransfer.total } );
-  return (*ordered.rbegin()).wc;
+  WaitClass wc = wcDNS;
+  for ( int i = wcTCPHandshake; i <= wcReceiveEnd; i++ ) {
+    if ( total[i] > total[wc] ) wc = static_cast<WaitClass>( i );
+  }
+  return wc;
 }
 
 int ProbeStats::getTLSRoundTrips() const {
-  return static_cast<int>( floor( appconnect.min / getNetworkRoundtrip() ) );
+  return static_cast<int>( floor( min[wcSSLHandshake] / getNetworkRoundtrip() ) );
 }
 
 /**
@@ -2,7 +2,8 @@
 #define waitclass_h
 
 #include "qtystats.h"
-#include <set>
+
+#include <array>
 
 /**
  * Enumerate the roundtrip wait classes (steps).
@@ -18,81 +19,116 @@ enum WaitClass {
 };
 
 /**
- * Structure to order say std::set<Order> WaitClasses so WaitClass with highest
- * value can easily be retrieved.
+ * The durations of the WaitClasses of a probe, indexed by WaitClass.
+ */
+typedef array<double, wcInvalid> WaitClassDurations;
+
+/**
+ * Return the WaitClass with the largest duration, the first of equal durations.
+ * @param durations The durations.
+ * @return The WaitClass.
+ */
+inline WaitClass dominantWaitClass( const WaitClassDurations &durations ) {
+  // select without branching, the ternary compiles to a conditional move
+  unsigned best = wcDNS;
+  for ( unsigned wc = wcTCPHandshake; wc < wcInvalid; wc++ ) best = durations[wc] > durations[best] ? wc : best;
+  return static_cast<WaitClass>( best );
+}
+
+/** The number of lanes of the ProbeStats arrays: a lane per WaitClass, the probe lane and padding. */
+#define PROBE_STATS_LANES 8
+
+/** The ProbeStats lane of the entire probe, following the lanes of the WaitClasses. */
+#define PROBE_LANE 6
+
+/**
+ * Timing statistics for a single probe. The QtyStats of the WaitClasses and of the entire probe are kept
+ * as arrays (structure of arrays) indexed by lane, the WaitClass or PROBE_LANE, so that adding a probe
+ * updates min, max, total and the average and stddev trackers of all lanes at once with a vector kernel
+ * selected for the CPU we run on. All lanes have the same number of items. The lanes are read as QtyView.
  */
-struct WaitClassOrder {
+struct ProbeStats {
 
-  /** 
-   * Default constructor.
+  /**
+   * Construct and init defaults.
    */
-  WaitClassOrder() : wc(wcInvalid), value(0.0) {}
+  ProbeStats();
+
+  /** The minimum value added per lane. */
+  alignas(64) double min[PROBE_STATS_LANES];
+
+  /** The maximum value added per lane. */
+  alignas(64) double max[PROBE_STATS_LANES];
+
+  /** The sum of values added per lane. */
+  alignas(64) double total[PROBE_STATS_LANES];
+
+  /** To track average and stddev per lane. */
+  alignas(64) double M[PROBE_STATS_LANES];
+
+  /** To track average and stddev per lane. */
+  alignas(64) double C[PROBE_STATS_LANES];
+
+  /** The histogram per lane. */
+  Histogram histograms[PROBE_LANE + 1];
+
+  /** The number of probes added. */
+  size_t items;
 
   /**
-   * Construct a WaitClass-value pair.
-   * @param wc The WiatClass.
-   * @param v The value.
+   * Add the WaitClass durations of a probe, the probe lane gets their sum.
+   * @param durations The durations.
    */
-  WaitClassOrder( WaitClass wc, const double &v) : wc(wc), value(v) {}
+  void addValues( const WaitClassDurations &durations );
 
-  /** The WaitClass */
-  WaitClass wc;
+  /**
+   * Merge the probes added to another ProbeStats into this one.
+   * @param other The ProbeStats to merge.
+   */
+  void merge( const ProbeStats& other );
 
-  /** The value */
-  double value;
-};
+  /**
+   * Return the statistics of a lane.
+   * @param lane The WaitClass or PROBE_LANE.
+   * @return The statistics, valid as long as this ProbeStats.
+   */
+  QtyView get( unsigned lane ) const {
+    return QtyView( min[lane], max[lane], total[lane], M[lane], C[lane], items, histograms[lane] );
+  }
 
-/**
- * Ordering for the Order struct.
- * @param o1 The left key.
- * @param o2 The right key.
- */
-bool operator<( const WaitClassOrder& o1, const WaitClassOrder& o2 );
+  /**
+   * Set the statistics of a lane, leaving the number of items alone.
+   * @param lane The WaitClass or PROBE_LANE.
+   * @param stats The statistics.
+   */
+  void set( unsigned lane, const QtyStats &stats );
 
-/**
- * Timing statistics for a single probe.
- */
-struct ProbeStats {
   /** Statistics for wcDNS */
-  QtyStats namelookup;
+  QtyView namelookup() const { return get( wcDNS ); }
 
   /** Statistics for wcTCPHandshake */
-  QtyStats connect;
+  QtyView connect() const { return get( wcTCPHandshake ); }
 
   /** Statistics for wcSSLHandshake */
-  QtyStats appconnect;
+  QtyView appconnect() const { return get( wcSSLHandshake ); }
 
   /** Statistics for wcSendStart */
-  QtyStats pretransfer;
+  QtyView pretransfer() const { return get( wcSendStart ); }
 
   /** Statistics for wcWaitEnd */
-  QtyStats starttransfer;
+  QtyView starttransfer() const { return get( wcWaitEnd ); }
 
   /** Statistics for wcReceiveEnd */
-  QtyStats endtransfer;
+  QtyView endtransfer() const { return get( wcReceiveEnd ); }
 
   /** Statistics for the entire probe */
-  QtyStats probe;
-
-  /**
-   * Add a value for the WaitClass. For each probe, each of the WaitClasses need to have added a value.
-   * @param wc The WaitClass to add the value for.
-   * @param value The value to add.
-   */
-  /* void addValue( WaitClass wc, double value ); */
-
-  void addValues( double vnamelookup, 
-                  double vconnect,
-                  double vappconnect,
-                  double vpretransfer,
-                  double vstarttransfer,
-                  double vendtransfer );
+  QtyView probe() const { return get( PROBE_LANE ); }
 
   /**
    * Return the number of probes added.
    * @return The number of probes added.
    */
-  size_t getNumItems() const { return endtransfer.items; }
+  size_t getNumItems() const { return items; }
 
   /**
    * Return the WaitClass that contributes most.
@@ -105,7 +141,7 @@ struct ProbeStats {
    * @return The RTT.
    */
   double getNetworkRoundtrip() const {
-    return connect.min / 1.5;
+    return min[wcTCPHandshake] / 1.5;
   }
 
   /**
@@ -119,12 +155,12 @@ struct ProbeStats {
    * @return The ideal response time.
    */
   double getIdealResponse() const {
-    return namelookup.min +
-           connect.min +
-           appconnect.min +
-           pretransfer.min +
-           starttransfer.min +
-           endtransfer.min;
+    return min[wcDNS] +
+           min[wcTCPHandshake] +
+           min[wcSSLHandshake] +
+           min[wcSendStart] +
+           min[wcWaitEnd] +
+           min[wcReceiveEnd];
   };
 
 };